@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hh"
+#include "bvh.hh"
+#include "lod.hh"
+#include "parallel.hh"
+
+
+
+struct OcclusionOptions {
+    uint32_t m_rays = 64;
+    // how far away occluders still count, relative to the radius of the mesh
+    float m_distance = 0.25f;
+    size_t m_threads = thread_count();
+};
+
+// Any two unit vectors perpendicular to n and each other (Duff et al. 2017).
+inline void orthonormal_basis(glm::vec3 n, glm::vec3 &b1, glm::vec3 &b2) {
+    float sign = std::copysign(1.0f, n.z);
+    float a = -1.0f / (sign + n.z);
+    float b = n.x * n.y * a;
+    b1 = glm::vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    b2 = glm::vec3(b, sign + n.y * n.y * a, -n.y);
+}
+
+// The bits of i mirrored around the binary point, 0 <= result < 1.
+[[nodiscard]] inline float radical_inverse(uint32_t i) {
+    i = (i << 16) | (i >> 16);
+    i = ((i & 0x00ff00ffu) << 8) | ((i & 0xff00ff00u) >> 8);
+    i = ((i & 0x0f0f0f0fu) << 4) | ((i & 0xf0f0f0f0u) >> 4);
+    i = ((i & 0x33333333u) << 2) | ((i & 0xccccccccu) >> 2);
+    i = ((i & 0x55555555u) << 1) | ((i & 0xaaaaaaaau) >> 1);
+    return static_cast<float>(i >> 8) * 0x1p-24f;
+}
+
+// Directions of a cosine-weighted hemisphere around +z, from the Hammersley
+// points, so a few rays already cover it evenly.
+[[nodiscard]] inline std::vector<glm::vec3> hemisphere_directions(uint32_t count) {
+    std::vector<glm::vec3> directions(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        float u = (i + 0.5f) / count;
+        float v = radical_inverse(i);
+
+        float r = std::sqrt(u);
+        float phi = 2.0f * std::numbers::pi_v<float> * v;
+        directions[i] = glm::vec3(r * std::cos(phi), r * std::sin(phi), std::sqrt(1.0f - u));
+    }
+
+    return directions;
+}
+
+// Bakes ambient occlusion into the vertex colors as grey: how much of the
+// cosine-weighted hemisphere around the normal is open within
+// m_distance. Needs normals, meshes without are left as they are.
+inline bool bake_occlusion(Mesh &mesh, const OcclusionOptions &options = { }) {
+
+    if ((mesh.m_attribs & ATTRIB_NORMAL) == 0 || options.m_rays == 0)
+        return false;
+
+    Bvh bvh(mesh.view());
+    float radius = bounding_sphere(mesh.view()).m_radius;
+    float distance = options.m_distance * radius;
+    // off the surface, so rays do not hit the triangles they start on
+    float bias = 1e-4f * radius;
+
+    auto directions = hemisphere_directions(options.m_rays);
+
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        // checked above, but every layout is instantiated
+        if constexpr ((A & ATTRIB_NORMAL) != 0) {
+            constexpr unsigned B = A | ATTRIB_COLOR;
+
+            auto old_vertices = mesh.vertices<A>();
+            std::vector<std::byte> bytes(old_vertices.size() * sizeof(PackedVertex<B>));
+            auto vertices = std::span(reinterpret_cast<PackedVertex<B>*>(bytes.data()), old_vertices.size());
+
+            // rays in creases take far longer than open ones, so every thread
+            // takes chunks as it goes instead of one fixed range
+            constexpr size_t CHUNK = 64;
+            std::atomic<size_t> next = 0;
+
+            parallel_for(options.m_threads, [&](size_t, size_t) {
+                for (size_t begin; (begin = next.fetch_add(CHUNK)) < vertices.size(); ) {
+                    size_t end = std::min(begin + CHUNK, vertices.size());
+
+                    for (size_t v = begin; v < end; ++v) {
+                        auto vertex = convert_vertex<B>(old_vertices[v]);
+
+                        glm::vec3 n = vertex.m_normal, b1, b2;
+                        orthonormal_basis(n, b1, b2);
+
+                        // turned by a different angle at every vertex, which
+                        // breaks the banding of a fixed pattern into noise
+                        float angle = (static_cast<uint32_t>(v) * 0x9e3779b9u >> 8) * 0x1p-24f * 2.0f * std::numbers::pi_v<float>;
+                        float c = std::cos(angle), s = std::sin(angle);
+
+                        uint32_t open = 0;
+                        for (auto &d : directions) {
+                            glm::vec3 direction = (d.x * c - d.y * s) * b1 + (d.x * s + d.y * c) * b2 + d.z * n;
+                            open += !bvh.occluded({ vertex.m_pos + n * bias, direction }, distance);
+                        }
+
+                        vertex.m_color = glm::vec3(static_cast<float>(open) / directions.size());
+                        vertices[v] = vertex;
+                    }
+                }
+            }, 1, options.m_threads);
+
+            mesh.m_attribs = B;
+            mesh.m_vertices = std::move(bytes);
+        }
+    });
+
+    return true;
+}
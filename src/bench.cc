@@ -0,0 +1,717 @@
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <numbers>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "stb_image_resize2.h"
+
+#include "obj.hh"
+#include "objfast.hh"
+#include "meshopt.hh"
+#include "normals.hh"
+#include "quantize.hh"
+#include "lod.hh"
+#include "meshlet.hh"
+#include "streams.hh"
+#include "bvh.hh"
+#include "ao.hh"
+#include "texture.hh"
+#include "blockcompress.hh"
+#include "mips.hh"
+#include "resize.hh"
+#include "main.hh"
+
+
+
+// Collects every measurement, so it can be written as JSON for tracking
+// regressions between commits. Everything is printed as it comes in, too.
+class BenchReport {
+    struct Result {
+        std::string m_name;
+        double m_value;
+        std::string m_unit;
+    };
+
+    std::vector<Result> m_results;
+
+public:
+    void add(std::string name, double value, std::string unit) {
+        std::println("  {:<48} {:12.3f} {}", name, value, unit);
+        m_results.push_back({ std::move(name), value, std::move(unit) });
+    }
+
+    [[nodiscard]] bool write_json(const char *filename) const {
+        std::ofstream out(filename);
+        if (!out) {
+            std::println(stderr, "Failed to open benchmark report: {}", filename);
+            return false;
+        }
+
+        out << "{\n  \"kernels\": " << quote(obj_line_kernels().m_name) << ",\n";
+        out << "  \"stream_kernels\": " << quote(stream_kernels().m_name) << ",\n";
+        out << "  \"block_kernels\": " << quote(block_kernels().m_name) << ",\n";
+        out << "  \"threads\": " << thread_count() << ",\n";
+        out << "  \"results\": [\n";
+
+        for (size_t i = 0; i < m_results.size(); ++i) {
+            auto &[name, value, unit] = m_results[i];
+            out << "    { \"name\": " << quote(name)
+                << ", \"value\": " << std::format("{}", value)
+                << ", \"unit\": " << quote(unit)
+                << (i + 1 < m_results.size() ? " },\n" : " }\n");
+        }
+
+        out << "  ]\n}\n";
+        return out.good();
+    }
+
+private:
+    // names are paths and labels, only quotes and backslashes need escaping
+    [[nodiscard]] static std::string quote(std::string_view str) {
+        std::string out = "\"";
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + '"';
+    }
+
+};
+
+// Something that looks like a scanned mesh: positions with six decimals,
+// uvs, normals and v/vt/vn triangles, two per vertex.
+[[nodiscard]] static std::string generate_obj(size_t vertex_count) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<size_t> index(1, vertex_count);
+
+    std::string src;
+
+    for (size_t i = 0; i < vertex_count; ++i) {
+        src += std::format("v {:.6f} {:.6f} {:.6f}\n", coord(rng), coord(rng), coord(rng));
+        src += std::format("vt {:.6f} {:.6f}\n", unit(rng), unit(rng));
+        src += std::format("vn {:.6f} {:.6f} {:.6f}\n", unit(rng), unit(rng), unit(rng));
+    }
+
+    for (size_t i = 0; i < vertex_count * 2; ++i) {
+        size_t a = index(rng), b = index(rng), c = index(rng);
+        src += std::format("f {}/{}/{} {}/{}/{} {}/{}/{}\n", a, a, a, b, b, b, c, c, c);
+    }
+
+    return src;
+}
+
+// Positions halfway between two floats, printed with 15 significant digits.
+// A float rounded from a double lands on the wrong side of those every now
+// and then, the fast paths have to agree with the lexer on every one.
+[[nodiscard]] static std::string generate_precise_obj(size_t vertex_count) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(0.5f, 1000.0f);
+
+    auto number = [&] {
+        float f = coord(rng);
+        double halfway = (double(f) + double(std::nextafter(f, INFINITY))) / 2.0;
+        return std::format("{:.15g}", rng() & 1 ? -halfway : halfway);
+    };
+
+    std::string src;
+    for (size_t i = 0; i < vertex_count; ++i)
+        src += std::format("v {} {} {}\n", number(), number(), number());
+    return src;
+}
+
+template <typename Fn>
+[[nodiscard]] static double seconds(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// best of a few runs, the others are mostly noise from the rest of the system
+template <typename Fn>
+[[nodiscard]] static double best_of(int runs, Fn fn) {
+    double best = 1e9;
+    for (int i = 0; i < runs; ++i)
+        best = std::min(best, seconds(fn));
+    return best;
+}
+
+[[nodiscard]] static bool same_data(const ObjData &a, const ObjData &b) {
+    return a.m_vertices == b.m_vertices
+        && a.m_uvs == b.m_uvs
+        && a.m_normals == b.m_normals
+        && a.m_corners == b.m_corners
+        && a.m_polygons == b.m_polygons
+        && a.m_relative == b.m_relative
+        && a.m_materials == b.m_materials
+        && a.m_groups == b.m_groups
+        && a.m_material_libs == b.m_material_libs
+        && a.m_attribs == b.m_attribs;
+}
+
+// coordinates that are not bit for bit the same
+[[nodiscard]] static size_t float_mismatches(std::span<const glm::vec3> a, std::span<const glm::vec3> b) {
+    if (a.size() != b.size())
+        return std::max(a.size(), b.size()) * 3;
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (int k = 0; k < 3; ++k)
+            mismatches += std::bit_cast<uint32_t>(a[i][k]) != std::bit_cast<uint32_t>(b[i][k]);
+    }
+    return mismatches;
+}
+
+// Parses src on one thread with the generic lexer and every supported kernel
+// set, and checks every kernel set parses it exactly like the lexer.
+static void bench_obj_lines(BenchReport &report, const std::string &name, std::string_view src) {
+    constexpr int runs = 5;
+
+    std::println("{} ({:.1f} MB)", name, src.size() / 1e6);
+
+    auto measure = [&](const char *label, const ObjLineKernels *kernels, ObjData &out) {
+        double time = best_of(runs, [&] { out = ObjChunkParser(src, kernels).parse(); });
+        report.add(std::format("obj_lines/{}/{}", name, label), src.size() / time / 1e6, "MB/s");
+    };
+
+    ObjData reference;
+    measure("lexer", nullptr, reference);
+
+    for (auto *kernels : obj_supported_kernels()) {
+        ObjData data;
+        measure(kernels->m_name, kernels, data);
+
+        if (!same_data(data, reference))
+            std::println("  {}: output differs from the lexer", kernels->m_name);
+
+        size_t mismatches = float_mismatches(data.m_vertices, reference.m_vertices);
+        report.add(std::format("obj_lines/{}/{}/float_mismatches", name, kernels->m_name), mismatches, "floats");
+    }
+}
+
+// The whole ObjParser, from the mapped file to the assembled mesh, on one
+// thread and on all of them.
+static void bench_obj_parse(BenchReport &report, const std::string &name, const char *filename) {
+    constexpr int runs = 3;
+
+    auto size = std::filesystem::file_size(filename);
+
+    std::vector<size_t> counts = { 1 };
+    if (thread_count() > 1)
+        counts.push_back(thread_count());
+
+    for (size_t threads : counts) {
+        Mesh mesh;
+        double time = best_of(runs, [&] { mesh = ObjParser(filename).parse(threads); });
+
+        auto label = std::format("obj_parse/{}/threads={}", name, threads);
+        report.add(label, size / time / 1e6, "MB/s");
+        report.add(label + "/faces", mesh.m_indices.size() / 3 / time / 1e6, "Mfaces/s");
+    }
+}
+
+// The optimizer pass run after parsing, and what it does to the cache.
+static void bench_mesh_optimize(BenchReport &report, const std::string &name, const char *filename) {
+    Mesh parsed = ObjParser(filename).parse();
+    Mesh mesh;
+
+    MeshOptimizeStats stats;
+    double time = best_of(3, [&] {
+        mesh = parsed;
+        stats = optimize_mesh(mesh);
+    });
+
+    auto label = std::format("mesh_optimize/{}", name);
+    report.add(label, time * 1e3, "ms");
+    report.add(label + "/acmr_before", stats.m_before.m_acmr, "per triangle");
+    report.add(label + "/acmr_after", stats.m_after.m_acmr, "per triangle");
+    report.add(label + "/atvr_before", stats.m_before.m_atvr, "per vertex");
+    report.add(label + "/atvr_after", stats.m_after.m_atvr, "per vertex");
+}
+
+// Generating what the mesh lacks on first load, normals always so meshes
+// that have them are measured as well.
+static void bench_normals(BenchReport &report, const std::string &name, const char *filename) {
+    Mesh parsed = ObjParser(filename).parse();
+    auto label = std::format("normals/{}", name);
+
+    Mesh mesh;
+    double normals = best_of(3, [&] {
+        mesh = parsed;
+        generate_normals(mesh);
+    });
+
+    report.add(label, normals * 1e3, "ms");
+    report.add(label + "/split", double(mesh.vertex_count()) / std::max<size_t>(parsed.vertex_count(), 1), "vertices per vertex");
+
+    if ((parsed.m_attribs & ATTRIB_UV) == 0)
+        return;
+
+    parsed = mesh;
+    double tangents = best_of(3, [&] {
+        mesh = parsed;
+        generate_tangents(mesh);
+    });
+
+    report.add(label + "/tangents", tangents * 1e3, "ms");
+}
+
+// Building the levels of detail on first load, and how small the last one got.
+static void bench_lods(BenchReport &report, const std::string &name, const char *filename) {
+    Mesh parsed = ObjParser(filename).parse();
+    optimize_mesh(parsed);
+
+    Mesh mesh;
+    double time = best_of(3, [&] {
+        mesh = parsed;
+        build_lods(mesh);
+    });
+
+    auto label = std::format("lods/{}", name);
+    report.add(label, time * 1e3, "ms");
+    report.add(label + "/levels", mesh.m_lods.size(), "levels");
+
+    if (!mesh.m_lods.empty()) {
+        auto &last = mesh.m_lods.back();
+        size_t indices = 0;
+        for (auto &submesh : std::span(mesh.m_lod_submeshes).subspan(last.m_first_submesh, last.m_submesh_count))
+            indices += submesh.m_count;
+
+        report.add(label + "/last_triangles", indices / 3, "triangles");
+        report.add(label + "/last_error", last.m_error / bounding_sphere(mesh.view()).m_radius, "radius");
+    }
+}
+
+// Splitting into meshlets on load, and culling them each frame with the
+// model two bounding radii in front of the camera.
+static void bench_meshlets(BenchReport &report, const std::string &name, const char *filename) {
+    constexpr int frames = 10'000;
+
+    Mesh mesh = ObjParser(filename).parse();
+    auto optimized = optimize_mesh(mesh);
+    build_lods(mesh);
+
+    // each run starts again from the order optimize_mesh() made
+    auto indices = mesh.m_indices;
+    auto lod_indices = mesh.m_lod_indices;
+    double build = best_of(3, [&] {
+        mesh.m_indices = indices;
+        mesh.m_lod_indices = lod_indices;
+        build_meshlets(mesh);
+    });
+
+    auto meshlets = std::span(mesh.m_meshlets).first(mesh.m_meshlet_levels[1]);
+    auto label = std::format("meshlets/{}", name);
+    report.add(label + "/build", build * 1e3, "ms");
+    report.add(label + "/count", meshlets.size(), "meshlets");
+    report.add(label + "/triangles", meshlets.empty() ? 0.0 : mesh.m_indices.size() / 3.0 / meshlets.size(), "per meshlet");
+
+    // the order that is drawn, against the one optimize_mesh() made
+    report.add(label + "/acmr", analyze_vertex_cache(mesh.m_indices, mesh.vertex_count()).m_acmr, "per triangle");
+    report.add(label + "/acmr_optimized", optimized.m_after.m_acmr, "per triangle");
+
+    State state;
+    auto bounds = bounding_sphere(mesh.view());
+    glm::vec3 pos = state.cam.position() - glm::vec3(0.0f, 0.0f, bounds.m_radius * 2.0f) - bounds.m_center;
+    auto mvp = state.model_view_projection(pos);
+
+    std::vector<uint8_t> visible(meshlets.size());
+    CullStats stats;
+
+    double time = best_of(3, [&] {
+        for (int i = 0; i < frames; ++i)
+            stats = cull_meshlets(meshlets, mvp, state.cam.position() - pos, true, visible);
+    });
+
+    report.add(label + "/cull", time / frames * 1e6, "us/frame");
+    report.add(label + "/culled", stats.culled_ratio() * 100.0, "%");
+}
+
+// Converting to the compact layout, done on every upload.
+static void bench_quantize(BenchReport &report, const std::string &name, const char *filename) {
+    Mesh mesh = ObjParser(filename).parse();
+
+    QuantizedVertices vertices;
+    double time = best_of(3, [&] { vertices = quantize_vertices(mesh.view(), VERTEX_FORMAT_COMPACT); });
+
+    auto label = std::format("quantize/{}", name);
+    report.add(label, mesh.vertex_count() / time / 1e6, "Mvertices/s");
+    report.add(label + "/stride_before", vertex_stride(mesh.m_attribs), "bytes");
+    report.add(label + "/stride_after", vertices.stride(), "bytes");
+}
+
+// Transforming whole meshes at once, against one Vertex::rotate() per vertex
+// as the rest of the code would do it.
+static void bench_streams(BenchReport &report, const std::string &name, const char *filename) {
+    constexpr float angle = 0.5f;
+    constexpr glm::vec3 axis { 0.0f, 1.0f, 0.0f };
+
+    Mesh mesh = ObjParser(filename).parse();
+    auto streams = load_streams(mesh.view());
+    double count = streams.size();
+    auto label = std::format("streams/{}", name);
+
+    std::vector<Vertex> vertices;
+    for (size_t i = 0; i < streams.size(); ++i)
+        vertices.emplace_back(glm::vec3(streams.m_positions[0][i], streams.m_positions[1][i], streams.m_positions[2][i]));
+
+    double per_vertex = best_of(3, [&] {
+        for (auto &vertex : vertices)
+            vertex.rotate(angle, axis);
+    });
+    report.add(label + "/rotate/per_vertex", count / per_vertex / 1e6, "Mvertices/s");
+
+    for (auto *kernels : stream_supported_kernels()) {
+        double rotate = best_of(3, [&] { rotate_streams(streams, angle, axis, *kernels); });
+        report.add(std::format("{}/rotate/{}", label, kernels->m_name), count / rotate / 1e6, "Mvertices/s");
+
+        BoundingBox box;
+        double bounds = best_of(3, [&] { box = stream_bounds(streams, *kernels); });
+        report.add(std::format("{}/bounds/{}", label, kernels->m_name), count / bounds / 1e6, "Mvertices/s");
+    }
+
+    constexpr size_t instances = 16;
+    std::vector<glm::mat4> matrices;
+    for (size_t i = 0; i < instances; ++i)
+        matrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(float(i), 0.0f, 0.0f)));
+
+    Mesh flat;
+    double flatten = best_of(3, [&] { flat = flatten_instances(mesh.view(), matrices); });
+    report.add(label + "/flatten", count * instances / flatten / 1e6, "Mvertices/s");
+}
+
+// A bumpy sphere of rings by segments quads, for queries on a mesh that is
+// an actual surface, unlike the synthetic triangle soup.
+[[nodiscard]] static Mesh generate_sphere(uint32_t rings, uint32_t segments) {
+    Mesh mesh;
+    mesh.resize_vertices<ATTRIB_POSITION>(size_t(rings + 1) * (segments + 1));
+    auto vertices = mesh.vertices<ATTRIB_POSITION>();
+
+    for (uint32_t r = 0; r <= rings; ++r) {
+        for (uint32_t s = 0; s <= segments; ++s) {
+            float theta = std::numbers::pi_v<float> * r / rings;
+            float phi = 2.0f * std::numbers::pi_v<float> * s / segments;
+            float radius = 1.0f + 0.05f * std::sin(theta * 40.0f) * std::sin(phi * 40.0f);
+            vertices[r * (segments + 1) + s].m_pos = radius * glm::vec3(
+                std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        }
+    }
+
+    for (uint32_t r = 0; r < rings; ++r) {
+        for (uint32_t s = 0; s < segments; ++s) {
+            uint32_t a = r * (segments + 1) + s, b = a + segments + 1;
+            for (uint32_t v : { a, b, a + 1, a + 1, b, b + 1 })
+                mesh.m_indices.push_back(v);
+        }
+    }
+
+    return mesh;
+}
+
+// Building the hierarchy once, then picking from random points around the
+// mesh towards random points within its bounds, like a cursor would.
+static void bench_bvh(BenchReport &report, const std::string &name, const Mesh &mesh) {
+    constexpr int rays = 10'000;
+
+    std::println("{}", name);
+
+    Bvh bvh;
+    double build = best_of(3, [&] { bvh = Bvh(mesh.view()); });
+
+    auto label = std::format("bvh/{}", name);
+    double triangles = mesh.m_indices.size() / 3;
+    report.add(label + "/build", build * 1e3, "ms");
+    report.add(label + "/build/rate", triangles / build / 1e6, "Mtriangles/s");
+
+    BoundingBox box = stream_bounds(load_streams(mesh.view()));
+    glm::vec3 center = (box.m_min + box.m_max) * 0.5f;
+    float radius = glm::length(box.m_max - box.m_min);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+    std::vector<Ray> queries;
+    for (int i = 0; i < rays; ++i) {
+        glm::vec3 origin = center + glm::normalize(glm::vec3(coord(rng), coord(rng), coord(rng))) * radius;
+        glm::vec3 target = center + (box.m_max - box.m_min) * 0.5f * glm::vec3(coord(rng), coord(rng), coord(rng));
+        queries.push_back({ origin, glm::normalize(target - origin) });
+    }
+
+    size_t hits = 0;
+    double worst = 0.0;
+    double total = seconds([&] {
+        for (auto &ray : queries) {
+            RayHit hit;
+            worst = std::max(worst, seconds([&] { hit = bvh.intersect(ray); }));
+            hits += hit.hit();
+        }
+    });
+
+    report.add(label + "/pick", total / rays * 1e6, "us");
+    report.add(label + "/pick/worst", worst * 1e6, "us");
+    report.add(label + "/pick/hits", 100.0 * hits / rays, "%");
+}
+
+// The ambient occlusion bake on one thread and on all of them, which should
+// be about thread_count() times faster.
+static void bench_occlusion(BenchReport &report, const std::string &name, const char *filename) {
+    Mesh parsed = ObjParser(filename).parse();
+    if ((parsed.m_attribs & ATTRIB_NORMAL) == 0)
+        generate_normals(parsed);
+
+    auto label = std::format("occlusion/{}", name);
+    double rays = double(parsed.vertex_count()) * OcclusionOptions { }.m_rays;
+    std::vector<double> times;
+
+    std::vector<size_t> thread_counts { 1 };
+    if (thread_count() > 1)
+        thread_counts.push_back(thread_count());
+
+    for (size_t threads : thread_counts) {
+        OcclusionOptions options;
+        options.m_threads = threads;
+
+        times.push_back(best_of(3, [&] {
+            Mesh mesh = parsed;
+            bake_occlusion(mesh, options);
+        }));
+
+        report.add(std::format("{}/threads-{}", label, threads), rays / times.back() / 1e6, "Mrays/s");
+    }
+
+    if (times.size() > 1)
+        report.add(label + "/speedup", times.front() / times.back(), "x");
+}
+
+[[nodiscard]] static stbir_pixel_layout pixel_layout(GLenum format) {
+    switch (format) {
+        case GL_RED: return STBIR_1CHANNEL;
+        case GL_RG:  return STBIR_2CHANNEL;
+        case GL_RGB: return STBIR_RGB;
+    }
+    return STBIR_RGBA;
+}
+
+// Decoding and halving the size, the work Texture does before it uploads,
+// resizing with the old single threaded call and with resize_image().
+static void bench_texture(BenchReport &report, const char *filename, GLenum format) {
+    constexpr int runs = 5;
+
+    std::println("{}", filename);
+
+    Texture::ImageData image;
+    double decode = best_of(runs, [&] { image = Texture::decode(filename, false, format); });
+
+    auto &[data, width, height] = image;
+    if (data == nullptr)
+        return;
+
+    int channels = channel_count(format);
+    double pixels = double(width) * height;
+    report.add(std::format("texture_decode/{}/{}ch", filename, channels), decode * 1e3, "ms");
+    report.add(std::format("texture_decode/{}/{}ch/rate", filename, channels), pixels / decode / 1e6, "Mpixel/s");
+
+    int resize_width = std::max(width / 2, 1);
+    int resize_height = std::max(height / 2, 1);
+    std::vector<uint8_t> resized(size_t(resize_width) * resize_height * channels);
+    auto resize_label = std::format("texture_resize/{}/{}ch", filename, channels);
+
+    // the single threaded call Texture::decode used to make
+    double resize = best_of(runs, [&] {
+        stbir_resize_uint8_linear(
+            data.get(), width, height, 0,
+            resized.data(), resize_width, resize_height, 0,
+            pixel_layout(format)
+        );
+    });
+
+    report.add(resize_label + "/stbir", resize * 1e3, "ms");
+    report.add(resize_label + "/stbir/rate", pixels / resize / 1e6, "Mpixel/s");
+
+    for (auto [name, options] : { std::pair { "linear", ResizeOptions { } }, std::pair { "srgb", ResizeOptions { .m_srgb = true } } }) {
+        double time = best_of(runs, [&] {
+            (void)resize_image(data.get(), width, height, channels, resized.data(), resize_width, resize_height, options);
+        });
+
+        auto label = std::format("{}/{}", resize_label, name);
+        report.add(label, time * 1e3, "ms");
+        report.add(label + "/rate", pixels / time / 1e6, "Mpixel/s");
+        report.add(label + "/speedup", resize / time, "x");
+    }
+}
+
+// Building the mip chain of an image on the CPU, plain, in linear light and
+// with alpha coverage kept.
+static void bench_mips(BenchReport &report, const char *filename, GLenum format) {
+    constexpr int runs = 3;
+
+    std::println("{}", filename);
+
+    auto [data, width, height] = Texture::decode(filename, false, format);
+    if (data == nullptr)
+        return;
+
+    int channels = channel_count(format);
+    double pixels = double(width) * height;
+    std::vector<uint8_t> mips(mip_chain_size(width, height, channels));
+
+    std::vector<std::pair<const char*, MipOptions>> variants {
+        { "linear", { } },
+        { "srgb", { .m_srgb = true } },
+    };
+    if (channels == 4)
+        variants.push_back({ "coverage", { .m_srgb = true, .m_preserve_coverage = true } });
+
+    for (auto &[name, options] : variants) {
+        double time = best_of(runs, [&] { build_mips(data.get(), width, height, channels, mips.data(), options); });
+        report.add(std::format("mips/{}/{}", filename, name), time * 1e3, "ms");
+        report.add(std::format("mips/{}/{}/rate", filename, name), pixels / time / 1e6, "Mpixel/s");
+    }
+}
+
+// Encoding the top level into every block format with every kernel set,
+// then whole mip chains, the work of a texture's first load.
+static void bench_block_compression(BenchReport &report, const char *filename, GLenum format) {
+    constexpr int runs = 3;
+    constexpr std::pair<BlockFormat, const char*> formats[] = {
+        { BlockFormat::BC1, "bc1" },
+        { BlockFormat::BC3, "bc3" },
+        { BlockFormat::BC5, "bc5" },
+        { BlockFormat::BC7, "bc7" },
+    };
+
+    std::println("{}", filename);
+
+    auto [data, width, height] = Texture::decode(filename, false, format);
+    if (data == nullptr)
+        return;
+
+    int channels = channel_count(format);
+    double pixels = double(width) * height;
+
+    for (auto [block, block_name] : formats) {
+        auto label = std::format("block_compress/{}/{}", filename, block_name);
+        std::vector<uint8_t> out(size_t((width + 3) / 4) * ((height + 3) / 4) * block_bytes(block));
+
+        for (auto *kernels : block_supported_kernels()) {
+            double time = best_of(runs, [&] { compress_level(data.get(), width, height, channels, block, out.data(), *kernels); });
+            report.add(std::format("{}/{}", label, kernels->m_name), pixels / time / 1e6, "Mpixel/s");
+        }
+
+        CompressedImage image;
+        double chain = best_of(runs, [&] { image = compress_image(data.get(), width, height, channels, block); });
+        report.add(label + "/mips", chain * 1e3, "ms");
+
+        // against the same chain uncompressed, which is a third more than the top level
+        report.add(label + "/ratio", pixels * channels * 4 / 3 / image.m_data.size(), "x");
+    }
+}
+
+// What every frame does on the CPU before drawing: turn the camera and
+// build the model-view-projection matrix.
+static void bench_camera(BenchReport &report) {
+    constexpr int frames = 1'000'000;
+
+    std::println("camera");
+
+    State state;
+    glm::mat4 sum(0.0f);
+
+    double time = best_of(3, [&] {
+        for (int i = 0; i < frames; ++i) {
+            state.cam.rotate({ 0.5f, 0.25f });
+            state.cam.move_forward(0.001f);
+            sum += state.model_view_projection({ 0.0f, 0.0f, -5.0f });
+        }
+    });
+
+    // keeps the loop from being optimized away
+    volatile float sink = sum[0][0];
+    (void)sink;
+
+    report.add("camera/mvp", time / frames * 1e9, "ns/frame");
+}
+
+static void usage(const char *name) {
+    std::println(stderr, "usage: {} [--json report.json] [--vertices count]", name);
+    exit(EXIT_FAILURE);
+}
+
+// Runs from the source directory, like glfun, to find the assets. Needs
+// neither a window nor a GPU.
+int main(int argc, char **argv) {
+
+    const char *json = nullptr;
+    size_t vertex_count = 1'000'000;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+
+        if (arg == "--json" && i + 1 < argc)
+            json = argv[++i];
+        else if (arg == "--vertices" && i + 1 < argc)
+            vertex_count = std::atol(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+
+    BenchReport report;
+
+    auto synthetic = std::format("synthetic-{}", vertex_count * 2);
+    auto src = generate_obj(vertex_count);
+    bench_obj_lines(report, synthetic, src);
+    bench_obj_lines(report, "precise", generate_precise_obj(vertex_count));
+
+    // ObjParser maps a file, so the synthetic mesh goes through one as well
+    auto path = std::filesystem::temp_directory_path() / "glfun_bench.obj";
+    std::ofstream(path, std::ios::binary).write(src.data(), src.size());
+    src = { };
+
+    bench_obj_parse(report, synthetic, path.c_str());
+    bench_mesh_optimize(report, synthetic, path.c_str());
+    bench_quantize(report, synthetic, path.c_str());
+    bench_normals(report, synthetic, path.c_str());
+    bench_streams(report, synthetic, path.c_str());
+    std::filesystem::remove(path);
+
+    for (auto *asset : { "assets/teapot.obj", "assets/cow.obj", "assets/cube.obj" }) {
+        MappedFile file(asset);
+        bench_obj_lines(report, asset, file.view());
+        bench_obj_parse(report, asset, asset);
+        bench_mesh_optimize(report, asset, asset);
+        bench_quantize(report, asset, asset);
+        bench_normals(report, asset, asset);
+        bench_lods(report, asset, asset);
+        bench_meshlets(report, asset, asset);
+        bench_streams(report, asset, asset);
+        bench_bvh(report, asset, ObjParser(asset).parse());
+        bench_occlusion(report, asset, asset);
+    }
+
+    // two triangles per quad
+    bench_bvh(report, "sphere-1M", generate_sphere(500, 1000));
+
+    bench_texture(report, "assets/container.jpg", GL_RGB);
+    bench_texture(report, "assets/awesomeface.png", GL_RGBA);
+    bench_texture(report, "backpack/ao.jpg", GL_RGB);
+    bench_texture(report, "backpack/ao.jpg", GL_RGBA);
+    bench_mips(report, "assets/awesomeface.png", GL_RGBA);
+    bench_mips(report, "backpack/ao.jpg", GL_RGB);
+    bench_block_compression(report, "backpack/ao.jpg", GL_RGB);
+
+    bench_camera(report);
+
+    if (json != nullptr && !report.write_json(json))
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cstring>
+
+#include "blockcompress.hh"
+#include "parallel.hh"
+
+
+
+namespace {
+
+// rows of blocks, a 4K image has 1024 of them
+constexpr size_t BLOCK_ROW_MIN_BATCH = 16;
+
+[[nodiscard]] size_t level_bytes(int width, int height, BlockFormat format) {
+    return size_t((width + 3) / 4) * ((height + 3) / 4) * block_bytes(format);
+}
+
+} // namespace
+
+void compress_level(
+    const uint8_t *pixels,
+    int width,
+    int height,
+    int channels,
+    BlockFormat format,
+    uint8_t *out,
+    const BlockKernels &kernels
+) {
+    size_t blocks_wide = (width + 3) / 4, blocks_high = (height + 3) / 4;
+    size_t stride = block_bytes(format);
+
+    parallel_for(blocks_high, [&](size_t begin, size_t end) {
+        uint8_t block[64];
+
+        for (size_t by = begin; by < end; ++by) {
+            for (size_t bx = 0; bx < blocks_wide; ++bx) {
+                for (int y = 0; y < 4; ++y) {
+                    size_t sy = std::min<size_t>(by * 4 + y, height - 1);
+                    for (int x = 0; x < 4; ++x) {
+                        size_t sx = std::min<size_t>(bx * 4 + x, width - 1);
+                        uint8_t *pixel = block + (y * 4 + x) * 4;
+                        pixel[0] = pixel[1] = pixel[2] = 0;
+                        pixel[3] = 255;
+                        memcpy(pixel, pixels + (sy * width + sx) * channels, channels);
+                    }
+                }
+
+                uint8_t *dst = out + (by * blocks_wide + bx) * stride;
+                switch (format) {
+                    case BlockFormat::BC1:
+                        kernels.m_bc1(block, dst);
+                        break;
+                    case BlockFormat::BC3:
+                        kernels.m_bc4(block, 3, dst);
+                        kernels.m_bc1(block, dst + 8);
+                        break;
+                    case BlockFormat::BC5:
+                        kernels.m_bc4(block, 0, dst);
+                        kernels.m_bc4(block, 1, dst + 8);
+                        break;
+                    case BlockFormat::BC7:
+                        kernels.m_bc7(block, dst);
+                        break;
+                    case BlockFormat::NONE:
+                        break;
+                }
+            }
+        }
+    }, BLOCK_ROW_MIN_BATCH);
+}
+
+[[nodiscard]] CompressedImage compress_image(
+    const uint8_t *pixels,
+    int width,
+    int height,
+    int channels,
+    BlockFormat format,
+    const MipOptions &options,
+    const BlockKernels &kernels
+) {
+    CompressedImage image;
+    image.m_format = format;
+
+    // sized up front, so levels can be encoded straight into place
+    uint64_t offset = 0;
+    for (int level = 0; level < mip_count(width, height); ++level) {
+        int w = mip_size(width, level), h = mip_size(height, level);
+        image.m_levels.push_back({ uint32_t(w), uint32_t(h), offset, level_bytes(w, h, format) });
+        offset += image.m_levels.back().m_size;
+    }
+
+    image.m_data.resize(offset);
+
+    std::vector<uint8_t> mips(mip_chain_size(width, height, channels));
+    build_mips(pixels, width, height, channels, mips.data(), options);
+
+    const uint8_t *level_pixels = pixels;
+
+    for (size_t i = 0; i < image.m_levels.size(); ++i) {
+        auto &level = image.m_levels[i];
+        compress_level(level_pixels, level.m_width, level.m_height, channels, format, image.m_data.data() + level.m_offset, kernels);
+
+        level_pixels = i == 0 ? mips.data() : level_pixels + size_t(level.m_width) * level.m_height * channels;
+    }
+
+    return image;
+}
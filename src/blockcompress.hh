@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "blockkernels.hh"
+#include "mips.hh"
+
+
+
+enum class BlockFormat : uint32_t {
+    NONE,
+    // rgb, 4 bits per pixel
+    BC1,
+    // rgba, BC1 colors and BC4 alpha, 8 bits per pixel
+    BC3,
+    // two BC4 channels, for normal maps with only x and y, 8 bits per pixel
+    BC5,
+    // rgba in mode 6 only, 8 bits per pixel
+    BC7,
+};
+
+// bytes of a 4x4 block
+[[nodiscard]] constexpr size_t block_bytes(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : format == BlockFormat::NONE ? 0 : 16;
+}
+
+// One level of the mip chain, at m_offset into CompressedImage::m_data. The
+// layout of the level table in texture cache files, too.
+struct CompressedLevel {
+    uint32_t m_width;
+    uint32_t m_height;
+    uint64_t m_offset;
+    uint64_t m_size;
+};
+
+static_assert(sizeof(CompressedLevel) == 24);
+
+// A whole mip chain down to 1x1, each level a row by row grid of blocks.
+struct CompressedImage {
+    BlockFormat m_format = BlockFormat::NONE;
+    std::vector<CompressedLevel> m_levels;
+    std::vector<uint8_t> m_data;
+
+    [[nodiscard]] uint32_t width() const {
+        return m_levels.empty() ? 0 : m_levels[0].m_width;
+    }
+
+    [[nodiscard]] uint32_t height() const {
+        return m_levels.empty() ? 0 : m_levels[0].m_height;
+    }
+};
+
+// Encodes pixels with 1 to 4 channels of 8 bits into format, rows of
+// blocks in parallel. Missing channels are 0, alpha is 255. out has to hold
+// block_bytes(format) for every block, edges are padded by repeating the
+// last row and column.
+void compress_level(
+    const uint8_t *pixels,
+    int width,
+    int height,
+    int channels,
+    BlockFormat format,
+    uint8_t *out,
+    const BlockKernels &kernels = block_kernels()
+);
+
+// Builds the mip chain of an image with build_mips() and encodes every
+// level of it.
+[[nodiscard]] CompressedImage compress_image(
+    const uint8_t *pixels,
+    int width,
+    int height,
+    int channels,
+    BlockFormat format,
+    const MipOptions &options = { },
+    const BlockKernels &kernels = block_kernels()
+);
@@ -0,0 +1,56 @@
+#include "blockkernels.hh"
+#include "blockkernels_impl.hh"
+
+
+
+namespace {
+
+void bc1(const uint8_t block[64], uint8_t out[8]) {
+    bc1_block<ScalarOps>(block, out);
+}
+
+void bc4(const uint8_t block[64], int channel, uint8_t out[8]) {
+    bc4_block<ScalarOps>(block, channel, out);
+}
+
+void bc7(const uint8_t block[64], uint8_t out[16]) {
+    bc7_block<ScalarOps>(block, out);
+}
+
+} // namespace
+
+const BlockKernels BLOCK_KERNELS_SCALAR {
+    "scalar",
+    bc1,
+    bc4,
+    bc7,
+};
+
+[[nodiscard]] std::span<const BlockKernels *const> block_supported_kernels() {
+
+    struct Supported {
+        const BlockKernels *m_kernels[3];
+        size_t m_count = 0;
+    };
+
+    static const Supported supported = [] {
+        Supported s;
+        __builtin_cpu_init();
+
+        s.m_kernels[s.m_count++] = &BLOCK_KERNELS_SCALAR;
+
+        // part of x86-64, always there
+        s.m_kernels[s.m_count++] = &BLOCK_KERNELS_SSE;
+
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            s.m_kernels[s.m_count++] = &BLOCK_KERNELS_AVX2;
+
+        return s;
+    }();
+
+    return { supported.m_kernels, supported.m_count };
+}
+
+[[nodiscard]] const BlockKernels &block_kernels() {
+    return *block_supported_kernels().back();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+
+
+// Encoders of single 4x4 blocks of the BCn formats. A block is 16 pixels of
+// 8 bit rgba, row by row, 64 bytes. Endpoints come from the principal axis
+// of the block's colors and every pixel takes the palette entry nearest to
+// its projection onto them, which is fast and close to what a search finds.
+//
+// The vector kernels sum in a different order, so rarely a pixel on the
+// edge between two palette entries takes the other one.
+struct BlockKernels {
+    const char *m_name;
+    // opaque BC1, 8 bytes, also the color half of BC3
+    void (*m_bc1)(const uint8_t block[64], uint8_t out[8]);
+    // one channel of the block as BC4, 8 bytes, the alpha half of BC3 and
+    // each half of BC5
+    void (*m_bc4)(const uint8_t block[64], int channel, uint8_t out[8]);
+    // BC7 in mode 6, a single subset with rgba endpoints and 16 levels, 16 bytes
+    void (*m_bc7)(const uint8_t block[64], uint8_t out[16]);
+};
+
+extern const BlockKernels BLOCK_KERNELS_SCALAR;
+extern const BlockKernels BLOCK_KERNELS_SSE;
+extern const BlockKernels BLOCK_KERNELS_AVX2;
+
+// the fastest kernels the cpu supports, picked once at runtime
+[[nodiscard]] const BlockKernels &block_kernels();
+
+// every kernel set the cpu supports, slowest first
+[[nodiscard]] std::span<const BlockKernels *const> block_supported_kernels();
@@ -0,0 +1,123 @@
+// compiled with -mavx2 -mfma, only called if the cpu supports it
+#include <immintrin.h>
+
+#include "blockkernels.hh"
+#include "blockkernels_impl.hh"
+
+
+
+namespace {
+
+[[nodiscard]] float hsum(__m256 v) {
+    __m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    __m128 shuffled = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(x, shuffled);
+    return _mm_cvtss_f32(_mm_add_ss(sums, _mm_movehl_ps(shuffled, sums)));
+}
+
+[[nodiscard]] float hmin(__m256 v) {
+    __m128 x = _mm_min_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    x = _mm_min_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(_mm_min_ss(x, _mm_movehl_ps(x, x)));
+}
+
+[[nodiscard]] float hmax(__m256 v) {
+    __m128 x = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    x = _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(_mm_max_ss(x, _mm_movehl_ps(x, x)));
+}
+
+// the 16 pixels are two vectors of eight
+struct Avx2Ops {
+    static void load(const uint8_t block[64], float px[4][16]) {
+        __m256i mask = _mm256_set1_epi32(0xff);
+        for (int h = 0; h < 2; ++h) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + h * 32));
+            _mm256_storeu_ps(px[0] + h * 8, _mm256_cvtepi32_ps(_mm256_and_si256(v, mask)));
+            _mm256_storeu_ps(px[1] + h * 8, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 8), mask)));
+            _mm256_storeu_ps(px[2] + h * 8, _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 16), mask)));
+            _mm256_storeu_ps(px[3] + h * 8, _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 24)));
+        }
+    }
+
+    static void moments(const float *const ch[], int dims, float mean[4], float cov[4][4]) {
+        __m256 centered[4][2];
+
+        for (int a = 0; a < dims; ++a) {
+            __m256 lo = _mm256_loadu_ps(ch[a]), hi = _mm256_loadu_ps(ch[a] + 8);
+            mean[a] = hsum(_mm256_add_ps(lo, hi)) * (1.0f / 16);
+
+            __m256 m = _mm256_set1_ps(mean[a]);
+            centered[a][0] = _mm256_sub_ps(lo, m);
+            centered[a][1] = _mm256_sub_ps(hi, m);
+        }
+
+        for (int a = 0; a < dims; ++a) {
+            for (int b = 0; b <= a; ++b) {
+                __m256 sum = _mm256_mul_ps(centered[a][0], centered[b][0]);
+                sum = _mm256_fmadd_ps(centered[a][1], centered[b][1], sum);
+                cov[a][b] = cov[b][a] = hsum(sum);
+            }
+        }
+    }
+
+    [[nodiscard]] static __m256 project(const float *const ch[], int dims, int h, const float origin[4], const float axis[4]) {
+        __m256 t = _mm256_setzero_ps();
+        for (int k = 0; k < dims; ++k) {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(ch[k] + h * 8), _mm256_set1_ps(origin[k]));
+            t = _mm256_fmadd_ps(d, _mm256_set1_ps(axis[k]), t);
+        }
+        return t;
+    }
+
+    static void extents(const float *const ch[], int dims, const float origin[4], const float axis[4], float &lo, float &hi) {
+        __m256 t0 = project(ch, dims, 0, origin, axis);
+        __m256 t1 = project(ch, dims, 1, origin, axis);
+        lo = hmin(_mm256_min_ps(t0, t1));
+        hi = hmax(_mm256_max_ps(t0, t1));
+    }
+
+    static void indices(
+        const float *const ch[], int dims, const float origin[4], const float dir[4],
+        const float *thresholds, int count, uint8_t out[16]
+    ) {
+        for (int h = 0; h < 2; ++h) {
+            __m256 t = project(ch, dims, h, origin, dir);
+
+            // every threshold below adds a mask of -1
+            __m256i index = _mm256_setzero_si256();
+            for (int j = 0; j < count; ++j)
+                index = _mm256_sub_epi32(index, _mm256_castps_si256(_mm256_cmp_ps(t, _mm256_set1_ps(thresholds[j]), _CMP_GT_OQ)));
+
+            // packs within each 128 bit lane, so each lane's first four bytes
+            __m256i shorts = _mm256_packs_epi32(index, index);
+            __m256i bytes = _mm256_packus_epi16(shorts, shorts);
+            int words[2] = {
+                _mm_cvtsi128_si32(_mm256_castsi256_si128(bytes)),
+                _mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1)),
+            };
+            memcpy(out + h * 8, words, 8);
+        }
+    }
+};
+
+void avx2_bc1(const uint8_t block[64], uint8_t out[8]) {
+    bc1_block<Avx2Ops>(block, out);
+}
+
+void avx2_bc4(const uint8_t block[64], int channel, uint8_t out[8]) {
+    bc4_block<Avx2Ops>(block, channel, out);
+}
+
+void avx2_bc7(const uint8_t block[64], uint8_t out[16]) {
+    bc7_block<Avx2Ops>(block, out);
+}
+
+} // namespace
+
+const BlockKernels BLOCK_KERNELS_AVX2 {
+    "avx2",
+    avx2_bc1,
+    avx2_bc4,
+    avx2_bc7,
+};
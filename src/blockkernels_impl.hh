@@ -0,0 +1,338 @@
+#pragma once
+
+// Block encoders of blockkernels.hh, written once over the few loops that
+// touch all 16 pixels. Every translation unit includes this with its own
+// Ops for those loops, so everything in here has internal linkage and only
+// uses plain C headers, like streamkernels_impl.hh.
+//
+// Ops has:
+//   load(block, px)                     px[c][i] = channel c of pixel i
+//   moments(ch, dims, mean, cov)        mean and scaled covariance
+//   extents(ch, dims, origin, axis, lo, hi)
+//                                       range of dot(p - origin, axis)
+//   indices(ch, dims, origin, dir, thresholds, count, out)
+//                                       how many thresholds dot(p - origin, dir) is above
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "blockkernels.hh"
+
+namespace {
+
+// 1 and 2 thirds of the way from color0 to color1 are entries 2 and 3
+constexpr float BC1_THRESHOLDS[3] = { 1.0f / 6, 3.0f / 6, 5.0f / 6 };
+constexpr uint8_t BC1_ORDER[4] = { 0, 2, 3, 1 };
+
+// the same for the six values between alpha0 and alpha1
+constexpr float BC4_THRESHOLDS[7] = { 1.0f / 14, 3.0f / 14, 5.0f / 14, 7.0f / 14, 9.0f / 14, 11.0f / 14, 13.0f / 14 };
+constexpr uint8_t BC4_ORDER[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+
+// halfway between the 4 bit weights 0, 4, 9, 13, 17, 21, 26, 30, 34, 38,
+// 43, 47, 51, 55, 60 and 64 of 64, which are spread almost evenly
+constexpr float BC7_THRESHOLDS[15] = {
+    2.0f / 64, 6.5f / 64, 11.0f / 64, 15.0f / 64, 19.0f / 64, 23.5f / 64, 28.0f / 64, 32.0f / 64,
+    36.0f / 64, 40.5f / 64, 45.0f / 64, 49.0f / 64, 53.0f / 64, 57.5f / 64, 62.0f / 64,
+};
+
+struct ScalarOps {
+    static void load(const uint8_t block[64], float px[4][16]) {
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 4; ++c)
+                px[c][i] = block[i * 4 + c];
+    }
+
+    static void moments(const float *const ch[], int dims, float mean[4], float cov[4][4]) {
+        for (int a = 0; a < dims; ++a) {
+            float sum = 0.0f;
+            for (int i = 0; i < 16; ++i)
+                sum += ch[a][i];
+            mean[a] = sum * (1.0f / 16);
+        }
+
+        for (int a = 0; a < dims; ++a) {
+            for (int b = 0; b <= a; ++b) {
+                float sum = 0.0f;
+                for (int i = 0; i < 16; ++i)
+                    sum += (ch[a][i] - mean[a]) * (ch[b][i] - mean[b]);
+                cov[a][b] = cov[b][a] = sum;
+            }
+        }
+    }
+
+    static void extents(const float *const ch[], int dims, const float origin[4], const float axis[4], float &lo, float &hi) {
+        lo = INFINITY;
+        hi = -INFINITY;
+        for (int i = 0; i < 16; ++i) {
+            float t = 0.0f;
+            for (int k = 0; k < dims; ++k)
+                t += (ch[k][i] - origin[k]) * axis[k];
+            lo = t < lo ? t : lo;
+            hi = t > hi ? t : hi;
+        }
+    }
+
+    static void indices(
+        const float *const ch[], int dims, const float origin[4], const float dir[4],
+        const float *thresholds, int count, uint8_t out[16]
+    ) {
+        for (int i = 0; i < 16; ++i) {
+            float t = 0.0f;
+            for (int k = 0; k < dims; ++k)
+                t += (ch[k][i] - origin[k]) * dir[k];
+
+            uint8_t index = 0;
+            for (int j = 0; j < count; ++j)
+                index += t > thresholds[j];
+            out[i] = index;
+        }
+    }
+};
+
+[[nodiscard]] inline float clamp_unorm8(float v) {
+    return v < 0.0f ? 0.0f : v > 255.0f ? 255.0f : v;
+}
+
+[[nodiscard]] inline int clamp_int(int v, int lo, int hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+// The direction the colors of a block spread along the most, by power
+// iteration on their covariance. Flat blocks get the grey diagonal.
+inline void principal_axis(const float cov[4][4], int dims, float axis[4]) {
+    int widest = 0;
+    for (int a = 1; a < dims; ++a)
+        widest = cov[a][a] > cov[widest][widest] ? a : widest;
+
+    float v[4];
+    for (int a = 0; a < dims; ++a)
+        v[a] = cov[a][widest];
+
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float w[4], largest = 0.0f;
+        for (int a = 0; a < dims; ++a) {
+            w[a] = 0.0f;
+            for (int b = 0; b < dims; ++b)
+                w[a] += cov[a][b] * v[b];
+            largest = fabsf(w[a]) > largest ? fabsf(w[a]) : largest;
+        }
+
+        if (largest == 0.0f)
+            break;
+        for (int a = 0; a < dims; ++a)
+            v[a] = w[a] / largest;
+    }
+
+    float length2 = 0.0f;
+    for (int a = 0; a < dims; ++a)
+        length2 += v[a] * v[a];
+
+    float inverse = length2 > 0.0f ? 1.0f / sqrtf(length2) : 0.0f;
+    for (int a = 0; a < dims; ++a)
+        axis[a] = length2 > 0.0f ? v[a] * inverse : 1.0f / sqrtf(static_cast<float>(dims));
+}
+
+// Ends of the segment the block's colors project onto, clamped to 8 bits.
+template <typename Ops>
+void block_endpoints(const float *const ch[], int dims, float ends[2][4]) {
+    float mean[4], cov[4][4], axis[4];
+    Ops::moments(ch, dims, mean, cov);
+    principal_axis(cov, dims, axis);
+
+    float lo, hi;
+    Ops::extents(ch, dims, mean, axis, lo, hi);
+
+    for (int k = 0; k < dims; ++k) {
+        ends[0][k] = clamp_unorm8(mean[k] + lo * axis[k]);
+        ends[1][k] = clamp_unorm8(mean[k] + hi * axis[k]);
+    }
+}
+
+// from a to b, scaled so the projection of b is 1, false if a is b
+inline bool segment_direction(const float a[4], const float b[4], int dims, float dir[4]) {
+    float length2 = 0.0f;
+    for (int k = 0; k < dims; ++k) {
+        dir[k] = b[k] - a[k];
+        length2 += dir[k] * dir[k];
+    }
+
+    if (length2 == 0.0f)
+        return false;
+
+    for (int k = 0; k < dims; ++k)
+        dir[k] /= length2;
+    return true;
+}
+
+[[nodiscard]] inline uint16_t pack_565(const float c[4]) {
+    int r = static_cast<int>(c[0] * (31.0f / 255) + 0.5f);
+    int g = static_cast<int>(c[1] * (63.0f / 255) + 0.5f);
+    int b = static_cast<int>(c[2] * (31.0f / 255) + 0.5f);
+    return static_cast<uint16_t>(r << 11 | g << 5 | b);
+}
+
+// the way the gpu expands it, by repeating the high bits
+inline void unpack_565(uint16_t packed, float c[4]) {
+    int r = packed >> 11, g = (packed >> 5) & 63, b = packed & 31;
+    c[0] = static_cast<float>(r << 3 | r >> 2);
+    c[1] = static_cast<float>(g << 2 | g >> 4);
+    c[2] = static_cast<float>(b << 3 | b >> 2);
+    c[3] = 0.0f;
+}
+
+template <typename Ops>
+void bc1_block(const uint8_t block[64], uint8_t out[8]) {
+    float px[4][16];
+    Ops::load(block, px);
+    const float *const ch[3] = { px[0], px[1], px[2] };
+
+    float ends[2][4];
+    block_endpoints<Ops>(ch, 3, ends);
+
+    // color0 above color1 selects the mode with four colors
+    uint16_t c0 = pack_565(ends[1]), c1 = pack_565(ends[0]);
+    if (c0 < c1) {
+        uint16_t swap = c0;
+        c0 = c1;
+        c1 = swap;
+    }
+
+    float e0[4], e1[4], dir[4];
+    unpack_565(c0, e0);
+    unpack_565(c1, e1);
+
+    uint32_t bits = 0;
+    if (segment_direction(e0, e1, 3, dir)) {
+        uint8_t idx[16];
+        Ops::indices(ch, 3, e0, dir, BC1_THRESHOLDS, 3, idx);
+        for (int i = 0; i < 16; ++i)
+            bits |= static_cast<uint32_t>(BC1_ORDER[idx[i]]) << (2 * i);
+    }
+
+    out[0] = static_cast<uint8_t>(c0);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int b = 0; b < 4; ++b)
+        out[4 + b] = static_cast<uint8_t>(bits >> (8 * b));
+}
+
+template <typename Ops>
+void bc4_block(const uint8_t block[64], int channel, uint8_t out[8]) {
+    float px[4][16];
+    Ops::load(block, px);
+    const float *const ch[1] = { px[channel] };
+
+    const float zero[4] = { }, unit[4] = { 1.0f };
+    float lo, hi;
+    Ops::extents(ch, 1, zero, unit, lo, hi);
+
+    // alpha0 above alpha1 selects the mode with six values between them
+    float ends[2][4] = { { hi }, { lo } };
+    float dir[4];
+
+    uint64_t bits = 0;
+    if (segment_direction(ends[0], ends[1], 1, dir)) {
+        uint8_t idx[16];
+        Ops::indices(ch, 1, ends[0], dir, BC4_THRESHOLDS, 7, idx);
+        for (int i = 0; i < 16; ++i)
+            bits |= static_cast<uint64_t>(BC4_ORDER[idx[i]]) << (3 * i);
+    }
+
+    out[0] = static_cast<uint8_t>(hi);
+    out[1] = static_cast<uint8_t>(lo);
+    for (int b = 0; b < 6; ++b)
+        out[2 + b] = static_cast<uint8_t>(bits >> (8 * b));
+}
+
+// 7 bits per channel and a lowest bit shared by all four, whichever of the
+// two is closer
+inline void quantize_bc7_endpoint(const float in[4], int q[4], int &p, float out[4]) {
+    float best = INFINITY;
+
+    for (int bit = 0; bit < 2; ++bit) {
+        int c[4];
+        float error = 0.0f;
+        for (int k = 0; k < 4; ++k) {
+            c[k] = clamp_int(static_cast<int>((in[k] - bit) * 0.5f + 0.5f), 0, 127);
+            float d = static_cast<float>(c[k] << 1 | bit) - in[k];
+            error += d * d;
+        }
+
+        if (error < best) {
+            best = error;
+            p = bit;
+            for (int k = 0; k < 4; ++k) {
+                q[k] = c[k];
+                out[k] = static_cast<float>(c[k] << 1 | bit);
+            }
+        }
+    }
+}
+
+struct BitWriter {
+    uint64_t m_words[2] = { };
+    int m_pos = 0;
+
+    void put(uint64_t value, int count) {
+        int shift = m_pos % 64;
+        m_words[m_pos / 64] |= value << shift;
+        if (shift + count > 64)
+            m_words[m_pos / 64 + 1] |= value >> (64 - shift);
+        m_pos += count;
+    }
+};
+
+template <typename Ops>
+void bc7_block(const uint8_t block[64], uint8_t out[16]) {
+    float px[4][16];
+    Ops::load(block, px);
+    const float *const ch[4] = { px[0], px[1], px[2], px[3] };
+
+    float ends[2][4];
+    block_endpoints<Ops>(ch, 4, ends);
+
+    int q[2][4], p[2];
+    float e[2][4], dir[4];
+    quantize_bc7_endpoint(ends[0], q[0], p[0], e[0]);
+    quantize_bc7_endpoint(ends[1], q[1], p[1], e[1]);
+
+    uint8_t idx[16] = { };
+    if (segment_direction(e[0], e[1], 4, dir))
+        Ops::indices(ch, 4, e[0], dir, BC7_THRESHOLDS, 15, idx);
+
+    // the highest bit of the first index is left out and has to be 0, the
+    // weights are symmetric so swapping the ends makes it so
+    if (idx[0] & 8) {
+        for (int k = 0; k < 4; ++k) {
+            int swap = q[0][k];
+            q[0][k] = q[1][k];
+            q[1][k] = swap;
+        }
+        int swap = p[0];
+        p[0] = p[1];
+        p[1] = swap;
+
+        for (int i = 0; i < 16; ++i)
+            idx[i] = static_cast<uint8_t>(15 - idx[i]);
+    }
+
+    BitWriter bits;
+    bits.put(1 << 6, 7);
+    for (int k = 0; k < 4; ++k) {
+        bits.put(static_cast<uint64_t>(q[0][k]), 7);
+        bits.put(static_cast<uint64_t>(q[1][k]), 7);
+    }
+    bits.put(static_cast<uint64_t>(p[0]), 1);
+    bits.put(static_cast<uint64_t>(p[1]), 1);
+
+    bits.put(idx[0], 3);
+    for (int i = 1; i < 16; ++i)
+        bits.put(idx[i], 4);
+
+    // little-endian, like everything this runs on
+    memcpy(out, bits.m_words, 16);
+}
+
+} // namespace
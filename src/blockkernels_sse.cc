@@ -0,0 +1,123 @@
+// SSE2 is part of x86-64, so this needs no extra compiler flags
+#include <immintrin.h>
+
+#include "blockkernels.hh"
+#include "blockkernels_impl.hh"
+
+
+
+namespace {
+
+[[nodiscard]] float hsum(__m128 v) {
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    return _mm_cvtss_f32(_mm_add_ss(sums, _mm_movehl_ps(shuffled, sums)));
+}
+
+[[nodiscard]] float hmin(__m128 v) {
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(_mm_min_ss(v, _mm_movehl_ps(v, v)));
+}
+
+[[nodiscard]] float hmax(__m128 v) {
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(_mm_max_ss(v, _mm_movehl_ps(v, v)));
+}
+
+// the 16 pixels are four vectors of four
+struct SseOps {
+    static void load(const uint8_t block[64], float px[4][16]) {
+        __m128i mask = _mm_set1_epi32(0xff);
+        for (int q = 0; q < 4; ++q) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + q * 16));
+            _mm_storeu_ps(px[0] + q * 4, _mm_cvtepi32_ps(_mm_and_si128(v, mask)));
+            _mm_storeu_ps(px[1] + q * 4, _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8), mask)));
+            _mm_storeu_ps(px[2] + q * 4, _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 16), mask)));
+            _mm_storeu_ps(px[3] + q * 4, _mm_cvtepi32_ps(_mm_srli_epi32(v, 24)));
+        }
+    }
+
+    static void moments(const float *const ch[], int dims, float mean[4], float cov[4][4]) {
+        __m128 centered[4][4];
+
+        for (int a = 0; a < dims; ++a) {
+            __m128 sum = _mm_setzero_ps();
+            for (int q = 0; q < 4; ++q)
+                sum = _mm_add_ps(sum, _mm_loadu_ps(ch[a] + q * 4));
+
+            mean[a] = hsum(sum) * (1.0f / 16);
+            __m128 m = _mm_set1_ps(mean[a]);
+            for (int q = 0; q < 4; ++q)
+                centered[a][q] = _mm_sub_ps(_mm_loadu_ps(ch[a] + q * 4), m);
+        }
+
+        for (int a = 0; a < dims; ++a) {
+            for (int b = 0; b <= a; ++b) {
+                __m128 sum = _mm_setzero_ps();
+                for (int q = 0; q < 4; ++q)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(centered[a][q], centered[b][q]));
+                cov[a][b] = cov[b][a] = hsum(sum);
+            }
+        }
+    }
+
+    [[nodiscard]] static __m128 project(const float *const ch[], int dims, int q, const float origin[4], const float axis[4]) {
+        __m128 t = _mm_setzero_ps();
+        for (int k = 0; k < dims; ++k) {
+            __m128 d = _mm_sub_ps(_mm_loadu_ps(ch[k] + q * 4), _mm_set1_ps(origin[k]));
+            t = _mm_add_ps(t, _mm_mul_ps(d, _mm_set1_ps(axis[k])));
+        }
+        return t;
+    }
+
+    static void extents(const float *const ch[], int dims, const float origin[4], const float axis[4], float &lo, float &hi) {
+        __m128 low = _mm_set1_ps(INFINITY), high = _mm_set1_ps(-INFINITY);
+        for (int q = 0; q < 4; ++q) {
+            __m128 t = project(ch, dims, q, origin, axis);
+            low = _mm_min_ps(low, t);
+            high = _mm_max_ps(high, t);
+        }
+        lo = hmin(low);
+        hi = hmax(high);
+    }
+
+    static void indices(
+        const float *const ch[], int dims, const float origin[4], const float dir[4],
+        const float *thresholds, int count, uint8_t out[16]
+    ) {
+        for (int q = 0; q < 4; ++q) {
+            __m128 t = project(ch, dims, q, origin, dir);
+
+            // every threshold below adds a mask of -1
+            __m128i index = _mm_setzero_si128();
+            for (int j = 0; j < count; ++j)
+                index = _mm_sub_epi32(index, _mm_castps_si128(_mm_cmpgt_ps(t, _mm_set1_ps(thresholds[j]))));
+
+            __m128i shorts = _mm_packs_epi32(index, index);
+            __m128i bytes = _mm_packus_epi16(shorts, shorts);
+            int word = _mm_cvtsi128_si32(bytes);
+            memcpy(out + q * 4, &word, 4);
+        }
+    }
+};
+
+void sse_bc1(const uint8_t block[64], uint8_t out[8]) {
+    bc1_block<SseOps>(block, out);
+}
+
+void sse_bc4(const uint8_t block[64], int channel, uint8_t out[8]) {
+    bc4_block<SseOps>(block, channel, out);
+}
+
+void sse_bc7(const uint8_t block[64], uint8_t out[16]) {
+    bc7_block<SseOps>(block, out);
+}
+
+} // namespace
+
+const BlockKernels BLOCK_KERNELS_SSE {
+    "sse",
+    sse_bc1,
+    sse_bc4,
+    sse_bc7,
+};
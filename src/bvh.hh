@@ -0,0 +1,651 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hh"
+#include "parallel.hh"
+#include "streams.hh"
+
+
+
+struct Ray {
+    glm::vec3 m_origin;
+    // need not be normalized, distances are in multiples of it
+    glm::vec3 m_direction;
+};
+
+static constexpr uint32_t BVH_NO_HIT = UINT32_MAX;
+
+struct RayHit {
+    float m_distance = INFINITY;
+    // its indices start at m_triangle * 3
+    uint32_t m_triangle = BVH_NO_HIT;
+    // barycentric coordinates of the hit on the second and third vertex
+    float m_u = 0.0f;
+    float m_v = 0.0f;
+
+    [[nodiscard]] bool hit() const {
+        return m_triangle != BVH_NO_HIT;
+    }
+};
+
+// Four children side by side, so one ray is tested against all of them at
+// once. Padded to two cache lines, so a node never straddles a third.
+struct alignas(64) BvhNode {
+    // [min or max][axis][child], empty slots have an inverted box
+    float m_bounds[2][3][4];
+    // a node, BVH_LEAF | a packet, or BVH_EMPTY
+    uint32_t m_children[4];
+};
+
+// Up to four triangles of a leaf as vertex and two edges each, laid out for
+// a 4-wide Moller-Trumbore test. Unused lanes have zero edges, so they never
+// hit.
+struct alignas(16) TrianglePacket {
+    float m_v0[3][4];
+    float m_e1[3][4];
+    float m_e2[3][4];
+    uint32_t m_triangles[4];
+};
+
+static constexpr uint32_t BVH_LEAF = 1u << 31;
+static constexpr uint32_t BVH_EMPTY = UINT32_MAX;
+
+inline void grow(BoundingBox &box, glm::vec3 point) {
+    box.m_min = glm::min(box.m_min, point);
+    box.m_max = glm::max(box.m_max, point);
+}
+
+inline void grow(BoundingBox &box, const BoundingBox &other) {
+    box.m_min = glm::min(box.m_min, other.m_min);
+    box.m_max = glm::max(box.m_max, other.m_max);
+}
+
+// half of it, which is all the surface area heuristic needs
+[[nodiscard]] inline float half_area(const BoundingBox &box) {
+    glm::vec3 size = glm::max(box.m_max - box.m_min, glm::vec3(0.0f));
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// Binary BVH built top-down with binned SAH. The top levels are split one
+// node at a time with the binning spread across threads, then the subtrees
+// below are built on a thread each.
+class BvhBuilder {
+public:
+    // interior nodes have m_count 0 and their children at m_first and
+    // m_first + 1, leaves hold m_order[m_first .. m_first + m_count]
+    struct Node {
+        BoundingBox m_box;
+        uint32_t m_first;
+        uint32_t m_count;
+    };
+
+    // a leaf never holds more triangles than fit in a packet
+    static constexpr uint32_t LEAF_SIZE = 4;
+
+    // below this depth nodes are split at the median, which halves them, so
+    // no tree of up to 2^32 triangles is deeper than MAX_DEPTH
+    static constexpr uint32_t MAX_SAH_DEPTH = 48;
+    static constexpr uint32_t MAX_DEPTH = MAX_SAH_DEPTH + 31;
+
+private:
+    static constexpr int BINS = 16;
+    // smaller nodes are binned on a single thread
+    static constexpr uint32_t PARALLEL_BINNING = 1 << 16;
+
+    struct Bin {
+        BoundingBox m_box;
+        uint32_t m_count = 0;
+    };
+
+    using Bins = std::array<std::array<Bin, BINS>, 3>;
+
+    // a node still to be split, with the bounds of its triangles' centroids
+    struct Task {
+        uint32_t m_node;
+        BoundingBox m_centroids;
+        uint32_t m_depth = 0;
+    };
+
+    struct Split {
+        uint32_t m_middle;
+        BoundingBox m_boxes[2];
+        BoundingBox m_centroids[2];
+    };
+
+    std::span<const BoundingBox> m_boxes;
+    std::span<const glm::vec3> m_centroids;
+    std::vector<uint32_t> m_order;
+    std::vector<Node> m_nodes;
+
+public:
+    // boxes and centroids of every triangle
+    BvhBuilder(std::span<const BoundingBox> boxes, std::span<const glm::vec3> centroids)
+        : m_boxes(boxes)
+        , m_centroids(centroids)
+        , m_order(boxes.size())
+    {
+        std::iota(m_order.begin(), m_order.end(), 0u);
+    }
+
+    // triangles by leaf
+    [[nodiscard]] std::span<const uint32_t> order() const {
+        return m_order;
+    }
+
+    [[nodiscard]] std::vector<Node> build() {
+
+        m_nodes.clear();
+
+        Node root { { }, 0, static_cast<uint32_t>(m_order.size()) };
+        BoundingBox centroids;
+        for (size_t i = 0; i < m_boxes.size(); ++i) {
+            grow(root.m_box, m_boxes[i]);
+            grow(centroids, m_centroids[i]);
+        }
+        m_nodes.push_back(root);
+
+        size_t subtree_size = std::max<size_t>(m_order.size() / (8 * thread_count()), PARALLEL_BINNING / 4);
+
+        std::vector<Task> tasks { { 0, centroids } };
+        std::vector<Task> subtrees;
+
+        while (!tasks.empty()) {
+            Task task = tasks.back();
+            tasks.pop_back();
+
+            if (m_nodes[task.m_node].m_count <= subtree_size) {
+                subtrees.push_back(task);
+                continue;
+            }
+
+            for (auto &child : split(m_nodes, task))
+                tasks.push_back(child);
+        }
+
+        // every subtree partitions its own range of m_order
+        std::vector<std::vector<Node>> built(subtrees.size());
+        parallel_for(subtrees.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                built[i].push_back(m_nodes[subtrees[i].m_node]);
+                build_subtree(built[i], { 0, subtrees[i].m_centroids, subtrees[i].m_depth });
+            }
+        });
+
+        // the subtree roots take the place of the nodes they were built from
+        for (size_t i = 0; i < subtrees.size(); ++i) {
+            uint32_t offset = m_nodes.size() - 1;
+            m_nodes.insert(m_nodes.end(), built[i].begin() + 1, built[i].end());
+            m_nodes[subtrees[i].m_node] = built[i][0];
+
+            auto relocate = [&](Node &node) {
+                if (node.m_count == 0)
+                    node.m_first += offset;
+            };
+            relocate(m_nodes[subtrees[i].m_node]);
+            for (size_t n = offset + 1; n < m_nodes.size(); ++n)
+                relocate(m_nodes[n]);
+        }
+
+        return std::move(m_nodes);
+    }
+
+private:
+    void build_subtree(std::vector<Node> &nodes, Task task) {
+        for (auto &child : split(nodes, task))
+            build_subtree(nodes, child);
+    }
+
+    // bin the centroid is in along axis, for centroid bounds min and the
+    // scale that maps them to 0 .. BINS
+    [[nodiscard]] static int bin_of(float centroid, float min, float scale) {
+        return std::clamp(static_cast<int>((centroid - min) * scale), 0, BINS - 1);
+    }
+
+    void bin(Bins &bins, uint32_t begin, uint32_t end, const BoundingBox &centroids, glm::vec3 scale) const {
+        for (uint32_t i = begin; i < end; ++i) {
+            uint32_t t = m_order[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                auto &bin = bins[axis][bin_of(m_centroids[t][axis], centroids.m_min[axis], scale[axis])];
+                grow(bin.m_box, m_boxes[t]);
+                ++bin.m_count;
+            }
+        }
+    }
+
+    // Splits the node of task in two at the cheapest bin boundary, appends
+    // the children to nodes and returns the tasks for them. Nodes that fit in
+    // a leaf stay one.
+    [[nodiscard]] std::vector<Task> split(std::vector<Node> &nodes, const Task &task) {
+
+        Node node = nodes[task.m_node];
+        if (node.m_count <= LEAF_SIZE)
+            return { };
+
+        uint32_t begin = node.m_first;
+        uint32_t end = node.m_first + node.m_count;
+
+        glm::vec3 extent = task.m_centroids.m_max - task.m_centroids.m_min;
+        glm::vec3 scale(0.0f);
+        for (int axis = 0; axis < 3; ++axis)
+            if (extent[axis] > 0.0f)
+                scale[axis] = BINS / extent[axis];
+
+        Bins bins { };
+        if (node.m_count >= PARALLEL_BINNING) {
+            size_t chunks = thread_count();
+            std::vector<Bins> partial(chunks);
+            parallel_for(chunks, [&](size_t first, size_t last) {
+                for (size_t c = first; c < last; ++c)
+                    bin(partial[c], begin + node.m_count * c / chunks, begin + node.m_count * (c + 1) / chunks, task.m_centroids, scale);
+            });
+
+            for (auto &part : partial) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    for (int b = 0; b < BINS; ++b) {
+                        grow(bins[axis][b].m_box, part[axis][b].m_box);
+                        bins[axis][b].m_count += part[axis][b].m_count;
+                    }
+                }
+            }
+        } else {
+            bin(bins, begin, end, task.m_centroids, scale);
+        }
+
+        auto split = task.m_depth < MAX_SAH_DEPTH ? best_split(bins, scale, node, task) : std::nullopt;
+        if (!split)
+            split = median_split(node, task);
+
+        Node children[2] = {
+            { split->m_boxes[0], begin, split->m_middle - begin },
+            { split->m_boxes[1], split->m_middle, end - split->m_middle },
+        };
+
+        uint32_t first = nodes.size();
+        nodes[task.m_node] = { node.m_box, first, 0 };
+        nodes.push_back(children[0]);
+        nodes.push_back(children[1]);
+
+        return {
+            { first, split->m_centroids[0], task.m_depth + 1 },
+            { first + 1, split->m_centroids[1], task.m_depth + 1 },
+        };
+    }
+
+    // the cheapest split by the surface area heuristic, if there is one at all
+    [[nodiscard]] std::optional<Split> best_split(const Bins &bins, glm::vec3 scale, const Node &node, const Task &task) {
+
+        float best_cost = INFINITY;
+        int best_axis = -1;
+        int best_bin = 0;
+
+        for (int axis = 0; axis < 3; ++axis) {
+            if (scale[axis] == 0.0f)
+                continue;
+
+            // costs of everything left of each boundary, then right of it
+            std::array<float, BINS> left_cost;
+            BoundingBox box;
+            uint32_t count = 0;
+            for (int b = 0; b < BINS - 1; ++b) {
+                grow(box, bins[axis][b].m_box);
+                count += bins[axis][b].m_count;
+                left_cost[b] = count == 0 ? 0.0f : half_area(box) * count;
+            }
+
+            box = { };
+            count = 0;
+            for (int b = BINS - 1; b > 0; --b) {
+                grow(box, bins[axis][b].m_box);
+                count += bins[axis][b].m_count;
+                float cost = left_cost[b - 1] + (count == 0 ? 0.0f : half_area(box) * count);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        if (best_axis < 0)
+            return std::nullopt;
+
+        uint32_t begin = node.m_first;
+        uint32_t end = node.m_first + node.m_count;
+        float min = task.m_centroids.m_min[best_axis];
+
+        auto middle = std::partition(m_order.begin() + begin, m_order.begin() + end, [&](uint32_t t) {
+            return bin_of(m_centroids[t][best_axis], min, scale[best_axis]) < best_bin;
+        });
+
+        Split split { static_cast<uint32_t>(middle - m_order.begin()), { }, { } };
+        if (split.m_middle == begin || split.m_middle == end)
+            return std::nullopt;
+
+        for (int b = 0; b < BINS; ++b)
+            grow(split.m_boxes[b < best_bin ? 0 : 1], bins[best_axis][b].m_box);
+
+        // only one pass instead of one per axis while binning
+        for (auto it = m_order.begin() + begin; it != m_order.begin() + end; ++it)
+            grow(split.m_centroids[it < middle ? 0 : 1], m_centroids[*it]);
+
+        return split;
+    }
+
+    // for triangles the bins cannot tell apart, like ones sharing a centroid
+    [[nodiscard]] Split median_split(const Node &node, const Task &task) {
+
+        int axis = 0;
+        glm::vec3 extent = task.m_centroids.m_max - task.m_centroids.m_min;
+        if (extent.y > extent[axis]) axis = 1;
+        if (extent.z > extent[axis]) axis = 2;
+
+        auto begin = m_order.begin() + node.m_first;
+        auto end = begin + node.m_count;
+        auto middle = begin + node.m_count / 2;
+        std::nth_element(begin, middle, end, [&](uint32_t a, uint32_t b) {
+            return m_centroids[a][axis] < m_centroids[b][axis];
+        });
+
+        Split split { static_cast<uint32_t>(middle - m_order.begin()), { }, { } };
+        for (auto it = begin; it != end; ++it) {
+            int side = it < middle ? 0 : 1;
+            grow(split.m_boxes[side], m_boxes[*it]);
+            grow(split.m_centroids[side], m_centroids[*it]);
+        }
+
+        return split;
+    }
+};
+
+// Bounding volume hierarchy over the triangles of a mesh, for queries on the
+// CPU like picking. Nodes are stored depth first with four children each,
+// so a ray mostly walks forward through memory, and leaves are single
+// packets of up to four triangles.
+class Bvh {
+    std::vector<BvhNode> m_nodes;
+    std::vector<TrianglePacket> m_packets;
+
+public:
+    Bvh() = default;
+
+    explicit Bvh(MeshView mesh) {
+
+        auto positions = mesh_positions(mesh);
+
+        auto indices = mesh.m_indices;
+        size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0)
+            return;
+
+        std::vector<BoundingBox> boxes(triangle_count);
+        std::vector<glm::vec3> centroids(triangle_count);
+        parallel_for(triangle_count, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; ++t) {
+                for (int k = 0; k < 3; ++k)
+                    grow(boxes[t], positions[indices[t * 3 + k]]);
+                centroids[t] = (boxes[t].m_min + boxes[t].m_max) * 0.5f;
+            }
+        }, 1 << 14);
+
+        BvhBuilder builder(boxes, centroids);
+        auto nodes = builder.build();
+
+        // the leaves in the order collapse() reaches them
+        std::vector<uint32_t> leaves;
+        collapse(nodes, 0, leaves);
+
+        auto order = builder.order();
+        m_packets.resize(leaves.size());
+        parallel_for(leaves.size(), [&](size_t begin, size_t end) {
+            for (size_t p = begin; p < end; ++p) {
+                auto &leaf = nodes[leaves[p]];
+                auto &packet = m_packets[p];
+                packet = { };
+                std::fill(std::begin(packet.m_triangles), std::end(packet.m_triangles), BVH_NO_HIT);
+
+                for (uint32_t lane = 0; lane < leaf.m_count; ++lane) {
+                    uint32_t t = order[leaf.m_first + lane];
+                    glm::vec3 v0 = positions[indices[t * 3]];
+                    glm::vec3 e1 = positions[indices[t * 3 + 1]] - v0;
+                    glm::vec3 e2 = positions[indices[t * 3 + 2]] - v0;
+
+                    for (int axis = 0; axis < 3; ++axis) {
+                        packet.m_v0[axis][lane] = v0[axis];
+                        packet.m_e1[axis][lane] = e1[axis];
+                        packet.m_e2[axis][lane] = e2[axis];
+                    }
+                    packet.m_triangles[lane] = t;
+                }
+            }
+        }, 1 << 12);
+    }
+
+    [[nodiscard]] size_t node_count() const {
+        return m_nodes.size();
+    }
+
+    [[nodiscard]] size_t packet_count() const {
+        return m_packets.size();
+    }
+
+    // the closest hit within max_distance, if any
+    [[nodiscard]] RayHit intersect(const Ray &ray, float max_distance = INFINITY) const {
+        return traverse<false>(ray, max_distance);
+    }
+
+    // whether anything is hit within max_distance, which stops at the first
+    // hit instead of looking for the closest
+    [[nodiscard]] bool occluded(const Ray &ray, float max_distance = INFINITY) const {
+        return traverse<true>(ray, max_distance).hit();
+    }
+
+private:
+    template <bool Any>
+    [[nodiscard]] RayHit traverse(const Ray &ray, float max_distance) const {
+
+        RayHit hit;
+        hit.m_distance = max_distance;
+        if (m_nodes.empty())
+            return hit;
+
+        __m128 origin[3], inverse[3];
+        int near[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            float inv = 1.0f / ray.m_direction[axis];
+            origin[axis] = _mm_set1_ps(ray.m_origin[axis]);
+            inverse[axis] = _mm_set1_ps(inv);
+            // which side of the box the ray enters through
+            near[axis] = std::signbit(inv) ? 1 : 0;
+        }
+
+        struct Entry {
+            uint32_t m_node;
+            float m_distance;
+        };
+
+        // every node replaces itself with at most four children, so a level
+        // adds at most three entries
+        std::array<Entry, 3 * BvhBuilder::MAX_DEPTH + 1> stack;
+        size_t top = 0;
+        stack[top++] = { 0, 0.0f };
+
+        while (top != 0) {
+            Entry entry = stack[--top];
+
+            if (entry.m_distance > hit.m_distance)
+                continue;
+
+            if (entry.m_node & BVH_LEAF) {
+                if (intersect(m_packets[entry.m_node & ~BVH_LEAF], ray, hit) && Any)
+                    return hit;
+                continue;
+            }
+
+            auto &node = m_nodes[entry.m_node];
+
+            __m128 enter = _mm_setzero_ps();
+            __m128 leave = _mm_set1_ps(hit.m_distance);
+            for (int axis = 0; axis < 3; ++axis) {
+                __m128 near_plane = _mm_load_ps(node.m_bounds[near[axis]][axis]);
+                __m128 far_plane = _mm_load_ps(node.m_bounds[1 - near[axis]][axis]);
+                enter = _mm_max_ps(enter, _mm_mul_ps(_mm_sub_ps(near_plane, origin[axis]), inverse[axis]));
+                leave = _mm_min_ps(leave, _mm_mul_ps(_mm_sub_ps(far_plane, origin[axis]), inverse[axis]));
+            }
+
+            int mask = _mm_movemask_ps(_mm_cmple_ps(enter, leave));
+            if (mask == 0)
+                continue;
+
+            alignas(16) float distances[4];
+            _mm_store_ps(distances, enter);
+
+            // farthest first, so the nearest is popped next
+            size_t first = top;
+            for (int child = 0; child < 4; ++child) {
+                if ((mask & (1 << child)) == 0)
+                    continue;
+
+                Entry next { node.m_children[child], distances[child] };
+                size_t i = top++;
+                for (; i > first && stack[i - 1].m_distance < next.m_distance; --i)
+                    stack[i] = stack[i - 1];
+                stack[i] = next;
+            }
+        }
+
+        return hit;
+    }
+
+    // Turns the binary node and the ones below into 4-wide nodes, pulling up
+    // the children of the largest interior child until there are four.
+    uint32_t collapse(std::span<const BvhBuilder::Node> nodes, uint32_t index, std::vector<uint32_t> &leaves) {
+
+        auto &root = nodes[index];
+        std::array<uint32_t, 4> children;
+        size_t count = 0;
+
+        if (root.m_count != 0) {
+            children[count++] = index;
+        } else {
+            children[count++] = root.m_first;
+            children[count++] = root.m_first + 1;
+        }
+
+        while (count < 4) {
+            int largest = -1;
+            float largest_area = -1.0f;
+            for (size_t c = 0; c < count; ++c) {
+                auto &child = nodes[children[c]];
+                if (child.m_count == 0 && half_area(child.m_box) > largest_area) {
+                    largest = c;
+                    largest_area = half_area(child.m_box);
+                }
+            }
+
+            if (largest < 0)
+                break;
+
+            uint32_t first = nodes[children[largest]].m_first;
+            children[largest] = first;
+            children[count++] = first + 1;
+        }
+
+        uint32_t slot = m_nodes.size();
+        m_nodes.emplace_back();
+
+        std::array<uint32_t, 4> links;
+        links.fill(BVH_EMPTY);
+        for (size_t c = 0; c < count; ++c) {
+            if (nodes[children[c]].m_count != 0) {
+                links[c] = BVH_LEAF | static_cast<uint32_t>(leaves.size());
+                leaves.push_back(children[c]);
+            } else {
+                links[c] = collapse(nodes, children[c], leaves);
+            }
+        }
+
+        auto &node = m_nodes[slot];
+        for (int c = 0; c < 4; ++c) {
+            BoundingBox box = c < static_cast<int>(count) ? nodes[children[c]].m_box : BoundingBox { };
+            for (int axis = 0; axis < 3; ++axis) {
+                node.m_bounds[0][axis][c] = box.m_min[axis];
+                node.m_bounds[1][axis][c] = box.m_max[axis];
+            }
+            node.m_children[c] = links[c];
+        }
+
+        return slot;
+    }
+
+    // Moller-Trumbore on all four triangles at once, both sides count.
+    // Returns whether hit moved closer.
+    static bool intersect(const TrianglePacket &packet, const Ray &ray, RayHit &hit) {
+
+        __m128 d[3], o[3], v0[3], e1[3], e2[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            d[axis] = _mm_set1_ps(ray.m_direction[axis]);
+            o[axis] = _mm_set1_ps(ray.m_origin[axis]);
+            v0[axis] = _mm_load_ps(packet.m_v0[axis]);
+            e1[axis] = _mm_load_ps(packet.m_e1[axis]);
+            e2[axis] = _mm_load_ps(packet.m_e2[axis]);
+        }
+
+        auto cross = [](const __m128 *a, const __m128 *b, __m128 *out) {
+            out[0] = _mm_sub_ps(_mm_mul_ps(a[1], b[2]), _mm_mul_ps(a[2], b[1]));
+            out[1] = _mm_sub_ps(_mm_mul_ps(a[2], b[0]), _mm_mul_ps(a[0], b[2]));
+            out[2] = _mm_sub_ps(_mm_mul_ps(a[0], b[1]), _mm_mul_ps(a[1], b[0]));
+        };
+        auto dot = [](const __m128 *a, const __m128 *b) {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])), _mm_mul_ps(a[2], b[2]));
+        };
+
+        __m128 p[3], q[3], s[3];
+        cross(d, e2, p);
+        __m128 det = dot(e1, p);
+        __m128 inverse = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+        for (int axis = 0; axis < 3; ++axis)
+            s[axis] = _mm_sub_ps(o[axis], v0[axis]);
+        cross(s, e1, q);
+
+        __m128 u = _mm_mul_ps(dot(s, p), inverse);
+        __m128 v = _mm_mul_ps(dot(d, q), inverse);
+        __m128 t = _mm_mul_ps(dot(e2, q), inverse);
+
+        __m128 zero = _mm_setzero_ps();
+        __m128 hits = _mm_cmpneq_ps(det, zero);
+        hits = _mm_and_ps(hits, _mm_cmpge_ps(u, zero));
+        hits = _mm_and_ps(hits, _mm_cmpge_ps(v, zero));
+        hits = _mm_and_ps(hits, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+        hits = _mm_and_ps(hits, _mm_cmpgt_ps(t, zero));
+        hits = _mm_and_ps(hits, _mm_cmplt_ps(t, _mm_set1_ps(hit.m_distance)));
+
+        int mask = _mm_movemask_ps(hits);
+        if (mask == 0)
+            return false;
+
+        alignas(16) float ts[4], us[4], vs[4];
+        _mm_store_ps(ts, t);
+        _mm_store_ps(us, u);
+        _mm_store_ps(vs, v);
+
+        for (int lane = 0; lane < 4; ++lane) {
+            if ((mask & (1 << lane)) != 0 && ts[lane] < hit.m_distance)
+                hit = { ts[lane], packet.m_triangles[lane], us[lane], vs[lane] };
+        }
+
+        return true;
+    }
+};
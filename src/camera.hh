@@ -22,6 +22,10 @@ public:
         update_rotation();
     }
 
+    [[nodiscard]] glm::vec3 position() const {
+        return m_position;
+    }
+
     [[nodiscard]] glm::mat4 get_view_matrix() const {
         return glm::lookAt(m_position, m_position + m_direction, m_up);
     }
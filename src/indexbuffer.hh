@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <span>
+#include <vector>
 
 #include "glad/gl.h"
 #define GLFW_INCLUDE_NONE
@@ -16,23 +18,32 @@
 class IndexBuffer {
     GLuint m_id;
     size_t m_count;
+    GLenum m_type;
 
 public:
-    IndexBuffer(std::span<unsigned int> indices) : m_count(indices.size()) {
+    // indices are stored as 16 bit if every vertex can be addressed with them
+    IndexBuffer(std::span<const uint32_t> indices, size_t vertex_count)
+        : m_count(indices.size())
+        , m_type(vertex_count <= UINT16_MAX + 1 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT)
+    {
         glGenBuffers(1, &m_id);
         bind();
-        glBufferData(
-            GL_ELEMENT_ARRAY_BUFFER,
-            m_count * sizeof(unsigned int),
-            indices.data(),
-            GL_STATIC_DRAW
-        );
+
+        if (m_type == GL_UNSIGNED_SHORT) {
+            std::vector<uint16_t> narrow(indices.begin(), indices.end());
+            upload(std::span<const uint16_t>(narrow));
+        } else {
+            upload(indices);
+        }
     }
 
     ~IndexBuffer() {
         glDeleteBuffers(1, &m_id);
     }
 
+    IndexBuffer(IndexBuffer const&) = delete;
+    IndexBuffer& operator=(IndexBuffer const&) = delete;
+
     IndexBuffer &bind() {
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_id);
         return *this;
@@ -43,4 +54,24 @@ public:
         return *this;
     }
 
+    [[nodiscard]] size_t count() const {
+        return m_count;
+    }
+
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    [[nodiscard]] GLenum type() const {
+        return m_type;
+    }
+
+private:
+    template <typename T>
+    void upload(std::span<const T> indices) {
+        glBufferData(
+            GL_ELEMENT_ARRAY_BUFFER,
+            indices.size() * sizeof(T),
+            indices.data(),
+            GL_STATIC_DRAW
+        );
+    }
+
 };
@@ -0,0 +1,589 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hh"
+#include "meshopt.hh"
+#include "parallel.hh"
+
+
+
+// Around the center of the bounding box, not the smallest one, but close
+// enough to pick a level of detail.
+[[nodiscard]] inline BoundingSphere bounding_sphere(MeshView mesh) {
+    if (mesh.vertex_count() == 0)
+        return { };
+
+    BoundingSphere sphere;
+
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        auto vertices = mesh.vertices<A>();
+
+        glm::vec3 min(INFINITY), max(-INFINITY);
+        for (auto &vertex : vertices) {
+            min = glm::min(min, vertex.m_pos);
+            max = glm::max(max, vertex.m_pos);
+        }
+
+        sphere.m_center = (min + max) * 0.5f;
+        for (auto &vertex : vertices)
+            sphere.m_radius = std::max(sphere.m_radius, glm::length(vertex.m_pos - sphere.m_center));
+    });
+
+    return sphere;
+}
+
+// Sum of squared distances to a set of planes, weighted by area. Divided by
+// the total weight it is the mean squared distance of a point to them.
+struct Quadric {
+    double m_a00 = 0.0, m_a01 = 0.0, m_a02 = 0.0, m_a11 = 0.0, m_a12 = 0.0, m_a22 = 0.0;
+    double m_b0 = 0.0, m_b1 = 0.0, m_b2 = 0.0;
+    double m_c = 0.0;
+    double m_weight = 0.0;
+
+    // the plane dot(n, p) + d = 0, n has unit length
+    [[nodiscard]] static Quadric plane(glm::vec3 n, float d, double weight) {
+        Quadric q;
+        q.m_a00 = weight * n.x * n.x;
+        q.m_a01 = weight * n.x * n.y;
+        q.m_a02 = weight * n.x * n.z;
+        q.m_a11 = weight * n.y * n.y;
+        q.m_a12 = weight * n.y * n.z;
+        q.m_a22 = weight * n.z * n.z;
+        q.m_b0 = weight * n.x * d;
+        q.m_b1 = weight * n.y * d;
+        q.m_b2 = weight * n.z * d;
+        q.m_c = weight * d * d;
+        q.m_weight = weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &q) {
+        m_a00 += q.m_a00; m_a01 += q.m_a01; m_a02 += q.m_a02;
+        m_a11 += q.m_a11; m_a12 += q.m_a12; m_a22 += q.m_a22;
+        m_b0 += q.m_b0; m_b1 += q.m_b1; m_b2 += q.m_b2;
+        m_c += q.m_c;
+        m_weight += q.m_weight;
+        return *this;
+    }
+
+    [[nodiscard]] double error(glm::vec3 p) const {
+        double x = p.x, y = p.y, z = p.z;
+        double e = m_a00 * x * x + m_a11 * y * y + m_a22 * z * z
+                 + 2.0 * (m_a01 * x * y + m_a02 * x * z + m_a12 * y * z)
+                 + 2.0 * (m_b0 * x + m_b1 * y + m_b2 * z)
+                 + m_c;
+
+        return m_weight > 0.0 ? std::max(e, 0.0) / m_weight : 0.0;
+    }
+};
+
+// Quadric edge collapse (Garland, Heckbert 1997) of one range of triangles.
+// Vertices only ever collapse onto other vertices, so every level of detail
+// can share the vertex buffer of the full mesh.
+//
+// Vertices at the same position with different uvs or normals form a seam.
+// Seam vertices only move along the seam, both sides at once, and border
+// vertices only along the border, so neither ever opens up. Where that is
+// impossible, like at seam junctions, vertices are locked.
+class MeshSimplifier {
+    enum class Kind : uint8_t {
+        MANIFOLD,
+        BORDER,
+        SEAM,
+        LOCKED,
+    };
+
+    // a collapse of m_from onto m_to, and of m_from2 onto m_to2 on the
+    // other side of a seam
+    struct Collapse {
+        uint32_t m_from;
+        uint32_t m_to;
+        uint32_t m_from2;
+        uint32_t m_to2;
+        double m_cost;
+    };
+
+    // borders keep their shape much better than the surface next to them
+    static constexpr double BORDER_WEIGHT = 10.0;
+    static constexpr double SEAM_WEIGHT = 1.0;
+
+    std::span<const glm::vec3> m_positions;
+
+    // vertices are numbered densely within the range, see tipsify()
+    std::vector<uint32_t> m_globals;
+    std::vector<uint32_t> m_tris;
+
+    // vertices at the same position share a group, and form a ring
+    std::vector<uint32_t> m_group;
+    std::vector<uint32_t> m_next_wedge;
+    std::vector<Kind> m_kind;
+    std::vector<Quadric> m_quadrics;
+
+    // triangles around each vertex, which also tell which edges exist
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_adjacency;
+
+public:
+    // remap is as in tipsify()
+    MeshSimplifier(std::span<const glm::vec3> positions, std::span<const uint32_t> indices, std::span<uint32_t> remap)
+        : m_positions(positions)
+        , m_tris(indices.size())
+    {
+        for (size_t i = 0; i < indices.size(); ++i) {
+            uint32_t &local = remap[indices[i]];
+            if (local == UINT32_MAX) {
+                local = m_globals.size();
+                m_globals.push_back(indices[i]);
+            }
+            m_tris[i] = local;
+        }
+
+        for (uint32_t v : m_globals)
+            remap[v] = UINT32_MAX;
+
+        find_wedges();
+        find_adjacency();
+        classify();
+    }
+
+    // Collapses edges until at most target triangles are left, or until the
+    // next collapse would move the surface by more than max_error. Writes
+    // the remaining triangles to out and returns the largest distance any
+    // collapse moved the surface, roughly.
+    float simplify(size_t target, float max_error, std::vector<uint32_t> &out) {
+
+        double limit = double(max_error) * max_error;
+        double reached = 0.0;
+
+        std::vector<Collapse> collapses;
+        std::vector<bool> locked(m_quadrics.size());
+        std::vector<uint32_t> remap(m_globals.size());
+        std::iota(remap.begin(), remap.end(), 0);
+
+        while (m_tris.size() / 3 > target) {
+            find_adjacency();
+            find_collapses(collapses);
+
+            std::sort(collapses.begin(), collapses.end(), [](auto &a, auto &b) { return a.m_cost < b.m_cost; });
+            std::fill(locked.begin(), locked.end(), false);
+
+            size_t triangles = m_tris.size() / 3;
+            size_t removed = 0;
+
+            for (auto &collapse : collapses) {
+                if (triangles - removed <= target || collapse.m_cost > limit)
+                    break;
+
+                if (locked[m_group[collapse.m_from]] || locked[m_group[collapse.m_to]] || flips(collapse))
+                    continue;
+
+                removed += apply(collapse, remap, locked);
+                reached = std::max(reached, collapse.m_cost);
+            }
+
+            if (removed == 0)
+                break;
+
+            // the targets were locked, so nothing collapsed onto a vertex that moved
+            size_t kept = 0;
+            for (size_t t = 0; t < m_tris.size(); t += 3) {
+                uint32_t a = remap[m_tris[t]], b = remap[m_tris[t + 1]], c = remap[m_tris[t + 2]];
+
+                if (m_group[a] == m_group[b] || m_group[b] == m_group[c] || m_group[c] == m_group[a])
+                    continue;
+
+                m_tris[kept++] = a;
+                m_tris[kept++] = b;
+                m_tris[kept++] = c;
+            }
+
+            m_tris.resize(kept);
+            std::iota(remap.begin(), remap.end(), 0);
+        }
+
+        out.resize(m_tris.size());
+        for (size_t i = 0; i < m_tris.size(); ++i)
+            out[i] = m_globals[m_tris[i]];
+
+        return std::sqrt(reached);
+    }
+
+private:
+    [[nodiscard]] glm::vec3 position(uint32_t v) const {
+        return m_positions[m_globals[v]];
+    }
+
+    void find_wedges() {
+        size_t count = m_globals.size();
+
+        std::vector<uint32_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+
+        // exact positions, the parser gives every corner its own vertex
+        auto key = [&](uint32_t v) {
+            glm::vec3 p = position(v);
+            return std::tuple(std::bit_cast<uint32_t>(p.x), std::bit_cast<uint32_t>(p.y), std::bit_cast<uint32_t>(p.z));
+        };
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return key(a) < key(b); });
+
+        m_group.resize(count);
+        m_next_wedge.resize(count);
+
+        uint32_t groups = 0;
+        for (size_t begin = 0, end; begin < count; begin = end) {
+            for (end = begin + 1; end < count && key(order[end]) == key(order[begin]); ++end) { }
+
+            for (size_t i = begin; i < end; ++i) {
+                m_group[order[i]] = groups;
+                m_next_wedge[order[i]] = order[i + 1 < end ? i + 1 : begin];
+            }
+            groups++;
+        }
+
+        m_quadrics.assign(groups, { });
+    }
+
+    // whether a triangle has the directed edge a b
+    [[nodiscard]] bool has_edge(uint32_t a, uint32_t b) const {
+        for (uint32_t t : triangles_around(a)) {
+            for (size_t e = 0; e < 3; ++e) {
+                if (m_tris[t * 3 + e] == a && m_tris[t * 3 + (e + 1) % 3] == b)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // same, but any vertex at the position of a or b will do
+    [[nodiscard]] bool has_group_edge(uint32_t a, uint32_t b) const {
+        uint32_t wedge = a;
+        do {
+            for (uint32_t t : triangles_around(wedge)) {
+                for (size_t e = 0; e < 3; ++e) {
+                    if (m_tris[t * 3 + e] == wedge && m_group[m_tris[t * 3 + (e + 1) % 3]] == m_group[b])
+                        return true;
+                }
+            }
+            wedge = m_next_wedge[wedge];
+        } while (wedge != a);
+
+        return false;
+    }
+
+    // an edge only one triangle uses
+    [[nodiscard]] bool is_border(uint32_t a, uint32_t b) const {
+        return has_group_edge(a, b) != has_group_edge(b, a);
+    }
+
+    // an edge with a triangle on each side, whose vertices differ on each side
+    [[nodiscard]] bool is_seam(uint32_t a, uint32_t b) const {
+        return !is_border(a, b) && has_edge(a, b) != has_edge(b, a);
+    }
+
+    // plane through the edge a b, at a right angle to the triangle
+    void add_edge_quadric(uint32_t a, uint32_t b, glm::vec3 normal, double weight) {
+        glm::vec3 edge = position(b) - position(a);
+        glm::vec3 n = glm::cross(edge, normal);
+        float length = glm::length(n);
+        if (length == 0.0f)
+            return;
+
+        n /= length;
+        auto q = Quadric::plane(n, -glm::dot(n, position(a)), glm::dot(edge, edge) * weight);
+        m_quadrics[m_group[a]] += q;
+        m_quadrics[m_group[b]] += q;
+    }
+
+    void classify() {
+        std::vector<uint32_t> borders(m_quadrics.size(), 0);
+
+        for (size_t t = 0; t < m_tris.size(); t += 3) {
+            uint32_t v[3] = { m_tris[t], m_tris[t + 1], m_tris[t + 2] };
+
+            glm::vec3 normal = glm::cross(position(v[1]) - position(v[0]), position(v[2]) - position(v[0]));
+            float area = glm::length(normal);
+            if (area == 0.0f)
+                continue;
+
+            normal /= area;
+            auto q = Quadric::plane(normal, -glm::dot(normal, position(v[0])), area * 0.5);
+            for (uint32_t i : v)
+                m_quadrics[m_group[i]] += q;
+
+            for (size_t e = 0; e < 3; ++e) {
+                uint32_t a = v[e], b = v[(e + 1) % 3];
+
+                if (is_border(a, b)) {
+                    borders[m_group[a]]++;
+                    borders[m_group[b]]++;
+                    add_edge_quadric(a, b, normal, BORDER_WEIGHT);
+
+                } else if (is_seam(a, b)) {
+                    add_edge_quadric(a, b, normal, SEAM_WEIGHT);
+                }
+            }
+        }
+
+        m_kind.resize(m_globals.size());
+
+        for (size_t v = 0; v < m_globals.size(); ++v) {
+            bool single = m_next_wedge[v] == v;
+            bool pair = !single && m_next_wedge[m_next_wedge[v]] == v;
+            uint32_t border = borders[m_group[v]];
+
+            if (single && border == 0)
+                m_kind[v] = Kind::MANIFOLD;
+            else if (single && border == 2)
+                m_kind[v] = Kind::BORDER;
+            else if (pair && border == 0)
+                m_kind[v] = Kind::SEAM;
+            else
+                m_kind[v] = Kind::LOCKED;
+        }
+    }
+
+    void find_adjacency() {
+        m_offsets.assign(m_globals.size() + 1, 0);
+        for (uint32_t v : m_tris)
+            m_offsets[v + 1]++;
+        std::partial_sum(m_offsets.begin(), m_offsets.end(), m_offsets.begin());
+
+        m_adjacency.resize(m_tris.size());
+        std::vector<uint32_t> fill(m_offsets.begin(), m_offsets.end() - 1);
+        for (size_t i = 0; i < m_tris.size(); ++i)
+            m_adjacency[fill[m_tris[i]]++] = i / 3;
+    }
+
+    [[nodiscard]] std::span<const uint32_t> triangles_around(uint32_t v) const {
+        return std::span(m_adjacency).subspan(m_offsets[v], m_offsets[v + 1] - m_offsets[v]);
+    }
+
+    void find_collapses(std::vector<Collapse> &out) {
+        out.clear();
+
+        // fills in collapse if a may collapse onto b
+        auto consider = [&](uint32_t a, uint32_t b, Collapse &collapse) {
+            if (m_group[a] == m_group[b])
+                return false;
+
+            collapse = { a, b, UINT32_MAX, UINT32_MAX, 0.0 };
+
+            switch (m_kind[a]) {
+                case Kind::MANIFOLD:
+                    break;
+
+                case Kind::BORDER:
+                    if (!is_border(a, b) || (m_kind[b] != Kind::BORDER && m_kind[b] != Kind::LOCKED))
+                        return false;
+                    break;
+
+                case Kind::SEAM: {
+                    if (!is_seam(a, b) || (m_kind[b] != Kind::SEAM && m_kind[b] != Kind::LOCKED))
+                        return false;
+
+                    // the other side of the seam has to collapse the same way
+                    uint32_t a2 = m_next_wedge[a];
+                    for (uint32_t b2 = m_next_wedge[b]; b2 != b; b2 = m_next_wedge[b2]) {
+                        if (has_edge(a2, b2) || has_edge(b2, a2)) {
+                            collapse.m_from2 = a2;
+                            collapse.m_to2 = b2;
+                        }
+                    }
+
+                    if (collapse.m_from2 == UINT32_MAX)
+                        return false;
+                } break;
+
+                case Kind::LOCKED:
+                    return false;
+            }
+
+            collapse.m_cost = m_quadrics[m_group[a]].error(position(b));
+            return true;
+        };
+
+        // only the cheaper direction of each edge, and only from one of
+        // the triangles that share it
+        for (size_t t = 0; t < m_tris.size(); t += 3) {
+            for (size_t e = 0; e < 3; ++e) {
+                uint32_t a = m_tris[t + e], b = m_tris[t + (e + 1) % 3];
+                if (a > b && has_edge(b, a))
+                    continue;
+
+                Collapse forward, backward;
+                bool can_forward = consider(a, b, forward);
+                bool can_backward = consider(b, a, backward);
+
+                if (can_forward && (!can_backward || forward.m_cost <= backward.m_cost))
+                    out.push_back(forward);
+                else if (can_backward)
+                    out.push_back(backward);
+            }
+        }
+    }
+
+    // whether a triangle that survives the collapse would turn over
+    [[nodiscard]] bool flips(const Collapse &collapse) const {
+        uint32_t to_group = m_group[collapse.m_to];
+        glm::vec3 to = position(collapse.m_to);
+
+        for (uint32_t from : { collapse.m_from, collapse.m_from2 }) {
+            if (from == UINT32_MAX)
+                continue;
+
+            for (uint32_t t : triangles_around(from)) {
+                uint32_t v[3] = { m_tris[t * 3], m_tris[t * 3 + 1], m_tris[t * 3 + 2] };
+
+                if (m_group[v[0]] == to_group || m_group[v[1]] == to_group || m_group[v[2]] == to_group)
+                    continue;
+
+                glm::vec3 p[3] = { position(v[0]), position(v[1]), position(v[2]) };
+                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+
+                for (size_t i = 0; i < 3; ++i)
+                    p[i] = v[i] == from ? to : p[i];
+
+                glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+                if (glm::dot(before, after) <= 0.0f)
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    // returns the number of triangles that collapse with it
+    size_t apply(const Collapse &collapse, std::span<uint32_t> remap, std::vector<bool> &locked) {
+        uint32_t from_group = m_group[collapse.m_from];
+        uint32_t to_group = m_group[collapse.m_to];
+        size_t removed = 0;
+
+        remap[collapse.m_from] = collapse.m_to;
+        if (collapse.m_from2 != UINT32_MAX)
+            remap[collapse.m_from2] = collapse.m_to2;
+
+        m_quadrics[to_group] += m_quadrics[from_group];
+
+        // everything around the collapse changes, it has to wait for the next pass
+        for (uint32_t from : { collapse.m_from, collapse.m_from2 }) {
+            if (from == UINT32_MAX)
+                continue;
+
+            for (uint32_t t : triangles_around(from)) {
+                bool collapses = false;
+                for (size_t i = 0; i < 3; ++i) {
+                    locked[m_group[m_tris[t * 3 + i]]] = true;
+                    collapses |= m_group[m_tris[t * 3 + i]] == to_group;
+                }
+                removed += collapses;
+            }
+        }
+
+        return removed;
+    }
+
+};
+
+struct LodOptions {
+    // triangles of each level compared to the one before
+    float m_ratio = 0.5f;
+    // no more levels once one has this few triangles
+    size_t m_min_triangles = 256;
+    // error allowed for the first level relative to the bounding radius,
+    // each further level allows twice as much
+    float m_first_error = 0.002f;
+    size_t m_max_levels = 10;
+};
+
+// Builds a chain of ever simpler versions of the mesh, each from the one
+// before. Levels stop once they get small enough or barely simpler. Their
+// triangles are ordered for the vertex cache, like optimize_mesh() does for
+// the full mesh, which has to run before because it renumbers vertices.
+inline void build_lods(Mesh &mesh, LodOptions options = { }) {
+
+    mesh.m_lods.clear();
+    mesh.m_lod_indices.clear();
+    mesh.m_lod_submeshes.clear();
+
+    auto positions = mesh_positions(mesh.view());
+
+    float radius = bounding_sphere(mesh.view()).m_radius;
+
+    // the level before, one index list per submesh
+    std::vector<Submesh> submeshes(mesh.m_submeshes.begin(), mesh.m_submeshes.end());
+    if (submeshes.empty())
+        submeshes.push_back({ 0, 0, 0, static_cast<uint32_t>(mesh.m_indices.size()) });
+
+    std::vector<std::vector<uint32_t>> ranges(submeshes.size());
+    for (size_t i = 0; i < submeshes.size(); ++i) {
+        auto range = std::span(mesh.m_indices).subspan(submeshes[i].m_first, submeshes[i].m_count);
+        ranges[i].assign(range.begin(), range.end());
+    }
+
+    size_t triangles = mesh.m_indices.size() / 3;
+    size_t emitted = triangles;
+    float error = 0.0f;
+    float max_error = options.m_first_error * radius;
+
+    // a step that barely simplifies is kept for the next one, with twice
+    // the error allowed, but it does not make a level of its own
+    for (size_t step = 0; step < options.m_max_levels * 2; ++step) {
+
+        if (mesh.m_lods.size() == options.m_max_levels || triangles <= options.m_min_triangles)
+            break;
+
+        std::vector<float> errors(ranges.size(), 0.0f);
+
+        parallel_for(ranges.size(), [&](size_t begin, size_t end) {
+            std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+
+            for (size_t i = begin; i < end; ++i) {
+                size_t target = ranges[i].size() / 3 * options.m_ratio;
+                MeshSimplifier simplifier(positions, ranges[i], remap);
+                errors[i] = simplifier.simplify(target, max_error, ranges[i]);
+            }
+        });
+
+        // errors add up, each step starts from the one before
+        error += *std::max_element(errors.begin(), errors.end());
+        max_error *= 2.0f;
+
+        triangles = 0;
+        for (auto &range : ranges)
+            triangles += range.size() / 3;
+
+        if (triangles > emitted * 0.9f)
+            continue;
+
+        emitted = triangles;
+
+        MeshLod &lod = mesh.m_lods.emplace_back();
+        lod.m_error = error;
+        lod.m_first_submesh = mesh.m_lod_submeshes.size();
+        lod.m_submesh_count = submeshes.size();
+
+        std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+        std::vector<uint32_t> clusters;
+
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            Submesh submesh = submeshes[i];
+            submesh.m_first = mesh.m_lod_indices.size();
+            submesh.m_count = ranges[i].size();
+            mesh.m_lod_submeshes.push_back(submesh);
+
+            size_t first = mesh.m_lod_indices.size();
+            mesh.m_lod_indices.insert(mesh.m_lod_indices.end(), ranges[i].begin(), ranges[i].end());
+            tipsify(std::span(mesh.m_lod_indices).subspan(first), remap, clusters);
+        }
+    }
+}
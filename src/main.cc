@@ -9,6 +9,7 @@
 #include <memory>
 #include <span>
 #include <fstream>
+#include <chrono>
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -26,6 +27,14 @@
 #include "texture.hh"
 #include "camera.hh"
 #include "renderer.hh"
+#include "meshcache.hh"
+#include "meshopt.hh"
+#include "normals.hh"
+#include "lod.hh"
+#include "bvh.hh"
+#include "ao.hh"
+#include "texturecache.hh"
+#include "material.hh"
 
 #include "GL/gl.h"
 
@@ -61,8 +70,13 @@
     gladLoadGL(glfwGetProcAddress);
 
     glfwSetFramebufferSizeCallback(
-        window, []([[maybe_unused]] GLFWwindow* win, int w, int h) {
+        window, [](GLFWwindow* win, int w, int h) {
             glViewport(0, 0, w, h);
+
+            // a minimized window has no size, the last one is kept
+            auto *state = static_cast<State*>(glfwGetWindowUserPointer(win));
+            if (state != nullptr && w > 0 && h > 0)
+                state->viewport = { w, h };
         }
     );
 
@@ -72,10 +86,10 @@
 using GLFWKey = int;
 
 [[nodiscard]] static bool is_key_rising(GLFWwindow* window, GLFWKey key) {
-    static bool old = false;
+    static std::array<bool, GLFW_KEY_LAST + 1> old { };
     bool pressed = glfwGetKey(window, key) == GLFW_PRESS;
-    bool ret = !old && pressed;
-    old = pressed;
+    bool ret = !old[key] && pressed;
+    old[key] = pressed;
     return ret;
 }
 
@@ -91,6 +105,12 @@ static void process_inputs(GLFWwindow* window, State& state, float dt) {
 
     glPolygonMode(GL_FRONT_AND_BACK, state.polygon_mode ? GL_LINE : GL_FILL);
 
+    // frees the cursor for picking and the ImGui windows
+    if (is_key_rising(window, GLFW_KEY_TAB)) {
+        state.cursor_captured = !state.cursor_captured;
+        glfwSetInputMode(window, GLFW_CURSOR, state.cursor_captured ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+    }
+
     if (is_key_down(window, GLFW_KEY_ESCAPE))
         glfwSetWindowShouldClose(window, 1);
 
@@ -165,8 +185,32 @@ static void cursor_pos_callback(GLFWwindow *win, double x, double y) {
     glm::vec2 now(x, y);
 
     auto delta = now - old;
-    state.cam.rotate(delta);
+    if (state.cursor_captured)
+        state.cam.rotate(delta);
     old = now;
+    state.cursor = now;
+}
+
+// Picks what is under the cursor, or in the middle of the screen while the
+// cursor is captured and the camera looks where it moves.
+[[nodiscard]] static RayHit pick(GLFWwindow *window, const State &state, const Bvh &bvh, glm::vec3 pos) {
+
+    glm::vec2 ndc(0.0f);
+    if (!state.cursor_captured) {
+        int width, height;
+        glfwGetWindowSize(window, &width, &height);
+        ndc = { state.cursor.x / width * 2.0f - 1.0f, 1.0f - state.cursor.y / height * 2.0f };
+    }
+
+    return bvh.intersect(state.ray_through(ndc, pos));
+}
+
+// the submesh a triangle of the full detail mesh belongs to
+[[nodiscard]] static const Submesh *submesh_of(MeshView mesh, uint32_t triangle) {
+    auto it = std::upper_bound(mesh.m_submeshes.begin(), mesh.m_submeshes.end(), triangle * 3, [](uint32_t index, const Submesh &submesh) {
+        return index < submesh.m_first;
+    });
+    return it == mesh.m_submeshes.begin() ? nullptr : &*(it - 1);
 }
 
 static void scroll_callback(GLFWwindow* win, [[maybe_unused]] double x, double y) {
@@ -194,12 +238,55 @@ static void setup_gl() {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 }
 
+// parsing is skipped entirely if the mesh was cached by an earlier run
+[[nodiscard]] static std::variant<Mesh, CachedMesh> load_mesh(const char *filename) {
+
+    if (auto cached = CachedMesh::load(filename))
+        return std::move(*cached);
+
+    auto mesh = ObjParser(filename).parse();
+
+    // lighting needs normals, normal maps need tangents as well
+    if ((mesh.m_attribs & ATTRIB_NORMAL) == 0)
+        generate_normals(mesh);
+    generate_tangents(mesh);
+
+    auto [before, after] = optimize_mesh(mesh);
+    std::println("Vertex cache: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}",
+        before.m_acmr, after.m_acmr, before.m_atvr, after.m_atvr);
+
+    build_lods(mesh);
+    for (auto &lod : mesh.m_lods) {
+        auto submeshes = std::span(mesh.m_lod_submeshes).subspan(lod.m_first_submesh, lod.m_submesh_count);
+        size_t indices = 0;
+        for (auto &submesh : submeshes)
+            indices += submesh.m_count;
+        std::println("LOD: {} triangles, error {:.5f}", indices / 3, lod.m_error);
+    }
+
+    // of every level, the order it leaves within each submesh is the one
+    // that is drawn
+    build_meshlets(mesh);
+    std::println("Meshlets: {}", mesh.m_meshlets.size());
+
+    // after everything that moves or adds vertices, the levels share them
+    auto bake_start = std::chrono::steady_clock::now();
+    if (bake_occlusion(mesh)) {
+        std::chrono::duration<double> time = std::chrono::steady_clock::now() - bake_start;
+        std::println("Ambient occlusion: {} vertices in {:.2f} s", mesh.vertex_count(), time.count());
+    }
+
+    // the cache keeps the generated attributes, the optimized order, the
+    // levels, the meshlets and the occlusion, so this only happens once
+    CachedMesh::store(filename, mesh);
+    return mesh;
+}
+
 int main() {
 
     State state;
 
-    ObjParser parser("./backpack/backpack.obj");
-    auto vertices = parser.parse();
+    auto mesh = load_mesh("./backpack/backpack.obj");
 
     with_opengl_context([&](GLFWwindow* window) {
 
@@ -212,13 +299,22 @@ int main() {
         ImGui_ImplGlfw_InitForOpenGL(window, true);
         ImGui_ImplOpenGL3_Init();
 
-        Texture texture(GL_TEXTURE0, "./backpack/diffuse.jpg", false, GL_RGB);
-
         glfwSetWindowUserPointer(window, &state);
+        glfwGetFramebufferSize(window, &state.viewport.x, &state.viewport.y);
         glfwSetCursorPosCallback(window, cursor_pos_callback);
         glfwSetScrollCallback(window, scroll_callback);
 
-        Renderer rd(vertices);
+        auto view = std::visit([](auto &m) { return m.view(); }, mesh);
+        Renderer rd(view, VERTEX_FORMAT_COMPACT);
+
+        // built on the first pick, which only happens while the window for
+        // it is open, so a start does not wait for it
+        std::optional<Bvh> bvh;
+
+        glm::vec3 pos(0.0f);
+
+        TextureCache textures;
+        auto materials = load_materials(view, "./backpack", textures);
 
         auto callback = [&](GLFWwindow* window, double dt) {
 
@@ -227,7 +323,50 @@ int main() {
             ImGui::NewFrame();
             ImGui::ShowDemoWindow();
 
-            rd.render(texture, state, { 0.0f,  0.0f,  0.0f });
+            // before drawing, so a texture shows up the frame it is ready
+            size_t uploaded = textures.upload_ready();
+
+            rd.render(materials, state, pos);
+
+            auto &cull = rd.cull_stats();
+            ImGui::Begin("Culling");
+            ImGui::Checkbox("Back faces", &state.backface_culling);
+            ImGui::Text("Meshlets: %zu", cull.m_meshlets);
+            ImGui::Text("Outside the view: %zu", cull.m_outside);
+            ImGui::Text("Back-facing: %zu", cull.m_backfacing);
+            ImGui::Text("Culled: %.1f%%", cull.culled_ratio() * 100.0);
+            ImGui::End();
+
+            ImGui::Begin("Textures");
+            ImGui::Text("Loading: %zu", textures.pending());
+            ImGui::Text("Uploaded this frame: %zu", uploaded);
+            ImGui::End();
+
+            ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+            if (ImGui::Begin("Picking")) {
+                if (!bvh) {
+                    double build_start = glfwGetTime();
+                    bvh.emplace(view);
+                    std::println("BVH: {} nodes, {} leaves, built in {:.1f} ms",
+                        bvh->node_count(), bvh->packet_count(), (glfwGetTime() - build_start) * 1e3);
+                }
+
+                double pick_start = glfwGetTime();
+                auto hit = pick(window, state, *bvh, pos);
+                double pick_time = glfwGetTime() - pick_start;
+
+                ImGui::TextUnformatted(state.cursor_captured ? "Screen center, Tab frees the cursor" : "Cursor, Tab captures it");
+                if (const Submesh *submesh = hit.hit() ? submesh_of(view, hit.m_triangle) : nullptr) {
+                    ImGui::Text("Triangle: %u", hit.m_triangle);
+                    ImGui::Text("Group: %s", view.m_groups[submesh->m_group].c_str());
+                    ImGui::Text("Material: %s", view.m_materials[submesh->m_material].c_str());
+                    ImGui::Text("Distance: %.3f", hit.m_distance);
+                } else {
+                    ImGui::TextUnformatted("Nothing");
+                }
+                ImGui::Text("Time: %.1f us", pick_time * 1e6);
+            }
+            ImGui::End();
 
             ImGui::Render();
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
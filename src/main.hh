@@ -1,6 +1,7 @@
 #pragma once
 
 #include "camera.hh"
+#include "bvh.hh"
 
 static constexpr int WIDTH  = 1600;
 static constexpr int HEIGHT = 900;
@@ -11,4 +12,39 @@ struct State {
     Camera cam { { 0.0f, 0.0f, 3.0f } };
     float fov_deg = 45.0f;
     bool polygon_mode = false;
+    // drops back faces and the meshlets made of them, off by default as
+    // meshes with open or double-sided surfaces would lose faces
+    bool backface_culling = false;
+    // in window coordinates, only on screen while not captured for looking
+    // around
+    glm::vec2 cursor { 0.0f };
+    bool cursor_captured = true;
+    // of the framebuffer in pixels, which differs from the window size on
+    // HiDPI screens
+    glm::ivec2 viewport { WIDTH, HEIGHT };
+
+    // for a model placed at pos, as the renderer draws it
+    [[nodiscard]] glm::mat4 model_view_projection(glm::vec3 pos) const {
+        auto view = cam.get_view_matrix();
+
+        float aspect_ratio = static_cast<float>(viewport.x) / viewport.y;
+        auto proj = glm::perspective(glm::radians(fov_deg), aspect_ratio, 0.1f, 100.0f);
+
+        glm::mat4 model(1.0f);
+        model = glm::translate(model, pos);
+
+        return proj * view * model;
+    }
+
+    // The ray from the near plane through a point on screen, -1 to 1 from the
+    // bottom left, in the space of a model placed at pos.
+    [[nodiscard]] Ray ray_through(glm::vec2 ndc, glm::vec3 pos) const {
+        auto inverse = glm::inverse(model_view_projection(pos));
+
+        glm::vec4 near = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 far = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+        glm::vec3 origin = glm::vec3(near) / near.w;
+
+        return { origin, glm::normalize(glm::vec3(far) / far.w - origin) };
+    }
 };
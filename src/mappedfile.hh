@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdlib>
+#include <optional>
+#include <print>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+// read-only view of a whole file, backed by mmap(2)
+class MappedFile {
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+
+public:
+    MappedFile(const char *filename) : MappedFile(open_or_exit(filename)) { }
+
+    ~MappedFile() {
+        if (m_data != nullptr)
+            munmap(const_cast<char*>(m_data), m_size);
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    MappedFile(MappedFile &&other)
+        : m_data(std::exchange(other.m_data, nullptr))
+        , m_size(std::exchange(other.m_size, 0))
+    { }
+
+    // for files that are allowed to be missing, like caches
+    [[nodiscard]] static std::optional<MappedFile> try_open(const char *filename) {
+        int fd = open(filename, O_RDONLY);
+        if (fd == -1)
+            return { };
+
+        MappedFile file;
+
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            close(fd);
+            return { };
+        }
+        file.m_size = st.st_size;
+
+        // mapping an empty file is an error, so just leave the view empty
+        if (file.m_size != 0) {
+            void *data = mmap(nullptr, file.m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+
+            if (data == MAP_FAILED)
+                return { };
+
+            madvise(data, file.m_size, MADV_SEQUENTIAL);
+            file.m_data = static_cast<const char*>(data);
+            return file;
+        }
+
+        close(fd);
+        return file;
+    }
+
+    [[nodiscard]] std::string_view view() const {
+        return { m_data, m_size };
+    }
+
+    [[nodiscard]] size_t size() const {
+        return m_size;
+    }
+
+private:
+    MappedFile() = default;
+
+    [[nodiscard]] static MappedFile open_or_exit(const char *filename) {
+        auto file = try_open(filename);
+        if (!file) {
+            std::println(stderr, "Failed to map file: {}", filename);
+            exit(EXIT_FAILURE);
+        }
+        return std::move(*file);
+    }
+
+};
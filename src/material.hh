@@ -0,0 +1,304 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "obj.hh"
+#include "mesh.hh"
+#include "mappedfile.hh"
+#include "texturecache.hh"
+
+
+
+// One newmtl block of an MTL file. Map paths are relative to the MTL file
+// and empty if the material has no such map.
+struct Material {
+    std::string m_name;
+    glm::vec3 m_ambient { 1.0f };
+    glm::vec3 m_diffuse { 1.0f };
+    glm::vec3 m_specular { 0.0f };
+    glm::vec3 m_emissive { 0.0f };
+    float m_shininess = 0.0f;
+    float m_opacity = 1.0f;
+    int m_illum = 2;
+
+    std::string m_diffuse_map;
+    std::string m_specular_map;
+    std::string m_normal_map;
+    std::string m_alpha_map;
+};
+
+// Parses an MTL file with the OBJ lexer, the statements look the same.
+// Unknown statements are skipped with a warning, like in ObjChunkParser.
+class MtlParser {
+    MappedFile m_file;
+    ObjLexer m_lexer;
+    std::vector<Material> m_materials;
+
+public:
+    MtlParser(MappedFile file)
+    : m_file(std::move(file))
+    , m_lexer(m_file.view())
+    {
+        m_lexer.next();
+    }
+
+    // a missing material library is not an error, the materials get defaults
+    [[nodiscard]] static std::optional<MtlParser> open(const char *filename) {
+        auto file = MappedFile::try_open(filename);
+        if (!file) {
+            std::println(stderr, "Failed to open material library: {}", filename);
+            return { };
+        }
+        return MtlParser(std::move(*file));
+    }
+
+    [[nodiscard]] std::vector<Material> parse() {
+
+        while (!std::holds_alternative<TokenEof>(m_lexer.peek())) {
+            auto tok = m_lexer.peek();
+
+            if (std::holds_alternative<TokenIdent>(tok))
+                parse_statement(std::get<TokenIdent>(tok));
+
+            else if (std::holds_alternative<TokenNewline>(tok))
+                m_lexer.next();
+
+            else
+                skip_line(tok);
+        }
+
+        return std::move(m_materials);
+    }
+
+private:
+    // the keyword is still peeked, so names can be read with rest_of_line()
+    void parse_statement(std::string_view keyword) {
+
+        if (keyword == "newmtl") {
+            m_materials.emplace_back().m_name = m_lexer.rest_of_line();
+            return;
+        }
+
+        if (m_materials.empty()) {
+            skip_line(keyword);
+            return;
+        }
+
+        auto &mat = m_materials.back();
+
+        if (keyword == "map_Kd")        read_map(mat.m_diffuse_map);
+        else if (keyword == "map_Ks")   read_map(mat.m_specular_map);
+        else if (keyword == "map_d")    read_map(mat.m_alpha_map);
+
+        else if (keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump" || keyword == "norm")
+            read_map(mat.m_normal_map);
+
+        else
+            parse_values(mat, keyword);
+    }
+
+    void parse_values(Material &mat, std::string_view keyword) {
+        m_lexer.next();
+
+        if (keyword == "Ka")            read_vec3(mat.m_ambient);
+        else if (keyword == "Kd")       read_vec3(mat.m_diffuse);
+        else if (keyword == "Ks")       read_vec3(mat.m_specular);
+        else if (keyword == "Ke")       read_vec3(mat.m_emissive);
+        else if (keyword == "Ns")       read_float(mat.m_shininess);
+        else if (keyword == "d")        read_float(mat.m_opacity);
+
+        else if (keyword == "Tr") {
+            float transparency = 0.0f;
+            if (read_float(transparency))
+                mat.m_opacity = 1.0f - transparency;
+
+        } else if (keyword == "illum") {
+            float illum = 0.0f;
+            if (read_float(illum))
+                mat.m_illum = static_cast<int>(illum);
+
+        } else if (keyword == "Ni") {
+            m_lexer.skip_to_newline();
+
+        } else {
+            skip_line(keyword);
+        }
+    }
+
+    bool read_vec3(glm::vec3 &out) {
+        glm::vec3 value;
+        if (!read_float(value.x))
+            return false;
+
+        // a single value applies to all three channels
+        if (!std::holds_alternative<TokenNumber>(m_lexer.peek())) {
+            out = glm::vec3(value.x);
+            return true;
+        }
+
+        if (!read_float(value.y) || !read_float(value.z))
+            return false;
+
+        out = value;
+        return true;
+    }
+
+    bool read_float(float &out) {
+        auto tok = m_lexer.peek();
+        if (!std::holds_alternative<TokenNumber>(tok)) {
+            skip_line(tok);
+            return false;
+        }
+
+        m_lexer.next();
+        auto str = std::get<TokenNumber>(tok).m_str;
+        if (str.starts_with('+'))
+            str.remove_prefix(1);
+
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), out);
+        if (ec != std::errc() || ptr != str.data() + str.size()) {
+            skip_line(tok);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Options like "-bm 0.5" come before the file name and are ignored. The
+    // rest of the line is the name, spaces and all.
+    void read_map(std::string &out) {
+        auto args = m_lexer.rest_of_line();
+
+        auto next_word = [&] {
+            return std::string_view(args.begin(), std::ranges::find_if(args, ObjLexer::is_space));
+        };
+
+        auto skip_word = [&] {
+            auto end = std::ranges::find_if(args, ObjLexer::is_space);
+            args.remove_prefix(std::ranges::find_if_not(end, args.end(), ObjLexer::is_space) - args.begin());
+        };
+
+        // a name that only looks like an option is still a name
+        while (int values = map_option_values(next_word())) {
+            if (next_word().size() == args.size())
+                break;
+
+            skip_word();
+
+            // -o, -s and -t take one to three numbers, the others a fixed count
+            for (int i = 0; i < values && !args.empty(); ++i) {
+                if (values == 3 && i > 0 && !is_number(next_word()))
+                    break;
+                skip_word();
+            }
+        }
+
+        out = args;
+    }
+
+    // how many values an option of a map statement takes, 0 if it is none
+    [[nodiscard]] static int map_option_values(std::string_view option) {
+        if (option == "-mm")
+            return 2;
+
+        if (option == "-o" || option == "-s" || option == "-t")
+            return 3;
+
+        for (auto *one : { "-blendu", "-blendv", "-bm", "-boost", "-cc", "-clamp", "-imfchan", "-texres", "-type" }) {
+            if (option == one)
+                return 1;
+        }
+
+        return 0;
+    }
+
+    [[nodiscard]] static bool is_number(std::string_view word) {
+        if (word.starts_with('+'))
+            word.remove_prefix(1);
+
+        float value;
+        auto [ptr, ec] = std::from_chars(word.data(), word.data() + word.size(), value);
+        return ec == std::errc() && ptr == word.data() + word.size();
+    }
+
+    void skip_line(const Token &tok) {
+        std::println(stderr, "> Mtl Parser Warning:");
+        std::println(stderr, "Unsupported Instruction: `{}`", tok);
+        m_lexer.skip_to_newline();
+    }
+
+};
+
+// A material with its maps, in texture units 0 (diffuse), 1 (specular), 2
+// (normal) and 3 (alpha). Missing maps are white, maps still loading show a
+// placeholder.
+struct LoadedMaterial {
+    Material m_material;
+    std::shared_ptr<Texture> m_diffuse_map;
+    std::shared_ptr<Texture> m_specular_map;
+    std::shared_ptr<Texture> m_normal_map;
+    std::shared_ptr<Texture> m_alpha_map;
+};
+
+// Loads the materials of a mesh, indexed like Submesh::m_material. The
+// material libraries are looked up in dir, the maps next to them. Names
+// that no library defines get a white default material.
+[[nodiscard]] inline std::vector<LoadedMaterial>
+load_materials(MeshView mesh, const std::filesystem::path &dir, TextureCache &cache) {
+
+    std::unordered_map<std::string, Material> by_name;
+
+    for (auto &lib : mesh.m_material_libs) {
+        auto path = dir / lib;
+        auto parser = MtlParser::open(path.c_str());
+        if (!parser)
+            continue;
+
+        for (auto &mat : parser->parse()) {
+            for (auto *map : { &mat.m_diffuse_map, &mat.m_specular_map, &mat.m_normal_map, &mat.m_alpha_map }) {
+                if (!map->empty())
+                    *map = (path.parent_path() / *map).string();
+            }
+            by_name.try_emplace(mat.m_name, std::move(mat));
+        }
+    }
+
+    std::vector<LoadedMaterial> loaded;
+
+    // maps shared between materials are only decoded once, and are drawn
+    // with a placeholder until they are uploaded
+    auto get = [&](const std::string &map, GLenum format, BlockFormat block, MipOptions mips, Placeholder placeholder) {
+        return map.empty() ? cache.white() : cache.load_async({ map, false, format, 0, 0, block, mips }, placeholder);
+    };
+
+    for (auto &name : mesh.m_materials) {
+        auto &[mat, diffuse, specular, normal, alpha] = loaded.emplace_back();
+        auto it = by_name.find(name);
+
+        if (it != by_name.end())
+            mat = it->second;
+        else
+            mat.m_name = name;
+
+        // colors get the better format and sRGB aware mips and keep their
+        // alpha, normal maps only keep x and y and the shader rebuilds z
+        diffuse = get(mat.m_diffuse_map, GL_RGBA, BlockFormat::BC7, { .m_srgb = true }, PLACEHOLDER_WHITE);
+        specular = get(mat.m_specular_map, GL_RGB, BlockFormat::BC1, { }, PLACEHOLDER_WHITE);
+        normal = get(mat.m_normal_map, GL_RGB, BlockFormat::BC5, { }, PLACEHOLDER_FLAT_NORMAL);
+        // a single channel, which none of the block formats store
+        alpha = get(mat.m_alpha_map, GL_RED, BlockFormat::NONE, { }, PLACEHOLDER_WHITE);
+    }
+
+    return loaded;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "vertex.hh"
+
+
+
+// Indices m_first .. m_first + m_count that share a material and a group
+// (the g or o statement of an OBJ file). Submeshes are sorted by material,
+// so each material is one contiguous range.
+struct Submesh {
+    uint32_t m_material;
+    uint32_t m_group;
+    uint32_t m_first;
+    uint32_t m_count;
+};
+
+// A simplified version of the whole mesh that draws from the same vertices.
+// Its submeshes are m_lod_submeshes[m_first_submesh ...], one for each of the
+// full mesh, and their ranges index m_lod_indices.
+struct MeshLod {
+    // how far the surface may be from the full mesh, in model space
+    float m_error;
+    uint32_t m_first_submesh;
+    uint32_t m_submesh_count;
+};
+
+struct BoundingSphere {
+    glm::vec3 m_center { 0.0f };
+    float m_radius = 0.0f;
+};
+
+// A small cluster of triangles of one material, drawn as the index range
+// m_first .. m_first + m_count and culled as a whole, see build_meshlets().
+// The range counts the indices of the full mesh followed by the indices of
+// its levels of detail.
+struct Meshlet {
+    uint32_t m_material;
+    uint32_t m_first;
+    uint32_t m_count;
+    BoundingSphere m_bounds;
+    // all triangles face within the cone around m_cone_axis, m_cone_cutoff
+    // is the sine of its opening angle, 1 if it is too wide to ever cull
+    glm::vec3 m_cone_axis { 0.0f };
+    float m_cone_cutoff = 1.0f;
+};
+
+// Non-owning view of indexed mesh data, e.g. straight from a mapped cache
+// file. Vertices are PackedVertex<m_attribs>, see dispatch_attribs().
+struct MeshView {
+    unsigned m_attribs;
+    std::span<const std::byte> m_vertices;
+    std::span<const uint32_t> m_indices;
+    std::span<const Submesh> m_submeshes;
+    // indexed by Submesh::m_material and Submesh::m_group
+    std::span<const std::string> m_materials;
+    std::span<const std::string> m_groups;
+    // files the materials are defined in
+    std::span<const std::string> m_material_libs;
+    // levels of detail, ever simpler, see build_lods()
+    std::span<const MeshLod> m_lods;
+    std::span<const uint32_t> m_lod_indices;
+    std::span<const Submesh> m_lod_submeshes;
+    // of the full mesh, then of each level of detail, level i is
+    // m_meshlets[m_meshlet_levels[i] .. m_meshlet_levels[i + 1]]
+    std::span<const Meshlet> m_meshlets;
+    std::span<const uint32_t> m_meshlet_levels;
+
+    [[nodiscard]] size_t vertex_count() const {
+        return m_vertices.size() / vertex_stride(m_attribs);
+    }
+
+    template <unsigned A>
+    [[nodiscard]] std::span<const PackedVertex<A>> vertices() const {
+        return { reinterpret_cast<const PackedVertex<A>*>(m_vertices.data()), vertex_count() };
+    }
+};
+
+// Indexed triangle list, every vertex is unique.
+struct Mesh {
+    unsigned m_attribs = ATTRIB_POSITION;
+    std::vector<std::byte> m_vertices;
+    std::vector<uint32_t> m_indices;
+    std::vector<Submesh> m_submeshes;
+    std::vector<std::string> m_materials;
+    std::vector<std::string> m_groups;
+    std::vector<std::string> m_material_libs;
+    std::vector<MeshLod> m_lods;
+    std::vector<uint32_t> m_lod_indices;
+    std::vector<Submesh> m_lod_submeshes;
+    std::vector<Meshlet> m_meshlets;
+    std::vector<uint32_t> m_meshlet_levels;
+
+    [[nodiscard]] size_t vertex_count() const {
+        return m_vertices.size() / vertex_stride(m_attribs);
+    }
+
+    template <unsigned A>
+    [[nodiscard]] std::span<PackedVertex<A>> vertices() {
+        return { reinterpret_cast<PackedVertex<A>*>(m_vertices.data()), vertex_count() };
+    }
+
+    template <unsigned A>
+    [[nodiscard]] std::span<const PackedVertex<A>> vertices() const {
+        return view().vertices<A>();
+    }
+
+    template <unsigned A>
+    void resize_vertices(size_t count) {
+        m_attribs = A;
+        m_vertices.resize(count * sizeof(PackedVertex<A>));
+    }
+
+    [[nodiscard]] MeshView view() const {
+        return {
+            m_attribs,
+            m_vertices,
+            m_indices,
+            m_submeshes,
+            m_materials,
+            m_groups,
+            m_material_libs,
+            m_lods,
+            m_lod_indices,
+            m_lod_submeshes,
+            m_meshlets,
+            m_meshlet_levels,
+        };
+    }
+};
+
+// The position of every vertex, for the algorithms that need nothing else.
+[[nodiscard]] inline std::vector<glm::vec3> mesh_positions(MeshView mesh) {
+    std::vector<glm::vec3> positions(mesh.vertex_count());
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        auto vertices = mesh.vertices<A>();
+        for (size_t i = 0; i < vertices.size(); ++i)
+            positions[i] = vertices[i].m_pos;
+    });
+    return positions;
+}
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+
+#include "meshcache.hh"
+#include "sourcestamp.hh"
+
+
+
+namespace {
+
+[[nodiscard]] constexpr uint64_t align_up(uint64_t offset) {
+    return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+}
+
+[[nodiscard]] std::optional<std::span<const std::byte>>
+map_stream(std::string_view data, const MeshCacheStream &stream, size_t stride) {
+
+    if (stream.m_stride != stride || stream.m_offset % MESH_CACHE_ALIGNMENT != 0)
+        return { };
+
+    if (stream.m_offset > data.size() || stream.m_count > (data.size() - stream.m_offset) / stride)
+        return { };
+
+    auto *begin = reinterpret_cast<const std::byte*>(data.data() + stream.m_offset);
+    return std::span<const std::byte>(begin, stream.m_count * stride);
+}
+
+template <typename T>
+[[nodiscard]] std::optional<std::span<const T>>
+map_stream(std::string_view data, const MeshCacheStream &stream) {
+    auto bytes = map_stream(data, stream, sizeof(T));
+    if (!bytes)
+        return { };
+
+    return std::span<const T>(reinterpret_cast<const T*>(bytes->data()), stream.m_count);
+}
+
+// names are stored back to back, each one terminated by a zero byte
+[[nodiscard]] std::string join_names(std::span<const std::string> names) {
+    std::string joined;
+    for (auto &name : names) {
+        joined += name;
+        joined += '\0';
+    }
+    return joined;
+}
+
+[[nodiscard]] std::optional<std::vector<std::string>> split_names(std::span<const std::byte> bytes) {
+    std::string_view joined(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!joined.empty() && !joined.ends_with('\0'))
+        return { };
+
+    std::vector<std::string> names;
+    while (!joined.empty()) {
+        size_t end = joined.find('\0');
+        names.emplace_back(joined.substr(0, end));
+        joined.remove_prefix(end + 1);
+    }
+    return names;
+}
+
+// every index names a vertex
+[[nodiscard]] bool valid_indices(std::span<const uint32_t> indices, size_t vertex_count) {
+    return std::ranges::all_of(indices, [&](uint32_t index) { return index < vertex_count; });
+}
+
+// every range is whole triangles within the indices, with a known material
+// and group
+[[nodiscard]] bool valid_submeshes(
+    std::span<const Submesh> submeshes,
+    size_t index_count,
+    size_t material_count,
+    size_t group_count
+) {
+    return std::ranges::all_of(submeshes, [&](const Submesh &submesh) {
+        return submesh.m_material < material_count
+            && submesh.m_group < group_count
+            && submesh.m_first % 3 == 0
+            && submesh.m_count % 3 == 0
+            && submesh.m_first <= index_count
+            && submesh.m_count <= index_count - submesh.m_first;
+    });
+}
+
+[[nodiscard]] bool valid_lods(std::span<const MeshLod> lods, size_t submesh_count) {
+    return std::ranges::all_of(lods, [&](const MeshLod &lod) {
+        return lod.m_first_submesh <= submesh_count && lod.m_submesh_count <= submesh_count - lod.m_first_submesh;
+    });
+}
+
+// Every level is a range of meshlets, one for the full mesh and one for
+// each level of detail, and every meshlet is whole triangles within the
+// indices of both.
+[[nodiscard]] bool valid_meshlets(
+    std::span<const Meshlet> meshlets,
+    std::span<const uint32_t> levels,
+    size_t lod_count,
+    size_t index_count
+) {
+    if (levels.size() != lod_count + 2 || levels.front() != 0 || levels.back() != meshlets.size())
+        return false;
+
+    if (!std::ranges::is_sorted(levels))
+        return false;
+
+    return std::ranges::all_of(meshlets, [&](const Meshlet &meshlet) {
+        return meshlet.m_first % 3 == 0
+            && meshlet.m_count % 3 == 0
+            && meshlet.m_first <= index_count
+            && meshlet.m_count <= index_count - meshlet.m_first;
+    });
+}
+
+} // namespace
+
+[[nodiscard]] std::string CachedMesh::cache_path(const char *source) {
+    auto path = std::filesystem::weakly_canonical(source).string();
+    return std::format(".meshcache/{:016x}.mesh", hash_bytes(path));
+}
+
+[[nodiscard]] std::optional<CachedMesh> CachedMesh::load(const char *source) {
+
+    auto stamp = stamp_source(source);
+    if (!stamp)
+        return { };
+
+    auto path = cache_path(source);
+    auto file = MappedFile::try_open(path.c_str());
+    if (!file)
+        return { };
+
+    auto data = file->view();
+    if (data.size() < sizeof(MeshCacheHeader))
+        return { };
+
+    MeshCacheHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    if (memcmp(header.m_magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0)
+        return { };
+
+    if (header.m_version != MESH_CACHE_VERSION || header.m_source_size != stamp->m_size)
+        return { };
+
+    // the source was touched, but its content might still be the same
+    if (header.m_source_mtime != stamp->m_mtime) {
+        if (hash_source(source) != header.m_source_hash)
+            return { };
+
+        std::fstream out(path, std::ios::in | std::ios::out | std::ios::binary);
+        out.seekp(offsetof(MeshCacheHeader, m_source_mtime));
+        out.write(reinterpret_cast<const char*>(&stamp->m_mtime), sizeof(stamp->m_mtime));
+    }
+
+    size_t table_end = sizeof(MeshCacheHeader) + header.m_stream_count * sizeof(MeshCacheStream);
+    if (header.m_stream_count > 64 || table_end > data.size())
+        return { };
+
+    auto *streams = reinterpret_cast<const MeshCacheStream*>(data.data() + sizeof(MeshCacheHeader));
+
+    std::optional<std::span<const std::byte>> vertices;
+    std::optional<std::span<const uint32_t>> indices;
+    std::optional<std::span<const Submesh>> submeshes;
+    std::optional<std::span<const MeshLod>> lods;
+    std::optional<std::span<const uint32_t>> lod_indices;
+    std::optional<std::span<const Submesh>> lod_submeshes;
+    std::optional<std::span<const Meshlet>> meshlets;
+    std::optional<std::span<const uint32_t>> meshlet_levels;
+    std::optional<std::vector<std::string>> names[3];
+    unsigned attribs = 0;
+
+    for (auto &stream : std::span(streams, header.m_stream_count)) {
+        switch (stream.m_kind) {
+            case MeshStreamKind::VERTICES:
+                if (!is_valid_attribs(stream.m_attribs))
+                    return { };
+
+                attribs = stream.m_attribs;
+                vertices = map_stream(data, stream, vertex_stride(attribs));
+                break;
+
+            case MeshStreamKind::INDICES:
+                indices = map_stream<uint32_t>(data, stream);
+                break;
+
+            case MeshStreamKind::SUBMESHES:
+                submeshes = map_stream<Submesh>(data, stream);
+                break;
+
+            case MeshStreamKind::MATERIALS:
+            case MeshStreamKind::GROUPS:
+            case MeshStreamKind::MATERIAL_LIBS: {
+                auto bytes = map_stream(data, stream, 1);
+                if (!bytes)
+                    return { };
+
+                size_t i = static_cast<size_t>(stream.m_kind) - static_cast<size_t>(MeshStreamKind::MATERIALS);
+                names[i] = split_names(*bytes);
+            } break;
+
+            case MeshStreamKind::LODS:
+                lods = map_stream<MeshLod>(data, stream);
+                break;
+
+            case MeshStreamKind::LOD_INDICES:
+                lod_indices = map_stream<uint32_t>(data, stream);
+                break;
+
+            case MeshStreamKind::LOD_SUBMESHES:
+                lod_submeshes = map_stream<Submesh>(data, stream);
+                break;
+
+            case MeshStreamKind::MESHLETS:
+                meshlets = map_stream<Meshlet>(data, stream);
+                break;
+
+            case MeshStreamKind::MESHLET_LEVELS:
+                meshlet_levels = map_stream<uint32_t>(data, stream);
+                break;
+        }
+    }
+
+    if (!vertices || !indices || !submeshes || !names[0] || !names[1] || !names[2])
+        return { };
+
+    if (!lods || !lod_indices || !lod_submeshes || !meshlets || !meshlet_levels)
+        return { };
+
+    // a file that is damaged but still the right size must not send
+    // anything out of bounds, so every index and range is checked once
+    size_t vertex_count = vertices->size() / vertex_stride(attribs);
+    size_t material_count = names[0]->size(), group_count = names[1]->size();
+
+    if (!valid_indices(*indices, vertex_count) || !valid_indices(*lod_indices, vertex_count))
+        return { };
+
+    if (!valid_submeshes(*submeshes, indices->size(), material_count, group_count))
+        return { };
+
+    if (!valid_submeshes(*lod_submeshes, lod_indices->size(), material_count, group_count))
+        return { };
+
+    if (!valid_lods(*lods, lod_submeshes->size()))
+        return { };
+
+    if (!valid_meshlets(*meshlets, *meshlet_levels, lods->size(), indices->size() + lod_indices->size()))
+        return { };
+
+    CachedMesh mesh(std::move(*file), {
+        attribs, *vertices, *indices, *submeshes, { }, { }, { }, *lods, *lod_indices, *lod_submeshes, *meshlets, *meshlet_levels,
+    });
+    mesh.m_materials = std::move(*names[0]);
+    mesh.m_groups = std::move(*names[1]);
+    mesh.m_material_libs = std::move(*names[2]);
+    return mesh;
+}
+
+bool CachedMesh::store(const char *source, const Mesh &mesh) {
+
+    auto stamp = stamp_source(source);
+    auto hash = hash_source(source);
+    if (!stamp || !hash)
+        return false;
+
+    MeshCacheHeader header { };
+    memcpy(header.m_magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    header.m_version = MESH_CACHE_VERSION;
+    header.m_source_size = stamp->m_size;
+    header.m_source_mtime = stamp->m_mtime;
+    header.m_source_hash = *hash;
+
+    auto materials = join_names(mesh.m_materials);
+    auto groups = join_names(mesh.m_groups);
+    auto material_libs = join_names(mesh.m_material_libs);
+
+    struct StreamData {
+        MeshCacheStream m_stream;
+        const void *m_data;
+    };
+
+    StreamData streams[] = {
+        { { MeshStreamKind::VERTICES, static_cast<uint32_t>(vertex_stride(mesh.m_attribs)), mesh.vertex_count(), 0, mesh.m_attribs, 0 }, mesh.m_vertices.data() },
+        { { MeshStreamKind::INDICES, sizeof(uint32_t), mesh.m_indices.size(), 0, 0, 0 }, mesh.m_indices.data() },
+        { { MeshStreamKind::SUBMESHES, sizeof(Submesh), mesh.m_submeshes.size(), 0, 0, 0 }, mesh.m_submeshes.data() },
+        { { MeshStreamKind::MATERIALS, 1, materials.size(), 0, 0, 0 }, materials.data() },
+        { { MeshStreamKind::GROUPS, 1, groups.size(), 0, 0, 0 }, groups.data() },
+        { { MeshStreamKind::MATERIAL_LIBS, 1, material_libs.size(), 0, 0, 0 }, material_libs.data() },
+        { { MeshStreamKind::LODS, sizeof(MeshLod), mesh.m_lods.size(), 0, 0, 0 }, mesh.m_lods.data() },
+        { { MeshStreamKind::LOD_INDICES, sizeof(uint32_t), mesh.m_lod_indices.size(), 0, 0, 0 }, mesh.m_lod_indices.data() },
+        { { MeshStreamKind::LOD_SUBMESHES, sizeof(Submesh), mesh.m_lod_submeshes.size(), 0, 0, 0 }, mesh.m_lod_submeshes.data() },
+        { { MeshStreamKind::MESHLETS, sizeof(Meshlet), mesh.m_meshlets.size(), 0, 0, 0 }, mesh.m_meshlets.data() },
+        { { MeshStreamKind::MESHLET_LEVELS, sizeof(uint32_t), mesh.m_meshlet_levels.size(), 0, 0, 0 }, mesh.m_meshlet_levels.data() },
+    };
+
+    header.m_stream_count = std::size(streams);
+    uint64_t offset = align_up(sizeof(MeshCacheHeader) + header.m_stream_count * sizeof(MeshCacheStream));
+
+    for (auto &[stream, _] : streams) {
+        stream.m_offset = offset;
+        offset = align_up(offset + stream.m_count * stream.m_stride);
+    }
+
+    auto path = cache_path(source);
+    auto tmp_path = path + ".tmp";
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    std::ofstream out(tmp_path, std::ios::binary);
+
+    auto write_at = [&](uint64_t pos, const void *data, size_t size) {
+        // the gaps between streams are zero padding
+        static constexpr char padding[MESH_CACHE_ALIGNMENT] = { };
+        out.write(padding, pos - out.tellp());
+        out.write(static_cast<const char*>(data), size);
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for (auto &[stream, _] : streams)
+        out.write(reinterpret_cast<const char*>(&stream), sizeof(stream));
+
+    for (auto &[stream, data] : streams)
+        write_at(stream.m_offset, data, stream.m_count * stream.m_stride);
+
+    out.close();
+
+    if (!out) {
+        std::println(stderr, "Failed to write mesh cache: {}", path);
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+
+    // readers never see a partially written cache
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
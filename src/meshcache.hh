@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "mesh.hh"
+#include "mappedfile.hh"
+
+
+
+// Binary mesh cache file layout. Everything is little-endian and every
+// stream starts at a multiple of MESH_CACHE_ALIGNMENT from the start of the
+// file, so mapped streams can be used in place.
+//
+//   MeshCacheHeader
+//   MeshCacheStream[m_stream_count]
+//   stream data...
+
+static constexpr char MESH_CACHE_MAGIC[8] = { 'G', 'L', 'F', 'M', 'E', 'S', 'H', '\0' };
+static constexpr uint32_t MESH_CACHE_VERSION = 8;
+static constexpr size_t MESH_CACHE_ALIGNMENT = 64;
+
+enum class MeshStreamKind : uint32_t {
+    VERTICES,
+    INDICES,
+    SUBMESHES,
+    // names, each terminated by a zero byte, with a stride of 1
+    MATERIALS,
+    GROUPS,
+    MATERIAL_LIBS,
+    LODS,
+    LOD_INDICES,
+    LOD_SUBMESHES,
+    MESHLETS,
+    MESHLET_LEVELS,
+};
+
+struct MeshCacheHeader {
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_stream_count;
+    // the source file the cache was built from
+    uint64_t m_source_size;
+    int64_t m_source_mtime;
+    uint64_t m_source_hash;
+    uint64_t m_reserved[3];
+};
+
+struct MeshCacheStream {
+    MeshStreamKind m_kind;
+    uint32_t m_stride;
+    uint64_t m_count;
+    uint64_t m_offset;
+    // VertexAttrib mask of a vertex stream, 0 otherwise
+    uint32_t m_attribs;
+    uint32_t m_reserved;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 64);
+static_assert(sizeof(MeshCacheStream) == 32);
+
+// Mesh mapped directly from its cache file, nothing is parsed or copied.
+class CachedMesh {
+    MappedFile m_file;
+    MeshView m_view;
+    // names are small and need to be owned, so they are copied out
+    std::vector<std::string> m_materials;
+    std::vector<std::string> m_groups;
+    std::vector<std::string> m_material_libs;
+
+public:
+    // Returns nothing if there is no cache file for source yet, or if the
+    // source changed since it was written.
+    [[nodiscard]] static std::optional<CachedMesh> load(const char *source);
+
+    // Writes the cache file for source. Failing to do so is not an error,
+    // the source just has to be parsed again next time.
+    static bool store(const char *source, const Mesh &mesh);
+
+    [[nodiscard]] MeshView view() const {
+        MeshView view = m_view;
+        view.m_materials = m_materials;
+        view.m_groups = m_groups;
+        view.m_material_libs = m_material_libs;
+        return view;
+    }
+
+private:
+    CachedMesh(MappedFile file, MeshView view)
+        : m_file(std::move(file))
+        , m_view(view)
+    { }
+
+    [[nodiscard]] static std::string cache_path(const char *source);
+
+};
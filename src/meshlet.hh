@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hh"
+#include "lod.hh"
+#include "meshopt.hh"
+#include "parallel.hh"
+
+
+
+// The sizes mesh shading hardware is tuned for. 124 triangles leave room for
+// the primitive count in a 128 byte block of indices.
+static constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+static constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Bounds of the triangles in indices, which are already in the index buffer
+// at first.
+[[nodiscard]] inline Meshlet
+make_meshlet(std::span<const glm::vec3> positions, std::span<const uint32_t> indices, uint32_t material, uint32_t first) {
+
+    Meshlet meshlet { material, first, static_cast<uint32_t>(indices.size()), { } };
+
+    glm::vec3 min(INFINITY), max(-INFINITY);
+    for (uint32_t v : indices) {
+        min = glm::min(min, positions[v]);
+        max = glm::max(max, positions[v]);
+    }
+
+    meshlet.m_bounds.m_center = (min + max) * 0.5f;
+    for (uint32_t v : indices)
+        meshlet.m_bounds.m_radius = std::max(meshlet.m_bounds.m_radius, glm::length(positions[v] - meshlet.m_bounds.m_center));
+
+    std::array<glm::vec3, MESHLET_MAX_TRIANGLES> normals;
+    size_t normal_count = 0;
+    glm::vec3 axis(0.0f);
+
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        glm::vec3 a = positions[indices[t]];
+        glm::vec3 n = glm::cross(positions[indices[t + 1]] - a, positions[indices[t + 2]] - a);
+        float length = glm::length(n);
+
+        // degenerate triangles are never visible, they do not widen the cone
+        if (length == 0.0f || normal_count == normals.size())
+            continue;
+
+        normals[normal_count++] = n / length;
+        axis += n / length;
+    }
+
+    float length = glm::length(axis);
+    if (normal_count == 0 || length == 0.0f)
+        return meshlet;
+
+    meshlet.m_cone_axis = axis / length;
+
+    float min_dot = 1.0f;
+    for (size_t i = 0; i < normal_count; ++i)
+        min_dot = std::min(min_dot, glm::dot(meshlet.m_cone_axis, normals[i]));
+
+    // past about 84 degrees the cone hardly ever faces away as a whole
+    if (min_dot > 0.1f)
+        meshlet.m_cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+
+    return meshlet;
+}
+
+// Splits the triangles of indices into meshlets and reorders them so each one
+// is a contiguous range. A meshlet grows from the first triangle left over
+// the neighbour that is closest to its center, faces most like it and adds
+// the fewest vertices, which keeps it round and its normal cone narrow. It
+// ends at either limit or when no neighbour is left. The triangles within
+// each meshlet are then put in vertex cache order with tipsify().
+//
+// remap has one entry per vertex of the mesh, all UINT32_MAX, and is left
+// that way, as for tipsify().
+inline void build_meshlets(
+    std::span<const glm::vec3> positions,
+    std::span<uint32_t> indices,
+    std::span<uint32_t> remap,
+    uint32_t material,
+    uint32_t first,
+    std::vector<Meshlet> &out
+) {
+    std::vector<uint32_t> globals;
+    std::vector<uint32_t> tris(indices.size());
+
+    for (size_t i = 0; i < indices.size(); ++i) {
+        uint32_t &local = remap[indices[i]];
+        if (local == UINT32_MAX) {
+            local = globals.size();
+            globals.push_back(indices[i]);
+        }
+        tris[i] = local;
+    }
+
+    for (uint32_t v : globals)
+        remap[v] = UINT32_MAX;
+
+    size_t vertex_count = globals.size();
+    size_t triangle_count = indices.size() / 3;
+
+    // triangles around each vertex
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v : tris)
+        offsets[v + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> adjacency(tris.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < tris.size(); ++i)
+        adjacency[fill[tris[i]]++] = i / 3;
+
+    std::vector<glm::vec3> normals(triangle_count);
+    std::vector<glm::vec3> centroids(triangle_count);
+    for (size_t t = 0; t < triangle_count; ++t) {
+        glm::vec3 a = positions[globals[tris[t * 3]]];
+        glm::vec3 b = positions[globals[tris[t * 3 + 1]]];
+        glm::vec3 c = positions[globals[tris[t * 3 + 2]]];
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        normals[t] = length == 0.0f ? n : n / length;
+        centroids[t] = (a + b + c) / 3.0f;
+    }
+
+    // meshlet a vertex was last added to, plus one
+    std::vector<uint32_t> owner(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    std::vector<uint32_t> clusters;
+
+    uint32_t meshlet = 0;
+    size_t cursor = 0;
+
+    while (true) {
+        while (cursor < triangle_count && emitted[cursor])
+            cursor++;
+
+        if (cursor == triangle_count)
+            break;
+
+        meshlet++;
+        size_t begin = sorted.size();
+        std::array<uint32_t, MESHLET_MAX_VERTICES> vertices;
+        size_t used = 0;
+        glm::vec3 axis(0.0f);
+        glm::vec3 center(0.0f);
+
+        auto new_vertices = [&](size_t t) {
+            uint32_t a = tris[t * 3], b = tris[t * 3 + 1], c = tris[t * 3 + 2];
+            return (owner[a] != meshlet) + (owner[b] != meshlet && b != a) + (owner[c] != meshlet && c != a && c != b);
+        };
+
+        size_t next = cursor;
+
+        while (next != SIZE_MAX) {
+            emitted[next] = true;
+            axis += normals[next];
+            center += centroids[next];
+
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = tris[next * 3 + k];
+                sorted.push_back(globals[v]);
+                if (owner[v] != meshlet) {
+                    owner[v] = meshlet;
+                    vertices[used++] = v;
+                }
+            }
+
+            if ((sorted.size() - begin) / 3 == MESHLET_MAX_TRIANGLES)
+                break;
+
+            next = SIZE_MAX;
+            float best_cost = INFINITY;
+            float axis_length = glm::length(axis);
+            glm::vec3 mean_axis = axis_length == 0.0f ? axis : axis / axis_length;
+            glm::vec3 mean_center = center / float((sorted.size() - begin) / 3);
+
+            for (size_t i = 0; i < used; ++i) {
+                for (uint32_t k = offsets[vertices[i]]; k < offsets[vertices[i] + 1]; ++k) {
+                    uint32_t t = adjacency[k];
+                    if (emitted[t])
+                        continue;
+
+                    int added = new_vertices(t);
+                    if (used + added > MESHLET_MAX_VERTICES)
+                        continue;
+
+                    // a neighbour turned away costs as much as one much further off
+                    float distance = glm::length(centroids[t] - mean_center);
+                    float cost = distance * (1.0f + 16.0f * (1.0f - glm::dot(normals[t], mean_axis))) * (1 + added);
+
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        next = t;
+                    }
+                }
+            }
+        }
+
+        // the greedy growth above ignores the vertex cache, the order within
+        // a meshlet is free, so it gets back what optimize_mesh() achieved
+        size_t count = sorted.size() - begin;
+        auto triangles = std::span(sorted).subspan(begin, count);
+        tipsify(triangles, remap, clusters);
+
+        out.push_back(make_meshlet(positions, triangles, material, first + begin));
+    }
+
+    std::copy(sorted.begin(), sorted.end(), indices.begin());
+}
+
+// Splits every submesh of the full mesh and of its levels of detail into
+// meshlets, in parallel, and reorders the triangles of each one in place so
+// its meshlets are contiguous. The meshlets replace those the mesh had.
+//
+// The order this leaves is the one that is drawn and cached: it starts each
+// meshlet from the earliest triangle left in the order optimize_mesh() made
+// and keeps the vertex cache within meshlets, but not across them.
+inline void build_meshlets(Mesh &mesh) {
+
+    auto positions = mesh_positions(mesh.view());
+
+    struct Range {
+        uint32_t m_material;
+        // in the full mesh's indices followed by those of the levels
+        uint32_t m_first;
+        std::span<uint32_t> m_indices;
+    };
+
+    // those of each level follow each other
+    std::vector<Range> ranges;
+    std::vector<size_t> level_ranges { 0 };
+
+    auto indices = std::span(mesh.m_indices);
+    auto lod_indices = std::span(mesh.m_lod_indices);
+
+    if (mesh.m_submeshes.empty())
+        ranges.push_back({ 0, 0, indices });
+
+    for (auto &submesh : mesh.m_submeshes)
+        ranges.push_back({ submesh.m_material, submesh.m_first, indices.subspan(submesh.m_first, submesh.m_count) });
+
+    level_ranges.push_back(ranges.size());
+
+    for (auto &lod : mesh.m_lods) {
+        for (auto &submesh : std::span(mesh.m_lod_submeshes).subspan(lod.m_first_submesh, lod.m_submesh_count)) {
+            uint32_t first = indices.size() + submesh.m_first;
+            ranges.push_back({ submesh.m_material, first, lod_indices.subspan(submesh.m_first, submesh.m_count) });
+        }
+        level_ranges.push_back(ranges.size());
+    }
+
+    std::vector<std::vector<Meshlet>> split(ranges.size());
+
+    parallel_for(ranges.size(), [&](size_t begin, size_t end) {
+        std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+
+        for (size_t i = begin; i < end; ++i)
+            build_meshlets(positions, ranges[i].m_indices, remap, ranges[i].m_material, ranges[i].m_first, split[i]);
+    });
+
+    mesh.m_meshlets.clear();
+    mesh.m_meshlet_levels.assign(1, 0);
+
+    for (size_t level = 0; level + 1 < level_ranges.size(); ++level) {
+        for (size_t i = level_ranges[level]; i < level_ranges[level + 1]; ++i)
+            mesh.m_meshlets.insert(mesh.m_meshlets.end(), split[i].begin(), split[i].end());
+        mesh.m_meshlet_levels.push_back(mesh.m_meshlets.size());
+    }
+}
+
+// The six planes of a view volume, pointing inwards, in the space the matrix
+// transforms from (Gribb, Hartmann 2001).
+class Frustum {
+    std::array<glm::vec4, 6> m_planes;
+
+public:
+    explicit Frustum(const glm::mat4 &matrix) {
+        auto row = [&](int i) {
+            return glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+        };
+
+        for (int i = 0; i < 3; ++i) {
+            m_planes[i * 2]     = row(3) + row(i);
+            m_planes[i * 2 + 1] = row(3) - row(i);
+        }
+
+        // normalized, so the plane equation gives distances
+        for (auto &plane : m_planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    [[nodiscard]] bool intersects(const BoundingSphere &sphere) const {
+        for (auto &plane : m_planes)
+            if (glm::dot(glm::vec3(plane), sphere.m_center) + plane.w < -sphere.m_radius)
+                return false;
+
+        return true;
+    }
+};
+
+struct CullStats {
+    size_t m_meshlets = 0;
+    size_t m_outside = 0;
+    size_t m_backfacing = 0;
+
+    [[nodiscard]] double culled_ratio() const {
+        return m_meshlets == 0 ? 0.0 : double(m_outside + m_backfacing) / m_meshlets;
+    }
+};
+
+// Sets visible[i] for every meshlet that is at least partly inside the view
+// volume of mvp and, with backfaces, has a triangle facing the camera, both
+// in model space. Back-facing meshlets may only be dropped if their
+// triangles would be culled anyway, so backfaces needs GL_CULL_FACE on.
+inline CullStats
+cull_meshlets(std::span<const Meshlet> meshlets, const glm::mat4 &mvp, glm::vec3 camera, bool backfaces, std::span<uint8_t> visible) {
+
+    // on the calling thread, threads made every frame would cost more than
+    // the few microseconds this takes
+    Frustum frustum(mvp);
+    size_t outside = 0, backfacing = 0;
+
+    for (size_t i = 0; i < meshlets.size(); ++i) {
+        auto &meshlet = meshlets[i];
+        glm::vec3 to_center = meshlet.m_bounds.m_center - camera;
+
+        // the cone test from meshoptimizer, conservative for the whole
+        // sphere instead of just the apex
+        bool facing_away = backfaces && glm::dot(to_center, meshlet.m_cone_axis)
+            >= meshlet.m_cone_cutoff * glm::length(to_center) + meshlet.m_bounds.m_radius;
+        bool inside = !facing_away && frustum.intersects(meshlet.m_bounds);
+
+        backfacing += facing_away;
+        outside += !facing_away && !inside;
+        visible[i] = inside;
+    }
+
+    return { meshlets.size(), outside, backfacing };
+}
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hh"
+#include "parallel.hh"
+
+
+
+// FIFO size assumed for the post-transform cache. Hardware differs, but an
+// order that is good for 16 entries is good for its neighbours as well.
+static constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+// Transformed vertices per triangle (ACMR, 3 at worst, around 0.6 for good
+// orders of large meshes) and per referenced vertex (ATVR, 1 at best).
+struct VertexCacheStats {
+    double m_acmr = 0.0;
+    double m_atvr = 0.0;
+};
+
+[[nodiscard]] inline VertexCacheStats
+analyze_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count, uint32_t cache_size = VERTEX_CACHE_SIZE) {
+
+    // miss count at the time a vertex was last loaded, 0 for never
+    std::vector<size_t> loaded(vertex_count, 0);
+    size_t misses = 0;
+    size_t used = 0;
+
+    for (uint32_t v : indices) {
+        if (loaded[v] != 0 && misses - loaded[v] < cache_size)
+            continue;
+
+        used += loaded[v] == 0;
+        loaded[v] = ++misses;
+    }
+
+    if (indices.empty())
+        return { };
+
+    return { double(misses) / (indices.size() / 3), double(misses) / used };
+}
+
+// Reorders the triangles of indices for the vertex cache with Tipsify (Sander,
+// Nehab, Barczak 2007), in linear time. The first triangle of every cluster,
+// the runs that were emitted without jumping elsewhere, is written to
+// clusters.
+//
+// remap has one entry per vertex of the mesh, all UINT32_MAX, and is left
+// that way. It lets each range work on its own dense vertex numbers.
+inline void tipsify(
+    std::span<uint32_t> indices,
+    std::span<uint32_t> remap,
+    std::vector<uint32_t> &clusters,
+    uint32_t cache_size = VERTEX_CACHE_SIZE
+) {
+    clusters.clear();
+
+    std::vector<uint32_t> globals;
+    std::vector<uint32_t> tris(indices.size());
+
+    for (size_t i = 0; i < indices.size(); ++i) {
+        uint32_t &local = remap[indices[i]];
+        if (local == UINT32_MAX) {
+            local = globals.size();
+            globals.push_back(indices[i]);
+        }
+        tris[i] = local;
+    }
+
+    for (uint32_t v : globals)
+        remap[v] = UINT32_MAX;
+
+    size_t vertex_count = globals.size();
+    if (vertex_count == 0)
+        return;
+
+    // triangles around each vertex
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v : tris)
+        offsets[v + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> adjacency(tris.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < tris.size(); ++i)
+        adjacency[fill[tris[i]]++] = i / 3;
+
+    // triangles left around each vertex
+    std::vector<uint32_t> live(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v)
+        live[v] = offsets[v + 1] - offsets[v];
+
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(tris.size() / 3, false);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+
+    uint32_t time = cache_size + 1;
+    uint32_t cursor = 0;
+    uint32_t fan = 0;
+    bool jumped = true;
+    size_t out = 0;
+
+    while (fan != UINT32_MAX) {
+        if (jumped)
+            clusters.push_back(out / 3);
+
+        candidates.clear();
+
+        for (uint32_t k = offsets[fan]; k < offsets[fan + 1]; ++k) {
+            uint32_t t = adjacency[k];
+            if (emitted[t])
+                continue;
+
+            emitted[t] = true;
+
+            for (uint32_t v : { tris[t * 3], tris[t * 3 + 1], tris[t * 3 + 2] }) {
+                indices[out++] = globals[v];
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if (time - cache_time[v] > cache_size)
+                    cache_time[v] = time++;
+            }
+        }
+
+        // fan around the neighbour that will still be in the cache once all
+        // its triangles are out, the oldest one of those is the most urgent
+        uint32_t next = UINT32_MAX;
+        int64_t best = -1;
+
+        for (uint32_t v : candidates) {
+            if (live[v] == 0)
+                continue;
+
+            int64_t priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= cache_size)
+                priority = time - cache_time[v];
+
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        jumped = next == UINT32_MAX;
+
+        while (next == UINT32_MAX && !dead_end.empty()) {
+            uint32_t v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v] != 0)
+                next = v;
+        }
+
+        while (next == UINT32_MAX && cursor < vertex_count) {
+            if (live[cursor] != 0)
+                next = cursor;
+            cursor++;
+        }
+
+        fan = next;
+    }
+}
+
+// Sorts the clusters found by tipsify() so the ones facing away from the
+// center of the range come first. They tend to occlude the others, so fewer
+// fragments get shaded twice. The new order is only kept if its ACMR stays
+// within threshold times the old one.
+inline void optimize_overdraw(
+    std::span<uint32_t> indices,
+    std::span<const glm::vec3> positions,
+    std::span<const uint32_t> clusters,
+    float threshold
+) {
+    size_t cluster_count = clusters.size();
+    if (cluster_count < 2)
+        return;
+
+    auto triangle = [&](size_t t) {
+        glm::vec3 a = positions[indices[t * 3]];
+        glm::vec3 b = positions[indices[t * 3 + 1]];
+        glm::vec3 c = positions[indices[t * 3 + 2]];
+        return std::pair((a + b + c) / 3.0f, glm::cross(b - a, c - a));
+    };
+
+    // area weighted, the length of the cross product is twice the area
+    glm::vec3 center(0.0f);
+    float area = 0.0f;
+
+    std::vector<glm::vec3> centroids(cluster_count, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(cluster_count, glm::vec3(0.0f));
+    std::vector<float> areas(cluster_count, 0.0f);
+
+    for (size_t c = 0; c < cluster_count; ++c) {
+        size_t end = c + 1 < cluster_count ? clusters[c + 1] : indices.size() / 3;
+
+        for (size_t t = clusters[c]; t < end; ++t) {
+            auto [centroid, normal] = triangle(t);
+            float a = glm::length(normal);
+
+            centroids[c] += centroid * a;
+            normals[c] += normal;
+            areas[c] += a;
+        }
+
+        center += centroids[c];
+        area += areas[c];
+    }
+
+    if (area == 0.0f)
+        return;
+
+    center /= area;
+
+    std::vector<float> keys(cluster_count, 0.0f);
+    for (size_t c = 0; c < cluster_count; ++c) {
+        float length = glm::length(normals[c]);
+        if (areas[c] != 0.0f && length != 0.0f)
+            keys[c] = glm::dot(centroids[c] / areas[c] - center, normals[c] / length);
+    }
+
+    std::vector<uint32_t> order(cluster_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+
+    for (uint32_t c : order) {
+        size_t end = c + 1 < cluster_count ? clusters[c + 1] : indices.size() / 3;
+        sorted.insert(sorted.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+    }
+
+    auto before = analyze_vertex_cache(indices, positions.size());
+    auto after = analyze_vertex_cache(sorted, positions.size());
+
+    if (after.m_acmr <= before.m_acmr * threshold)
+        std::copy(sorted.begin(), sorted.end(), indices.begin());
+}
+
+// Renumbers the vertices in the order the indices first use them, so the
+// vertex fetches walk through memory front to back. Vertices no index refers
+// to are dropped.
+inline void optimize_vertex_fetch(Mesh &mesh) {
+
+    size_t stride = vertex_stride(mesh.m_attribs);
+    std::vector<uint32_t> remap(mesh.vertex_count(), UINT32_MAX);
+    std::vector<std::byte> vertices(mesh.m_vertices.size());
+    uint32_t count = 0;
+
+    for (uint32_t &index : mesh.m_indices) {
+        if (remap[index] == UINT32_MAX) {
+            memcpy(&vertices[size_t(count) * stride], &mesh.m_vertices[size_t(index) * stride], stride);
+            remap[index] = count++;
+        }
+        index = remap[index];
+    }
+
+    vertices.resize(size_t(count) * stride);
+    mesh.m_vertices = std::move(vertices);
+}
+
+struct MeshOptimizeStats {
+    VertexCacheStats m_before;
+    VertexCacheStats m_after;
+};
+
+// Reorders the triangles of every submesh for the vertex cache and then for
+// overdraw, and the vertices for fetching. Submesh ranges stay where they
+// are, only the order within them changes. The submeshes are independent, so
+// they are optimized in parallel.
+inline MeshOptimizeStats optimize_mesh(Mesh &mesh, float overdraw_threshold = 1.05f) {
+
+    MeshOptimizeStats stats;
+    stats.m_before = analyze_vertex_cache(mesh.m_indices, mesh.vertex_count());
+
+    auto positions = mesh_positions(mesh.view());
+
+    std::vector<Submesh> ranges(mesh.m_submeshes.begin(), mesh.m_submeshes.end());
+    if (ranges.empty())
+        ranges.push_back({ 0, 0, 0, static_cast<uint32_t>(mesh.m_indices.size()) });
+
+    parallel_for(ranges.size(), [&](size_t begin, size_t end) {
+        std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+        std::vector<uint32_t> clusters;
+
+        for (size_t i = begin; i < end; ++i) {
+            auto indices = std::span(mesh.m_indices).subspan(ranges[i].m_first, ranges[i].m_count);
+            tipsify(indices, remap, clusters);
+            optimize_overdraw(indices, positions, clusters, overdraw_threshold);
+        }
+    });
+
+    optimize_vertex_fetch(mesh);
+
+    stats.m_after = analyze_vertex_cache(mesh.m_indices, mesh.vertex_count());
+    return stats;
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "mips.hh"
+#include "parallel.hh"
+
+
+
+namespace {
+
+// levels a band makes before the next round starts from the last of them,
+// which makes bands 16 rows of the level they start from
+constexpr int BAND_LEVELS = 4;
+
+struct SrgbTables {
+    float m_to_linear[256];
+    // the nearest 8 bit value of linear values in steps of 1 / 16383, which
+    // is within a fifth of a step even in the darks
+    uint8_t m_from_linear[16384];
+
+    SrgbTables() {
+        for (int i = 0; i < 256; ++i) {
+            float s = i / 255.0f;
+            m_to_linear[i] = s <= 0.04045f ? s / 12.92f : std::pow((s + 0.055f) / 1.055f, 2.4f);
+        }
+
+        for (int i = 0; i < 16384; ++i) {
+            float l = i / 16383.0f;
+            float s = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            m_from_linear[i] = static_cast<uint8_t>(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+    }
+};
+
+[[nodiscard]] const SrgbTables &srgb_tables() {
+    static const SrgbTables tables;
+    return tables;
+}
+
+// Between stored 8 bit values and linear floats in [0, 1].
+class ChannelCodec {
+    int m_channels;
+    // the channels before this one are sRGB
+    int m_srgb_channels;
+    const SrgbTables &m_tables;
+
+public:
+    ChannelCodec(int channels, bool srgb)
+        : m_channels(channels)
+        , m_srgb_channels(srgb ? (channels == 4 ? 3 : channels) : 0)
+        , m_tables(srgb_tables())
+    { }
+
+    void decode(const uint8_t *in, float *out, size_t pixels) const {
+        for (size_t i = 0; i < pixels; ++i) {
+            for (int c = 0; c < m_channels; ++c) {
+                uint8_t v = in[i * m_channels + c];
+                out[i * m_channels + c] = c < m_srgb_channels ? m_tables.m_to_linear[v] : v * (1.0f / 255);
+            }
+        }
+    }
+
+    void encode(const float *in, uint8_t *out, size_t pixels) const {
+        for (size_t i = 0; i < pixels; ++i) {
+            for (int c = 0; c < m_channels; ++c) {
+                float v = std::clamp(in[i * m_channels + c], 0.0f, 1.0f);
+                out[i * m_channels + c] = c < m_srgb_channels
+                    ? m_tables.m_from_linear[static_cast<int>(v * 16383.0f + 0.5f)]
+                    : static_cast<uint8_t>(v * 255.0f + 0.5f);
+            }
+        }
+    }
+};
+
+// One row of a level from two rows of the level above.
+void half_row(const float *row0, const float *row1, int in_width, int out_width, int channels, float *out) {
+    for (int x = 0; x < out_width; ++x) {
+        int x0 = std::min(2 * x, in_width - 1) * channels;
+        int x1 = std::min(2 * x + 1, in_width - 1) * channels;
+        const float *p[4] = { row0 + x0, row0 + x1, row1 + x0, row1 + x1 };
+        float *o = out + x * channels;
+
+        if (channels == 4) {
+            // transparent pixels have no say in the color, or their often
+            // arbitrary color bleeds into the edges of cutouts
+            float alpha = p[0][3] + p[1][3] + p[2][3] + p[3][3];
+            for (int c = 0; c < 3; ++c) {
+                o[c] = alpha > 0.0f
+                    ? (p[0][c] * p[0][3] + p[1][c] * p[1][3] + p[2][c] * p[2][3] + p[3][c] * p[3][3]) / alpha
+                    : (p[0][c] + p[1][c] + p[2][c] + p[3][c]) * 0.25f;
+            }
+            o[3] = alpha * 0.25f;
+        } else {
+            for (int c = 0; c < channels; ++c)
+                o[c] = (p[0][c] + p[1][c] + p[2][c] + p[3][c]) * 0.25f;
+        }
+    }
+}
+
+void alpha_histogram(const uint8_t *pixels, size_t count, uint32_t histogram[256]) {
+    std::fill(histogram, histogram + 256, 0);
+    for (size_t i = 0; i < count; ++i)
+        ++histogram[pixels[i * 4 + 3]];
+}
+
+[[nodiscard]] uint8_t scale_alpha(uint8_t alpha, float scale) {
+    return static_cast<uint8_t>(std::min(alpha * scale + 0.5f, 255.0f));
+}
+
+// the share of pixels whose alpha times scale passes the alpha test
+[[nodiscard]] float alpha_coverage(const uint32_t histogram[256], size_t count, float reference, float scale) {
+    size_t passing = 0;
+    for (int v = 0; v < 256; ++v) {
+        if (scale_alpha(v, scale) > reference * 255.0f)
+            passing += histogram[v];
+    }
+    return static_cast<float>(passing) / count;
+}
+
+// Scales the alpha of a level so its coverage is as close to coverage as
+// it gets. Coverage grows with the scale, so a bisection finds it, and
+// small levels where it jumps take whichever side is closer.
+void preserve_coverage(uint8_t *pixels, size_t count, float reference, float coverage) {
+    uint32_t histogram[256];
+    alpha_histogram(pixels, count, histogram);
+
+    float lo = 0.0f, hi = 4.0f;
+    for (int i = 0; i < 16; ++i) {
+        float mid = (lo + hi) * 0.5f;
+        (alpha_coverage(histogram, count, reference, mid) < coverage ? lo : hi) = mid;
+    }
+
+    float below = coverage - alpha_coverage(histogram, count, reference, lo);
+    float above = alpha_coverage(histogram, count, reference, hi) - coverage;
+    float scale = below < above ? lo : hi;
+
+    for (size_t i = 0; i < count; ++i)
+        pixels[i * 4 + 3] = scale_alpha(pixels[i * 4 + 3], scale);
+}
+
+} // namespace
+
+void build_mips(
+    const uint8_t *top,
+    int width,
+    int height,
+    int channels,
+    uint8_t *mips,
+    const MipOptions &options
+) {
+    int count = mip_count(width, height);
+    ChannelCodec codec(channels, options.m_srgb);
+
+    // where each level starts in mips, the top one is not in there
+    std::vector<size_t> offsets(count + 1, 0);
+    for (int level = 2; level <= count; ++level)
+        offsets[level] = offsets[level - 1] + size_t(mip_size(width, level - 1)) * mip_size(height, level - 1) * channels;
+
+    // the level a round starts from in linear floats, if it is not the top
+    std::vector<float> source;
+
+    for (int first = 0; first + 1 < count; first += BAND_LEVELS) {
+        int steps = std::min(BAND_LEVELS, count - 1 - first);
+        int band = 1 << steps;
+        int last = first + steps;
+        int source_width = mip_size(width, first), source_height = mip_size(height, first);
+
+        // kept at full precision for the round after this one
+        std::vector<float> next;
+        if (last + 1 < count)
+            next.resize(size_t(mip_size(width, last)) * mip_size(height, last) * channels);
+
+        size_t bands = (source_height + band - 1) / band;
+
+        parallel_for(bands, [&](size_t begin, size_t end) {
+            std::vector<float> rows, halved;
+
+            for (size_t b = begin; b < end; ++b) {
+                int y0 = b * band, y1 = std::min(y0 + band, source_height);
+                size_t row_size = size_t(source_width) * channels;
+
+                rows.resize((y1 - y0) * row_size);
+                if (first == 0)
+                    codec.decode(top + y0 * row_size, rows.data(), size_t(y1 - y0) * source_width);
+                else
+                    std::copy_n(source.data() + y0 * row_size, rows.size(), rows.data());
+
+                int in_width = source_width, in_height = source_height, in_begin = y0;
+
+                for (int step = 1; step <= steps; ++step) {
+                    int level = first + step;
+                    int out_width = mip_size(width, level), out_height = mip_size(height, level);
+                    int out_begin = (b * band) >> step;
+                    int out_end = std::min(int(((b + 1) * band) >> step), out_height);
+                    if (out_begin >= out_end)
+                        break;
+
+                    size_t out_row = size_t(out_width) * channels;
+                    halved.resize((out_end - out_begin) * out_row);
+
+                    for (int y = out_begin; y < out_end; ++y) {
+                        const float *row0 = rows.data() + (std::min(2 * y, in_height - 1) - in_begin) * in_width * channels;
+                        const float *row1 = rows.data() + (std::min(2 * y + 1, in_height - 1) - in_begin) * in_width * channels;
+                        half_row(row0, row1, in_width, out_width, channels, halved.data() + (y - out_begin) * out_row);
+                    }
+
+                    codec.encode(halved.data(), mips + offsets[level] + out_begin * out_row, size_t(out_end - out_begin) * out_width);
+                    if (level == last && !next.empty())
+                        std::copy(halved.begin(), halved.end(), next.begin() + out_begin * out_row);
+
+                    std::swap(rows, halved);
+                    in_width = out_width;
+                    in_height = out_height;
+                    in_begin = out_begin;
+                }
+            }
+        });
+
+        source = std::move(next);
+    }
+
+    if (options.m_preserve_coverage && channels == 4) {
+        uint32_t histogram[256];
+        alpha_histogram(top, size_t(width) * height, histogram);
+        float coverage = alpha_coverage(histogram, size_t(width) * height, options.m_alpha_reference, 1.0f);
+
+        parallel_for(count - 1, [&](size_t begin, size_t end) {
+            for (size_t level = begin + 1; level < end + 1; ++level) {
+                size_t pixels = size_t(mip_size(width, level)) * mip_size(height, level);
+                preserve_coverage(mips + offsets[level], pixels, options.m_alpha_reference, coverage);
+            }
+        });
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+
+
+struct MipOptions {
+    // filter every channel but alpha in linear light, for colors stored as
+    // sRGB, which is what almost every diffuse map is
+    bool m_srgb = false;
+    // scale the alpha of every level so that as many pixels pass an alpha
+    // test against m_alpha_reference as on the top level, so cutouts like
+    // foliage do not fade away with distance
+    bool m_preserve_coverage = false;
+    float m_alpha_reference = 0.5f;
+
+    bool operator==(const MipOptions&) const = default;
+};
+
+// levels of a chain down to 1x1, the top one included
+[[nodiscard]] constexpr int mip_count(int width, int height) {
+    int count = 1;
+    while ((width >> count) > 0 || (height >> count) > 0)
+        ++count;
+    return count;
+}
+
+[[nodiscard]] constexpr int mip_size(int size, int level) {
+    return size >> level > 0 ? size >> level : 1;
+}
+
+// bytes of every level below the top one, packed back to back
+[[nodiscard]] constexpr size_t mip_chain_size(int width, int height, int channels) {
+    size_t size = 0;
+    for (int level = 1; level < mip_count(width, height); ++level)
+        size += size_t(mip_size(width, level)) * mip_size(height, level) * channels;
+    return size;
+}
+
+// Fills mips with every level below top, largest first, each row by row
+// without padding. A level is the 2x2 box filter of the one above, colors
+// weighted by alpha if there are four channels. Halving an odd size drops
+// the last row or column.
+//
+// Bands of rows make several levels at once while they are in cache, the
+// bands run in parallel.
+void build_mips(
+    const uint8_t *top,
+    int width,
+    int height,
+    int channels,
+    uint8_t *mips,
+    const MipOptions &options = { }
+);
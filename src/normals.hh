@@ -0,0 +1,376 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hh"
+#include "parallel.hh"
+
+
+
+// Corners grouped by the vertex they end up with after split_corners().
+struct CornerSplit {
+    // corners of vertex v are m_corners[m_offsets[v] .. m_offsets[v + 1]]
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_corners;
+
+    [[nodiscard]] size_t vertex_count() const {
+        return m_offsets.size() - 1;
+    }
+
+    [[nodiscard]] std::span<const uint32_t> corners(size_t v) const {
+        return std::span(m_corners).subspan(m_offsets[v], m_offsets[v + 1] - m_offsets[v]);
+    }
+};
+
+// Gives the corners of a vertex that have different keys vertices of their
+// own and points indices at them. New vertices keep the order of the ones
+// they come from, so the vertex cache order stays as good as it was.
+template <typename Key>
+[[nodiscard]] CornerSplit split_corners(std::span<uint32_t> indices, size_t vertex_count, std::span<const Key> keys) {
+
+    // corners around each vertex
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t v : indices)
+        offsets[v + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+        adjacency[fill[indices[i]]++] = i;
+
+    // the key of a corner is usually the first one of its vertex, so the
+    // distinct keys are found by a short linear search
+    std::vector<uint32_t> slots(indices.size());
+    std::vector<uint32_t> counts(vertex_count + 1, 0);
+
+    parallel_for(vertex_count, [&](size_t begin, size_t end) {
+        std::vector<uint32_t> distinct;
+
+        for (size_t v = begin; v < end; ++v) {
+            distinct.clear();
+
+            for (uint32_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+                uint32_t corner = adjacency[k];
+                uint32_t slot = 0;
+                while (slot < distinct.size() && !(keys[distinct[slot]] == keys[corner]))
+                    slot++;
+
+                if (slot == distinct.size())
+                    distinct.push_back(corner);
+
+                slots[k] = slot;
+            }
+
+            counts[v + 1] = distinct.size();
+        }
+    }, 1 << 14);
+
+    std::partial_sum(counts.begin(), counts.end(), counts.begin());
+
+    CornerSplit split;
+    split.m_offsets.assign(counts.back() + 1, 0);
+    split.m_corners.resize(indices.size());
+
+    for (size_t v = 0; v < vertex_count; ++v)
+        for (uint32_t k = offsets[v]; k < offsets[v + 1]; ++k)
+            split.m_offsets[counts[v] + slots[k] + 1]++;
+    std::partial_sum(split.m_offsets.begin(), split.m_offsets.end(), split.m_offsets.begin());
+
+    fill.assign(split.m_offsets.begin(), split.m_offsets.end() - 1);
+    for (size_t v = 0; v < vertex_count; ++v) {
+        for (uint32_t k = offsets[v]; k < offsets[v + 1]; ++k) {
+            uint32_t vertex = counts[v] + slots[k];
+            split.m_corners[fill[vertex]++] = adjacency[k];
+            indices[adjacency[k]] = vertex;
+        }
+    }
+
+    return split;
+}
+
+// Vertices of layout B made from those of layout A, one for each vertex of
+// split. fn(vertex, v) sets whatever A did not have for vertex v of split.
+template <unsigned A, unsigned B, typename Fn>
+void rebuild_vertices(Mesh &mesh, std::span<const uint32_t> old_indices, const CornerSplit &split, Fn fn) {
+
+    auto old_vertices = mesh.vertices<A>();
+    std::vector<std::byte> bytes(split.vertex_count() * sizeof(PackedVertex<B>));
+    auto *vertices = reinterpret_cast<PackedVertex<B>*>(bytes.data());
+
+    parallel_for(split.vertex_count(), [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t corner = split.m_corners[split.m_offsets[v]];
+            auto vertex = convert_vertex<B>(old_vertices[old_indices[corner]]);
+            fn(vertex, v);
+            vertices[v] = vertex;
+        }
+    }, 1 << 14);
+
+    mesh.m_attribs = B;
+    mesh.m_vertices = std::move(bytes);
+}
+
+// Numbers the distinct positions, vertices that only differ in other
+// attributes share a number.
+[[nodiscard]] inline std::vector<uint32_t> weld_positions(std::span<const glm::vec3> positions, uint32_t &count) {
+
+    auto bits = [&](uint32_t v) {
+        return std::array {
+            std::bit_cast<uint32_t>(positions[v].x),
+            std::bit_cast<uint32_t>(positions[v].y),
+            std::bit_cast<uint32_t>(positions[v].z),
+        };
+    };
+
+    std::vector<uint32_t> order(positions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bits(a) < bits(b); });
+
+    std::vector<uint32_t> groups(positions.size());
+    count = 0;
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i != 0 && bits(order[i]) != bits(order[i - 1]))
+            count++;
+        groups[order[i]] = count;
+    }
+
+    count += !order.empty();
+    return groups;
+}
+
+// Unit normals of the triangles and the weights of their corners, the angle
+// at the corner times the area. Works on blocks of triangles stored as
+// separate coordinate arrays, so the arithmetic vectorizes.
+inline void triangle_normals(
+    std::span<const glm::vec3> positions,
+    std::span<const uint32_t> indices,
+    std::span<glm::vec3> normals,
+    std::span<float> weights
+) {
+    constexpr size_t block = 256;
+
+    parallel_for(indices.size() / 3, [&](size_t begin, size_t end) {
+        std::array<float, block> x[3], y[3], z[3];
+        std::array<float, block> nx, ny, nz, dot[3];
+
+        for (size_t first = begin; first < end; first += block) {
+            size_t count = std::min(block, end - first);
+
+            for (size_t i = 0; i < count; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                    glm::vec3 p = positions[indices[(first + i) * 3 + k]];
+                    x[k][i] = p.x;
+                    y[k][i] = p.y;
+                    z[k][i] = p.z;
+                }
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                float ux = x[1][i] - x[0][i], uy = y[1][i] - y[0][i], uz = z[1][i] - z[0][i];
+                float vx = x[2][i] - x[0][i], vy = y[2][i] - y[0][i], vz = z[2][i] - z[0][i];
+                nx[i] = uy * vz - uz * vy;
+                ny[i] = uz * vx - ux * vz;
+                nz[i] = ux * vy - uy * vx;
+            }
+
+            // the cosine of each angle, scaled by the lengths of its edges
+            for (int k = 0; k < 3; ++k) {
+                int a = (k + 1) % 3, b = (k + 2) % 3;
+                for (size_t i = 0; i < count; ++i) {
+                    dot[k][i] = (x[a][i] - x[k][i]) * (x[b][i] - x[k][i])
+                              + (y[a][i] - y[k][i]) * (y[b][i] - y[k][i])
+                              + (z[a][i] - z[k][i]) * (z[b][i] - z[k][i]);
+                }
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                size_t t = first + i;
+                glm::vec3 normal(nx[i], ny[i], nz[i]);
+                float length = glm::length(normal);
+                normals[t] = length == 0.0f ? normal : normal / length;
+
+                // the sine of every angle scaled the same way is the length
+                for (int k = 0; k < 3; ++k)
+                    weights[t * 3 + k] = std::atan2(length, dot[k][i]) * length;
+            }
+        }
+    }, block);
+}
+
+// Gives the mesh normals that average the triangles around each position,
+// weighted by their area and the angle of their corner. Triangles that meet
+// at more than crease_degrees keep apart, their corners get separate
+// vertices. Normals the mesh had are replaced and tangents dropped.
+//
+// Has to run before optimize_mesh() and build_lods(), vertices are renumbered.
+inline void generate_normals(Mesh &mesh, float crease_degrees = 60.0f) {
+
+    auto positions = mesh_positions(mesh.view());
+
+    size_t triangle_count = mesh.m_indices.size() / 3;
+    std::vector<glm::vec3> normals(triangle_count);
+    std::vector<float> weights(triangle_count * 3);
+    triangle_normals(positions, mesh.m_indices, normals, weights);
+
+    // corners around each position
+    uint32_t group_count = 0;
+    auto groups = weld_positions(positions, group_count);
+
+    std::vector<uint32_t> offsets(group_count + 1, 0);
+    for (uint32_t v : mesh.m_indices)
+        offsets[groups[v] + 1]++;
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<uint32_t> adjacency(mesh.m_indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < mesh.m_indices.size(); ++i)
+        adjacency[fill[groups[mesh.m_indices[i]]]++] = i;
+
+    // corners that smooth over the same triangles sum them in the same order
+    // and so get bitwise equal normals, which split_corners() relies on
+    float cos_crease = std::cos(glm::radians(crease_degrees));
+    std::vector<glm::vec3> corner_normals(mesh.m_indices.size());
+
+    parallel_for(mesh.m_indices.size(), [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            uint32_t group = groups[mesh.m_indices[c]];
+            glm::vec3 face = normals[c / 3];
+            glm::vec3 sum(0.0f);
+
+            for (uint32_t k = offsets[group]; k < offsets[group + 1]; ++k) {
+                uint32_t other = adjacency[k];
+                if (glm::dot(face, normals[other / 3]) >= cos_crease)
+                    sum += normals[other / 3] * weights[other];
+            }
+
+            float length = glm::length(sum);
+            corner_normals[c] = length == 0.0f ? face : sum / length;
+        }
+    }, 1 << 14);
+
+    std::vector<uint32_t> old_indices = mesh.m_indices;
+    auto split = split_corners<glm::vec3>(mesh.m_indices, positions.size(), corner_normals);
+
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        constexpr unsigned B = (A | ATTRIB_NORMAL) & ~ATTRIB_TANGENT;
+        rebuild_vertices<A, B>(mesh, old_indices, split, [&](PackedVertex<B> &vertex, size_t v) {
+            vertex.m_normal = corner_normals[split.corners(v).front()];
+        });
+    });
+}
+
+// Gives the mesh tangents the way MikkTSpace defines them: the direction of
+// increasing u of every triangle, projected onto the plane of the vertex
+// normal and averaged weighted by the corner angle in that plane. Triangles
+// with mirrored uvs are never averaged with the others, their corners get
+// separate vertices with a negative bitangent sign. Triangles without uv area
+// take the tangent of their neighbours.
+//
+// Needs uvs and normals, does nothing without them. Has to run before
+// optimize_mesh() and build_lods(), vertices are renumbered.
+inline void generate_tangents(Mesh &mesh) {
+
+    if ((mesh.m_attribs & ATTRIB_UV) == 0 || (mesh.m_attribs & ATTRIB_NORMAL) == 0)
+        return;
+
+    size_t corner_count = mesh.m_indices.size();
+    std::vector<glm::vec3> corner_tangents(corner_count, glm::vec3(0.0f));
+    std::vector<int8_t> orientations(corner_count, 0);
+
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        if constexpr ((A & ATTRIB_UV) != 0 && (A & ATTRIB_NORMAL) != 0) {
+            auto vertices = mesh.vertices<A>();
+
+            parallel_for(corner_count / 3, [&](size_t begin, size_t end) {
+                for (size_t t = begin; t < end; ++t) {
+                    auto &a = vertices[mesh.m_indices[t * 3]];
+                    auto &b = vertices[mesh.m_indices[t * 3 + 1]];
+                    auto &c = vertices[mesh.m_indices[t * 3 + 2]];
+
+                    glm::vec3 d1 = b.m_pos - a.m_pos, d2 = c.m_pos - a.m_pos;
+                    glm::vec2 t1 = b.m_uv - a.m_uv, t2 = c.m_uv - a.m_uv;
+                    float area = t1.x * t2.y - t1.y * t2.x;
+
+                    if (area == 0.0f)
+                        continue;
+
+                    glm::vec3 tangent = (d1 * t2.y - d2 * t1.y) * (area > 0.0f ? 1.0f : -1.0f);
+                    float length = glm::length(tangent);
+                    if (length == 0.0f)
+                        continue;
+
+                    for (int k = 0; k < 3; ++k) {
+                        corner_tangents[t * 3 + k] = tangent / length;
+                        orientations[t * 3 + k] = area > 0.0f ? 1 : -1;
+                    }
+                }
+            }, 1 << 14);
+        }
+    });
+
+    // corners without uv area go with the others of their vertex
+    {
+        std::vector<int8_t> vertex_orientation(mesh.vertex_count(), 0);
+        for (size_t c = 0; c < corner_count; ++c)
+            if (vertex_orientation[mesh.m_indices[c]] == 0)
+                vertex_orientation[mesh.m_indices[c]] = orientations[c];
+
+        for (size_t c = 0; c < corner_count; ++c)
+            if (orientations[c] == 0)
+                orientations[c] = vertex_orientation[mesh.m_indices[c]] < 0 ? -1 : 1;
+    }
+
+    std::vector<uint32_t> old_indices = mesh.m_indices;
+    auto split = split_corners<int8_t>(mesh.m_indices, mesh.vertex_count(), orientations);
+
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        if constexpr ((A & ATTRIB_UV) != 0 && (A & ATTRIB_NORMAL) != 0) {
+            constexpr unsigned B = A | ATTRIB_TANGENT;
+            auto old_vertices = mesh.vertices<A>();
+
+            auto position = [&](uint32_t corner) {
+                return old_vertices[old_indices[corner]].m_pos;
+            };
+
+            rebuild_vertices<A, B>(mesh, old_indices, split, [&](PackedVertex<B> &vertex, size_t v) {
+                glm::vec3 n = vertex.m_normal;
+
+                auto project = [&](glm::vec3 d) {
+                    d -= n * glm::dot(n, d);
+                    float length = glm::length(d);
+                    return length == 0.0f ? d : d / length;
+                };
+
+                glm::vec3 sum(0.0f);
+
+                for (uint32_t corner : split.corners(v)) {
+                    uint32_t t = corner / 3 * 3;
+                    glm::vec3 p = position(corner);
+                    glm::vec3 e1 = project(position(t + (corner - t + 1) % 3) - p);
+                    glm::vec3 e2 = project(position(t + (corner - t + 2) % 3) - p);
+                    float angle = std::acos(std::clamp(glm::dot(e1, e2), -1.0f, 1.0f));
+
+                    sum += project(corner_tangents[corner]) * angle;
+                }
+
+                // nothing to go by, any direction in the plane will do
+                if (glm::length(sum) == 0.0f)
+                    sum = std::abs(n.x) < 0.9f ? glm::cross(n, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(n, glm::vec3(0.0f, 1.0f, 0.0f));
+
+                int8_t orientation = orientations[split.corners(v).front()];
+                vertex.m_tangent = glm::vec4(glm::normalize(sum), orientation);
+            });
+        }
+    });
+}
@@ -1,13 +1,21 @@
 #pragma once
 
+#include <charconv>
 #include <cstdlib>
-#include <fstream>
-#include <functional>
+#include <cstring>
 #include <print>
+#include <algorithm>
+#include <bit>
 #include <array>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <ranges>
-#include <sstream>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
 
 #include <glm/glm.hpp>
@@ -15,15 +23,22 @@
 #include <glm/gtx/rotate_vector.hpp>
 
 #include "vertex.hh"
+#include "mesh.hh"
+#include "mappedfile.hh"
+#include "parallel.hh"
+#include "objfast.hh"
+#include "triangulate.hh"
 
 class TokenVertex { };
 class TokenNormal { };
 class TokenTexture { };
 class TokenFace { };
-using TokenFloat = float;
-using TokenIdent = std::string;
+// points into the source text, converted by the parser depending on context
+struct TokenNumber { std::string_view m_str; };
+using TokenIdent = std::string_view;
 class TokenSlash { };
 class TokenNewline { };
+class TokenEof { };
 class TokenInvalid { };
 
 using Token = std::variant<
@@ -31,10 +46,11 @@ using Token = std::variant<
     TokenNormal,
     TokenTexture,
     TokenFace,
-    TokenFloat,
+    TokenNumber,
     TokenIdent,
     TokenSlash,
     TokenNewline,
+    TokenEof,
     TokenInvalid
 >;
 
@@ -44,8 +60,8 @@ struct std::formatter<Token> : std::formatter<std::string> {
 
         std::string fmt;
 
-        if (std::holds_alternative<TokenFloat>(p)) {
-            fmt = std::format("Float({})", std::get<TokenFloat>(p));
+        if (std::holds_alternative<TokenNumber>(p)) {
+            fmt = std::format("Number({})", std::get<TokenNumber>(p).m_str);
 
         } else if (std::holds_alternative<TokenIdent>(p)) {
             fmt = std::format("Ident({})", std::get<TokenIdent>(p));
@@ -62,16 +78,17 @@ struct std::formatter<Token> : std::formatter<std::string> {
         } else if (std::holds_alternative<TokenFace>(p)) {
             fmt = "TokenFace";
 
-            // TODO: weird compile warning
+        } else if (std::holds_alternative<TokenSlash>(p)) {
+            fmt = "TokenSlash";
 
-        // } else if (std::holds_alternative<TokenSlash>(p)) {
-        //     fmt = "TokenSlash";
+        } else if (std::holds_alternative<TokenNewline>(p)) {
+            fmt = "TokenNewline";
 
-        // } else if (std::holds_alternative<TokenNewline>(p)) {
-        //     fmt = "TokenNewline";
+        } else if (std::holds_alternative<TokenEof>(p)) {
+            fmt = "TokenEof";
 
-        // } else if (std::holds_alternative<TokenInvalid>(p)) {
-        //     fmt = "TokenInvalid";
+        } else if (std::holds_alternative<TokenInvalid>(p)) {
+            fmt = "TokenInvalid";
 
         } else {
             throw std::runtime_error("token has no string representation");
@@ -81,13 +98,17 @@ struct std::formatter<Token> : std::formatter<std::string> {
     }
 };
 
+// Scans a view of the source text (usually a MappedFile) without copying it.
+// All tokens point directly into the source, so it has to outlive the lexer.
 class ObjLexer {
-    std::istringstream m_src;
+    const char *m_cur;
+    const char *m_end;
     Token m_tok = TokenInvalid{};
 
 public:
-    ObjLexer(std::string src)
-    : m_src(std::move(src))
+    ObjLexer(std::string_view src)
+    : m_cur(src.data())
+    , m_end(src.data() + src.size())
     { }
 
     [[nodiscard]] Token peek() const {
@@ -101,42 +122,77 @@ public:
     }
 
     void skip_to_newline() {
-        read_while([](char c) { return c != '\n'; });
+        m_cur = find_newline(m_cur);
         next();
     }
 
+    // Position right after the peeked token, for the line kernels in
+    // objfast.hh. They hand back where the line ends via seek().
+    [[nodiscard]] const char *cursor() const {
+        return m_cur;
+    }
+
+    [[nodiscard]] const char *end() const {
+        return m_end;
+    }
+
+    void seek(const char *pos) {
+        m_cur = pos;
+        m_tok = impl_next();
+    }
+
+    // Rest of the line after the peeked token without surrounding
+    // whitespace, for names that may contain any character.
+    [[nodiscard]] std::string_view rest_of_line() {
+        const char *start = m_cur;
+        const char *end = find_newline(m_cur);
+        seek(end);
+
+        while (start != end && is_space(*start))
+            start++;
+
+        while (start != end && is_space(end[-1]))
+            end--;
+
+        return { start, static_cast<size_t>(end - start) };
+    }
+
+    // whitespace within a line, a newline is a token of its own
+    [[nodiscard]] static constexpr bool is_space(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
 private:
     Token impl_next() {
-        char c = m_src.peek();
 
-        switch (c) {
-            case ' ':
-            case '\t':
-                m_src.ignore();
-                return impl_next();
-                break;
+        while (m_cur != m_end && is_space(*m_cur))
+            m_cur++;
 
+        if (m_cur == m_end)
+            return TokenEof{};
+
+        char c = *m_cur;
+
+        switch (c) {
             case '\n':
-                m_src.ignore();
+                m_cur++;
                 return TokenNewline{};
                 break;
 
             case '/':
-                m_src.ignore();
+                m_cur++;
                 return TokenSlash{};
                 break;
 
             case '#':
-                skip_to_newline();
-                return peek();
+                m_cur = find_newline(m_cur);
+                return impl_next();
                 break;
 
             default: {
-                auto ident = read_while(isalpha);
-                auto num = tokenize_float();
 
-                if (ident) {
-                    auto str = *ident;
+                if (is_alpha(c)) {
+                    auto str = read_while(is_ident);
 
                     if (str == "v")
                         return TokenVertex();
@@ -153,114 +209,462 @@ private:
                     else
                         return str;
 
-                } else if (num) {
-                    return *num;
+                } else if (is_number(c)) {
+                    return TokenNumber { read_while(is_number) };
                 }
 
+                m_cur++;
                 return TokenInvalid{};
 
             } break;
         }
     }
 
-    std::optional<float> tokenize_float() {
+    [[nodiscard]] const char *find_newline(const char *start) const {
+        auto nl = static_cast<const char*>(memchr(start, '\n', m_end - start));
+        return nl == nullptr ? m_end : nl;
+    }
 
-        float is_negative = false;
-        if (m_src.peek() == '-') {
-            is_negative = true;
-            m_src.ignore();
-        }
+    template <typename Predicate>
+    std::string_view read_while(Predicate predicate) {
+        const char *start = m_cur;
+
+        while (m_cur != m_end && predicate(*m_cur))
+            m_cur++;
 
-        auto num = read_while(isdigit);
+        return { start, static_cast<size_t>(m_cur - start) };
+    }
 
-        if (!num.has_value())
-            return { };
+    [[nodiscard]] static constexpr bool is_alpha(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    [[nodiscard]] static constexpr bool is_digit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    [[nodiscard]] static constexpr bool is_ident(char c) {
+        return is_alpha(c) || is_digit(c) || c == '_';
+    }
+
+    // exponents are included, validating the number is left to std::from_chars
+    [[nodiscard]] static constexpr bool is_number(char c) {
+        return is_digit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+};
 
-        std::optional<std::string> num2;
 
-        if (m_src.peek() == '.') {
-            m_src.ignore();
-            num2 = read_while(isdigit);
+// one face corner, as written in the file (1-based, 0 if left out)
+struct ObjCorner {
+    unsigned int m_vert;
+    unsigned int m_tex;
+    unsigned int m_norm;
 
-            if (!num2)
-                return { };
+    bool operator==(const ObjCorner&) const = default;
+};
+
+// Assigns every distinct corner the index of its vertex. This only compares
+// integers, so it is an open addressing table sized for max_corners upfront.
+class ObjCornerMap {
+    std::pmr::vector<uint32_t> m_slots;
+    std::pmr::vector<ObjCorner> m_corners;
+
+public:
+    ObjCornerMap(size_t max_corners, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : m_slots(std::bit_ceil(std::max<size_t>(max_corners * 2, 16)), UINT32_MAX, resource)
+    , m_corners(resource)
+    {
+        // pages that are never written to are never backed by memory
+        m_corners.reserve(max_corners);
+    }
+
+    uint32_t insert(ObjCorner corner) {
+        size_t mask = m_slots.size() - 1;
+        size_t slot = hash(corner) & mask;
+
+        while (m_slots[slot] != UINT32_MAX && m_corners[m_slots[slot]] != corner)
+            slot = (slot + 1) & mask;
+
+        if (m_slots[slot] == UINT32_MAX) {
+            m_slots[slot] = m_corners.size();
+            m_corners.push_back(corner);
         }
 
-        auto str = *num;
+        return m_slots[slot];
+    }
+
+    // unique corners, indexed by vertex
+    [[nodiscard]] std::span<const ObjCorner> corners() const {
+        return m_corners;
+    }
+
+    void clear() {
+        std::ranges::fill(m_slots, UINT32_MAX);
+        m_corners.clear();
+    }
 
-        if (num2)
-            str += '.' + *num2;
+private:
+    [[nodiscard]] static size_t hash(ObjCorner corner) {
+        uint64_t h = corner.m_vert * 0x9e3779b97f4a7c15ull;
+        h ^= corner.m_tex * 0xc2b2ae3d27d4eb4full + (h >> 29);
+        h ^= corner.m_norm * 0x165667b19e3779f9ull + (h >> 32);
+        return h ^ (h >> 31);
+    }
 
-        if (is_negative)
-            str.insert(str.begin(), '-');
+};
 
-        return atof(str.c_str());
+// A face with more than three corners. Its count - 2 triangles start at
+// m_first in ObjData::m_corners, as a fan until ObjData::triangulate().
+struct ObjPolygon {
+    size_t m_first;
+    uint32_t m_count;
 
+    bool operator==(const ObjPolygon&) const = default;
+};
+
+// A negative index in the file counts back from the last attribute parsed so
+// far. Within a piece it is stored relative to the start of the piece.
+struct ObjRelativeIndex {
+    size_t m_corner;
+    unsigned int ObjCorner::*m_index;
+    // it counts back past the start of the piece, so it is only valid if
+    // the pieces before hold enough
+    bool m_before = false;
+
+    bool operator==(const ObjRelativeIndex&) const = default;
+};
+
+// A usemtl, g or o statement, which applies from corner m_first on.
+struct ObjNameRange {
+    size_t m_first;
+    std::string m_name;
+
+    bool operator==(const ObjNameRange&) const = default;
+};
+
+// Assigns every distinct name an id, in order of first use.
+class ObjNameTable {
+    std::unordered_map<std::string, uint32_t> m_ids;
+    std::vector<std::string> m_names;
+
+public:
+    uint32_t intern(const std::string &name) {
+        auto [it, inserted] = m_ids.try_emplace(name, m_names.size());
+        if (inserted)
+            m_names.push_back(name);
+        return it->second;
+    }
+
+    [[nodiscard]] const std::vector<std::string> &names() const {
+        return m_names;
     }
 
-    std::optional<std::string> read_while(std::function<bool(char)> predicate) {
+    [[nodiscard]] std::vector<std::string> take() {
+        m_ids.clear();
+        return std::move(m_names);
+    }
+};
 
-        char c;
-        std::string acc;
+static constexpr unsigned int ObjCorner::*OBJ_CORNER_INDICES[] = {
+    &ObjCorner::m_vert,
+    &ObjCorner::m_tex,
+    &ObjCorner::m_norm,
+};
 
-        while (predicate(c = m_src.get())) {
-            acc.push_back(c);
+// Attribute arrays and face indices of one contiguous piece of an OBJ file.
+// Positive face indices in OBJ are global to the file, so they stay valid
+// when the arrays of consecutive pieces are concatenated. Negative ones
+// have to be resolved with rebase() first.
+//
+// Everything is allocated from one memory resource, usually the arena of a
+// single parse.
+struct ObjData {
+    std::pmr::vector<glm::vec3> m_vertices;
+    std::pmr::vector<glm::vec3> m_normals;
+    std::pmr::vector<glm::vec2> m_uvs;
+    // three per triangle
+    std::pmr::vector<ObjCorner> m_corners;
+    std::pmr::vector<ObjPolygon> m_polygons;
+    std::pmr::vector<ObjRelativeIndex> m_relative;
+    // usemtl statements, and g or o statements
+    std::pmr::vector<ObjNameRange> m_materials;
+    std::pmr::vector<ObjNameRange> m_groups;
+    std::pmr::vector<std::string> m_material_libs;
+    // every attribute that at least one corner refers to
+    unsigned m_attribs = ATTRIB_POSITION;
+
+    ObjData(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+    : m_vertices(resource)
+    , m_normals(resource)
+    , m_uvs(resource)
+    , m_corners(resource)
+    , m_polygons(resource)
+    , m_relative(resource)
+    , m_materials(resource)
+    , m_groups(resource)
+    , m_material_libs(resource)
+    { }
+
+    [[nodiscard]] bool in_range(ObjCorner corner) const {
+        return corner.m_vert - 1 < m_vertices.size()
+            && corner.m_tex <= m_uvs.size()
+            && corner.m_norm <= m_normals.size();
+    }
+
+    // The corner may come from a different ObjData, as long as its indices
+    // refer to the attributes stored here. Attributes the corner leaves out
+    // are zero.
+    template <unsigned A>
+    [[nodiscard]] PackedVertex<A> vertex(ObjCorner corner) const {
+        PackedVertex<A> vertex { };
+        vertex.m_pos = m_vertices[corner.m_vert-1];
+
+        if constexpr ((A & ATTRIB_UV) != 0)
+            vertex.m_uv = corner.m_tex == 0 ? glm::vec2(0.0f) : m_uvs[corner.m_tex-1];
+
+        if constexpr ((A & ATTRIB_NORMAL) != 0)
+            vertex.m_normal = corner.m_norm == 0 ? glm::vec3(0.0f) : m_normals[corner.m_norm-1];
+
+        return vertex;
+    }
+
+    // Adds a face as a fan of triangles. Bit i of relative[j] is set if
+    // index i of corner j is relative, bit i + 3 if it also counts back past
+    // the start of the piece. An empty span means none are.
+    void add_face(std::span<const ObjCorner> face, std::span<const uint8_t> relative = { }) {
+
+        if (face.size() > 3)
+            m_polygons.push_back({ m_corners.size(), static_cast<uint32_t>(face.size()) });
+
+        for (size_t i = 1; i + 1 < face.size(); ++i) {
+            for (size_t j : { size_t(0), i, i + 1 }) {
+
+                if (!relative.empty()) {
+                    for (int k = 0; k < 3; ++k) {
+                        if (relative[j] & (1 << k))
+                            m_relative.push_back({ m_corners.size(), OBJ_CORNER_INDICES[k], (relative[j] & (8 << k)) != 0 });
+                    }
+                }
+
+                add_corner(face[j], relative.empty() ? 0 : relative[j]);
+            }
+        }
+    }
+
+    // Makes relative indices global and moves everything that refers to a
+    // corner by first. base holds the number of vertices, uvs and normals in
+    // all pieces before this one, first the number of corners.
+    void rebase(ObjCorner base, size_t first) {
+        for (auto [corner, index, before] : m_relative) {
+            auto &value = m_corners[corner].*index;
+
+            // one that counts back past the start of the piece wrapped around
+            // below 0, out of range of every table if nothing is left there
+            unsigned int below = 0u - value;
+            value = before && base.*index <= below ? UINT32_MAX : value + base.*index;
         }
 
-        m_src.unget();
+        for (auto &polygon : m_polygons)
+            polygon.m_first += first;
 
-        if (acc.empty()) return { };
+        for (auto &range : m_materials)
+            range.m_first += first;
 
-        return acc;
+        for (auto &range : m_groups)
+            range.m_first += first;
 
+        m_relative.clear();
     }
 
+    // Replaces the fan of every polygon that is not convex. positions are the
+    // vertices of the whole file, polygons with invalid indices are left as
+    // they are for in_range() to catch.
+    void triangulate(std::span<const glm::vec3> positions) {
+
+        parallel_for(m_polygons.size(), [&](size_t begin, size_t end) {
+            std::vector<ObjCorner> corners;
+            std::vector<glm::vec3> points;
+            std::vector<uint32_t> triangles;
+
+            for (size_t i = begin; i < end; ++i) {
+                auto [first, count] = m_polygons[i];
+
+                // the fan has every corner, see add_face()
+                corners.clear();
+                corners.push_back(m_corners[first]);
+                corners.push_back(m_corners[first + 1]);
+                for (size_t k = 0; k + 2 < count; ++k)
+                    corners.push_back(m_corners[first + k * 3 + 2]);
+
+                points.clear();
+                for (auto corner : corners) {
+                    if (corner.m_vert - 1 >= positions.size())
+                        break;
+                    points.push_back(positions[corner.m_vert - 1]);
+                }
+
+                if (points.size() != count)
+                    continue;
+
+                triangulate_polygon(points, triangles);
+
+                for (size_t k = 0; k < triangles.size(); ++k)
+                    m_corners[first + k] = corners[triangles[k]];
+            }
+        }, 256);
+    }
+
+private:
+    void add_corner(ObjCorner corner, uint8_t relative) {
+        m_corners.push_back(corner);
+
+        // a relative index may be 0 until it is resolved
+        if (corner.m_tex != 0 || (relative & 2)) m_attribs |= ATTRIB_UV;
+        if (corner.m_norm != 0 || (relative & 4)) m_attribs |= ATTRIB_NORMAL;
+    }
 };
 
-class ObjParser {
+// Number of lines of each kind, found by jumping from newline to newline,
+// and the number of triangle corners the faces turn into. Lines with leading
+// whitespace are missed, which only costs a reallocation.
+struct ObjLineCounts {
+    size_t m_vertices = 0;
+    size_t m_uvs = 0;
+    size_t m_normals = 0;
+    size_t m_corners = 0;
+
+    [[nodiscard]] static ObjLineCounts count(std::string_view src) {
+        ObjLineCounts counts;
+        const char *p = src.data();
+        const char *end = p + src.size();
+
+        while (end - p >= 2) {
+            auto nl = static_cast<const char*>(memchr(p, '\n', end - p));
+            auto line_end = nl == nullptr ? end : nl;
+
+            if (p[0] == 'v') {
+                if (p[1] == ' ' || p[1] == '\t') counts.m_vertices++;
+                else if (p[1] == 't') counts.m_uvs++;
+                else if (p[1] == 'n') counts.m_normals++;
+
+            } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+                counts.m_corners += face_corners(p + 1, line_end);
+            }
+
+            if (nl == nullptr)
+                break;
+            p = nl + 1;
+        }
+
+        return counts;
+    }
+
+private:
+    // a polygon of n corners becomes n - 2 triangles
+    // p is the space after "f", so every corner starts right after a space.
+    // Written without a carried state so the loop vectorizes.
+    [[nodiscard]] static size_t face_corners(const char *p, const char *end) {
+        auto space = [](char c) { return c == ' ' || c == '\t' || c == '\r'; };
+        size_t corners = 0;
+
+        for (ptrdiff_t i = 1; i < end - p; ++i)
+            corners += space(p[i - 1]) & !space(p[i]);
+
+        return corners < 3 ? 0 : (corners - 2) * 3;
+    }
+};
+
+// Parses a range of whole lines into ObjData. Common lines go through the
+// given line kernels, everything else (and everything, if there are no
+// kernels) through ObjLexer.
+class ObjChunkParser {
     ObjLexer m_lexer;
-    std::vector<glm::vec3> m_vertices;
-    std::vector<glm::vec3> m_normals;
-    std::vector<glm::vec2> m_uvs;
-    std::vector<unsigned int> m_vertex_indices;
-    std::vector<unsigned int> m_texture_indices;
-    std::vector<unsigned int> m_normal_indices;
+    ObjData m_data;
+    const ObjLineKernels *m_kernels;
+    // corners of the face being parsed
+    std::vector<ObjCorner> m_face;
+    std::vector<uint8_t> m_face_relative;
 
 public:
-    ObjParser(std::string filename)
-    : m_lexer(read_file(std::move(filename)))
+    ObjChunkParser(
+        std::string_view src,
+        const ObjLineKernels *kernels = &obj_line_kernels(),
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource()
+    )
+    : m_lexer(src)
+    , m_data(resource)
+    , m_kernels(kernels)
     {
+        // reserved upfront, so the arrays never have to be copied while growing
+        auto counts = ObjLineCounts::count(src);
+        m_data.m_vertices.reserve(counts.m_vertices);
+        m_data.m_uvs.reserve(counts.m_uvs);
+        m_data.m_normals.reserve(counts.m_normals);
+        m_data.m_corners.reserve(counts.m_corners);
+
         m_lexer.next();
     }
 
-    std::vector<Vertex> parse() {
+    [[nodiscard]] ObjData parse() {
 
-        while (!std::holds_alternative<TokenInvalid>(m_lexer.peek())) {
-            parse_line();
+        while (!std::holds_alternative<TokenEof>(m_lexer.peek())) {
+            if (m_kernels == nullptr || !parse_line_fast())
+                parse_line();
         }
 
-        std::vector<Vertex> verts;
+        return std::move(m_data);
+    }
 
-        // for (auto &v : m_vertex_indices) {
-        //     verts.push_back(m_vertices[v-1]);
-        // }
+private:
+    // Returns false without consuming anything if the line is not a common one.
+    bool parse_line_fast() {
+        auto tok = m_lexer.peek();
+        const char *src = m_lexer.cursor();
+        const char *end = m_lexer.end();
+        const char *next = nullptr;
+        float xyz[3];
 
-        for (auto [vert, tex, norm] : std::views::zip(m_vertex_indices, m_texture_indices, m_normal_indices)) {
-            verts.push_back({ m_vertices[vert-1], m_uvs[tex-1] });
+        if (std::holds_alternative<TokenVertex>(tok)) {
+            next = m_kernels->m_floats(src, end, xyz, 3);
+            if (next) m_data.m_vertices.push_back({ xyz[0], xyz[1], xyz[2] });
+
+        } else if (std::holds_alternative<TokenNormal>(tok)) {
+            next = m_kernels->m_floats(src, end, xyz, 3);
+            if (next) m_data.m_normals.push_back({ xyz[0], xyz[1], xyz[2] });
+
+        } else if (std::holds_alternative<TokenTexture>(tok)) {
+            next = m_kernels->m_floats(src, end, xyz, 2);
+            if (next) m_data.m_uvs.push_back({ xyz[0], xyz[1] });
+
+        } else if (std::holds_alternative<TokenFace>(tok)) {
+            next = parse_face_fast(src, end);
         }
 
-        return verts;
+        if (next == nullptr)
+            return false;
 
+        m_lexer.seek(next);
+        return true;
     }
 
-private:
-    [[nodiscard]] static std::string read_file(std::string filename) {
-        std::ifstream file(filename);
-        std::string contents((std::istreambuf_iterator<char>(file)),
-                             std::istreambuf_iterator<char>());
-        return contents;
-    }
+    const char *parse_face_fast(const char *src, const char *end) {
+        ObjFaceLine face;
+        const char *next = m_kernels->m_face(src, end, face);
 
+        if (next == nullptr || face.m_count < 3)
+            return nullptr;
+
+        ObjCorner corners[ObjFaceLine::MAX_CORNERS];
+        for (int i = 0; i < face.m_count; ++i) {
+            auto [vert, tex, norm] = face.m_corners[i];
+            corners[i] = { vert, tex, norm };
+        }
+
+        m_data.add_face(std::span(corners, face.m_count));
+
+        return next;
+    }
 
     void parse_line() {
 
@@ -279,87 +683,156 @@ private:
             parse_face();
 
         } else if (std::holds_alternative<TokenIdent>(tok)) {
-            std::println(stderr, "> Obj Parser Warning:");
-            std::println(stderr, "Unsupported Instruction: `{}`", std::get<TokenIdent>(tok));
-            m_lexer.skip_to_newline();
+            parse_statement(std::get<TokenIdent>(tok));
         }
 
+        // the last line of a file does not need a trailing newline
+        if (std::holds_alternative<TokenEof>(m_lexer.peek()))
+            return;
+
         auto nl = m_lexer.next();
         expect<TokenNewline>(nl);
 
     }
 
+    void parse_statement(std::string_view keyword) {
+
+        if (keyword == "usemtl") {
+            m_data.m_materials.push_back({ m_data.m_corners.size(), std::string(m_lexer.rest_of_line()) });
+
+        } else if (keyword == "g" || keyword == "o") {
+            m_data.m_groups.push_back({ m_data.m_corners.size(), std::string(m_lexer.rest_of_line()) });
+
+        } else if (keyword == "mtllib") {
+            // separated by any whitespace, like the other statements
+            auto names = m_lexer.rest_of_line();
+            while (!names.empty()) {
+                auto end = std::ranges::find_if(names, ObjLexer::is_space);
+                m_data.m_material_libs.emplace_back(names.begin(), end);
+
+                names.remove_prefix(std::ranges::find_if_not(end, names.end(), ObjLexer::is_space) - names.begin());
+            }
+
+        } else {
+            std::println(stderr, "> Obj Parser Warning:");
+            std::println(stderr, "Unsupported Instruction: `{}`", keyword);
+            m_lexer.skip_to_newline();
+        }
+    }
+
     void parse_face() {
         expect<TokenFace>(m_lexer.next());
-        parse_face_index_triple();
-        parse_face_index_triple();
-        parse_face_index_triple();
+
+        m_face.clear();
+        m_face_relative.clear();
+
+        while (std::holds_alternative<TokenNumber>(m_lexer.peek()))
+            parse_face_corner();
+
+        if (m_face.size() < 3) {
+            std::println(stderr, "> Obj Parser Error:");
+            std::println(stderr, "Face with less than 3 corners");
+            exit(EXIT_FAILURE);
+        }
+
+        m_data.add_face(m_face, m_face_relative);
     }
 
-    void parse_face_index_triple() {
-        auto vert_idx = m_lexer.next();
-        expect<TokenFloat>(vert_idx);
-        m_vertex_indices.push_back(std::get<TokenFloat>(vert_idx));
+    // "v", "v/t", "v//n" or "v/t/n"
+    void parse_face_corner() {
+        uint8_t relative = 0;
+        ObjCorner corner { parse_face_index(m_data.m_vertices.size(), relative, 1), 0, 0 };
 
-        if (!std::holds_alternative<TokenSlash>(m_lexer.peek())) return;
-        m_lexer.next();
+        if (std::holds_alternative<TokenSlash>(m_lexer.peek())) {
+            m_lexer.next();
 
-        auto tex_idx = m_lexer.next();
-        expect<TokenFloat>(tex_idx);
-        m_texture_indices.push_back(std::get<TokenFloat>(tex_idx));
+            if (!std::holds_alternative<TokenSlash>(m_lexer.peek()))
+                corner.m_tex = parse_face_index(m_data.m_uvs.size(), relative, 2);
 
-        if (!std::holds_alternative<TokenSlash>(m_lexer.peek())) return;
-        m_lexer.next();
+            if (std::holds_alternative<TokenSlash>(m_lexer.peek())) {
+                m_lexer.next();
+                corner.m_norm = parse_face_index(m_data.m_normals.size(), relative, 4);
+            }
+        }
 
-        auto norm_idx = m_lexer.next();
-        expect<TokenFloat>(norm_idx);
-        m_normal_indices.push_back(std::get<TokenFloat>(norm_idx));
+        m_face.push_back(corner);
+        m_face_relative.push_back(relative);
+    }
+
+    // count is the size of the attribute table in this chunk so far. Negative
+    // indices reaching into earlier chunks wrap around, which rebase()
+    // undoes by adding the size of those chunks, or rejects if they reach
+    // back past the start of the file.
+    unsigned int parse_face_index(size_t count, uint8_t &relative, uint8_t bit) {
+        auto index = parse_number<long>();
+
+        // tables are indexed with 32 bits, a larger index would wrap around
+        // onto a valid one
+        if (index > long(UINT32_MAX) || index < -long(UINT32_MAX)) {
+            std::println(stderr, "> Obj Parser Error:");
+            std::println(stderr, "Face index out of range");
+            exit(EXIT_FAILURE);
+        }
+
+        if (index >= 0)
+            return index;
+
+        relative |= bit;
+        if (size_t(-index) > count)
+            relative |= bit << 3;
+
+        return static_cast<unsigned int>(count + 1 + index);
     }
 
     void parse_texture() {
         expect<TokenTexture>(m_lexer.next());
 
-        auto u = m_lexer.next();
-        expect<TokenFloat>(u);
-
-        auto v = m_lexer.next();
-        expect<TokenFloat>(v);
+        float u = parse_number<float>();
+        float v = parse_number<float>();
 
-        m_uvs.push_back({
-            std::get<TokenFloat>(u),
-            std::get<TokenFloat>(v),
-        });
+        m_data.m_uvs.push_back({ u, v });
     }
 
     void parse_normal() {
         expect<TokenNormal>(m_lexer.next());
         auto [x, y, z] = parse_xyz();
-        m_normals.push_back({ x, y, z });
+        m_data.m_normals.push_back({ x, y, z });
     }
 
     void parse_vertex() {
         expect<TokenVertex>(m_lexer.next());
         auto [x, y, z] = parse_xyz();
-        m_vertices.push_back({ x, y, z });
+        m_data.m_vertices.push_back({ x, y, z });
     }
 
     std::tuple<float, float, float> parse_xyz() {
+        float x = parse_number<float>();
+        float y = parse_number<float>();
+        float z = parse_number<float>();
+        return { x, y, z };
+    }
 
-        auto x = m_lexer.next();
-        expect<TokenFloat>(x);
+    template <typename T>
+    T parse_number() {
+        auto tok = m_lexer.next();
+        expect<TokenNumber>(tok);
 
-        auto y = m_lexer.next();
-        expect<TokenFloat>(y);
+        auto str = std::get<TokenNumber>(tok).m_str;
 
-        auto z = m_lexer.next();
-        expect<TokenFloat>(z);
+        // std::from_chars does not accept an explicit plus sign
+        if (str.starts_with('+'))
+            str.remove_prefix(1);
 
-        return {
-            std::get<TokenFloat>(x),
-            std::get<TokenFloat>(y),
-            std::get<TokenFloat>(z)
-        };
+        T value { };
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+
+        if (ec != std::errc() || ptr != str.data() + str.size()) {
+            std::println(stderr, "> Obj Parser Error:");
+            std::println(stderr, "Invalid Number `{}`", str);
+            exit(EXIT_FAILURE);
+        }
 
+        return value;
     }
 
     template <class TokenType>
@@ -372,3 +845,312 @@ private:
     }
 
 };
+
+// Splits the file into one chunk of whole lines per thread, parses the chunks
+// in parallel and merges their arrays at offsets given by a prefix sum over
+// the chunk sizes.
+class ObjParser {
+    MappedFile m_file;
+    static constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+public:
+    ObjParser(const char *filename)
+    : m_file(filename)
+    { }
+
+    [[nodiscard]] Mesh parse(size_t threads = thread_count()) {
+
+        auto chunks = split_chunks(threads);
+
+        // Everything but the mesh itself lives in arenas that are released in
+        // one go at the end. Chunks are parsed concurrently, so each gets its
+        // own, the last one is for merging and assembly.
+        auto arenas = std::make_unique<std::pmr::monotonic_buffer_resource[]>(chunks.size() + 1);
+        auto *arena = &arenas[chunks.size()];
+
+        std::vector<std::optional<ObjData>> results(chunks.size());
+
+        parallel_for(chunks.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                results[i].emplace(ObjChunkParser(chunks[i], &obj_line_kernels(), &arenas[i]).parse());
+        });
+
+        // moving keeps the arena of each chunk, assigning would not
+        std::vector<ObjData> parsed;
+        parsed.reserve(chunks.size());
+        for (auto &result : results)
+            parsed.push_back(std::move(*result));
+        results.clear();
+
+        ObjData data = merge(parsed, arena);
+        parsed.clear();
+
+        // unless there was only one, the chunks have been copied out
+        if (chunks.size() > 1) {
+            for (size_t i = 0; i < chunks.size(); ++i)
+                arenas[i].release();
+        }
+
+        data.triangulate(data.m_vertices);
+
+        ObjNameTable materials;
+        ObjNameTable groups;
+        auto submeshes = group_by_material(data, materials, groups);
+
+        Mesh mesh = assemble(data, arena);
+        mesh.m_submeshes = std::move(submeshes);
+        mesh.m_materials = materials.take();
+        mesh.m_groups = groups.take();
+        mesh.m_material_libs.assign(data.m_material_libs.begin(), data.m_material_libs.end());
+        return mesh;
+
+    }
+
+private:
+    // The vertex layout only has room for the attributes the faces refer to,
+    // and every layout gets its own assembly loop.
+    [[nodiscard]] static Mesh assemble(const ObjData &data, std::pmr::memory_resource *arena) {
+        check_indices(data);
+        return dispatch_attribs(data.m_attribs, [&]<unsigned A>() { return assemble<A>(data, arena); });
+    }
+
+    // Splits the triangles into runs of one material and group, then moves
+    // the runs so that each submesh and each material is contiguous. Faces
+    // before the first usemtl, g or o statement get the name "".
+    [[nodiscard]] static std::vector<Submesh>
+    group_by_material(ObjData &data, ObjNameTable &materials, ObjNameTable &groups) {
+
+        struct Run {
+            size_t m_first;
+            size_t m_count;
+            uint32_t m_submesh;
+        };
+
+        std::vector<Run> runs;
+        std::vector<Submesh> submeshes;
+        std::unordered_map<uint64_t, uint32_t> submesh_ids;
+
+        auto &corners = data.m_corners;
+        size_t next_material = 0;
+        size_t next_group = 0;
+        uint32_t material = 0;
+        uint32_t group = 0;
+
+        for (size_t first = 0; first < corners.size(); ) {
+
+            // statements may follow each other without faces in between
+            for (; next_material < data.m_materials.size() && data.m_materials[next_material].m_first <= first; ++next_material)
+                material = materials.intern(data.m_materials[next_material].m_name);
+
+            for (; next_group < data.m_groups.size() && data.m_groups[next_group].m_first <= first; ++next_group)
+                group = groups.intern(data.m_groups[next_group].m_name);
+
+            if (next_material == 0) material = materials.intern("");
+            if (next_group == 0) group = groups.intern("");
+
+            size_t end = corners.size();
+            if (next_material < data.m_materials.size()) end = std::min(end, data.m_materials[next_material].m_first);
+            if (next_group < data.m_groups.size()) end = std::min(end, data.m_groups[next_group].m_first);
+
+            uint64_t key = uint64_t(material) << 32 | group;
+            auto [it, inserted] = submesh_ids.try_emplace(key, submeshes.size());
+            if (inserted)
+                submeshes.push_back({ material, group, 0, 0 });
+
+            submeshes[it->second].m_count += end - first;
+            runs.push_back({ first, end - first, it->second });
+            first = end;
+        }
+
+        // the ids already are in order of first use
+        std::vector<uint32_t> order(submeshes.size());
+        for (uint32_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+
+        std::ranges::stable_sort(order, [&](uint32_t a, uint32_t b) {
+            return submeshes[a].m_material < submeshes[b].m_material;
+        });
+
+        uint32_t offset = 0;
+        for (uint32_t i : order) {
+            submeshes[i].m_first = offset;
+            offset += submeshes[i].m_count;
+        }
+
+        // where each run goes, runs of one submesh keep their order
+        std::vector<size_t> targets(runs.size());
+        std::vector<uint32_t> cursors(submeshes.size());
+        bool moved = false;
+
+        for (uint32_t i = 0; i < submeshes.size(); ++i)
+            cursors[i] = submeshes[i].m_first;
+
+        for (size_t i = 0; i < runs.size(); ++i) {
+            targets[i] = cursors[runs[i].m_submesh];
+            cursors[runs[i].m_submesh] += runs[i].m_count;
+            moved |= targets[i] != runs[i].m_first;
+        }
+
+        if (moved) {
+            std::pmr::vector<ObjCorner> grouped(corners.size(), corners.get_allocator());
+
+            parallel_for(runs.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    auto run = corners.begin() + runs[i].m_first;
+                    std::copy(run, run + runs[i].m_count, grouped.begin() + targets[i]);
+                }
+            });
+
+            corners = std::move(grouped);
+        }
+
+        std::vector<Submesh> sorted;
+        for (uint32_t i : order)
+            sorted.push_back(submeshes[i]);
+
+        return sorted;
+    }
+
+    // Every distinct corner becomes one vertex. Deduplication runs on one
+    // thread, the attributes of the unique corners are gathered in parallel.
+    template <unsigned A>
+    [[nodiscard]] static Mesh assemble(const ObjData &data, std::pmr::memory_resource *arena) {
+
+        auto &corners = data.m_corners;
+
+        Mesh mesh;
+        mesh.m_indices.resize(corners.size());
+
+        // corners are only positions, so the positions already are the vertices
+        if constexpr (A == ATTRIB_POSITION) {
+            mesh.resize_vertices<A>(data.m_vertices.size());
+            auto vertices = mesh.vertices<A>();
+
+            parallel_for(corners.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    mesh.m_indices[i] = corners[i].m_vert - 1;
+            }, 1 << 16);
+
+            parallel_for(vertices.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    vertices[i].m_pos = data.m_vertices[i];
+            }, 1 << 16);
+
+        } else {
+            ObjCornerMap map(corners.size(), arena);
+
+            for (size_t i = 0; i < corners.size(); ++i)
+                mesh.m_indices[i] = map.insert(corners[i]);
+
+            auto unique = map.corners();
+            mesh.resize_vertices<A>(unique.size());
+            auto vertices = mesh.vertices<A>();
+
+            parallel_for(unique.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    vertices[i] = data.vertex<A>(unique[i]);
+            }, 1 << 16);
+        }
+
+        return mesh;
+    }
+
+    static void check_indices(const ObjData &data) {
+        std::atomic<bool> valid = true;
+
+        parallel_for(data.m_corners.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end && valid; ++i) {
+                if (!data.in_range(data.m_corners[i]))
+                    valid = false;
+            }
+        }, 1 << 16);
+
+        if (!valid) {
+            std::println(stderr, "> Obj Parser Error:");
+            std::println(stderr, "Face index out of range");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    [[nodiscard]] std::vector<std::string_view> split_chunks(size_t threads) const {
+        auto src = m_file.view();
+        threads = std::clamp<size_t>(src.size() / MIN_CHUNK_SIZE, 1, threads);
+
+        std::vector<std::string_view> chunks;
+        size_t start = 0;
+
+        for (size_t i = 1; i <= threads && start < src.size(); ++i) {
+            size_t end = src.size();
+
+            if (i != threads) {
+                end = src.find('\n', std::max(start, src.size() * i / threads));
+                end = end == std::string_view::npos ? src.size() : end + 1;
+            }
+
+            chunks.push_back(src.substr(start, end - start));
+            start = end;
+        }
+
+        return chunks;
+    }
+
+    [[nodiscard]] static ObjData merge(std::vector<ObjData> &chunks, std::pmr::memory_resource *arena) {
+
+        // what comes before each chunk once they are concatenated
+        std::vector<ObjCorner> bases(chunks.size(), { 0, 0, 0 });
+        std::vector<size_t> firsts(chunks.size(), 0);
+
+        for (size_t i = 1; i < chunks.size(); ++i) {
+            auto &prev = chunks[i-1];
+            bases[i] = {
+                static_cast<unsigned int>(bases[i-1].m_vert + prev.m_vertices.size()),
+                static_cast<unsigned int>(bases[i-1].m_tex + prev.m_uvs.size()),
+                static_cast<unsigned int>(bases[i-1].m_norm + prev.m_normals.size()),
+            };
+            firsts[i] = firsts[i-1] + prev.m_corners.size();
+        }
+
+        parallel_for(chunks.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                chunks[i].rebase(bases[i], firsts[i]);
+        });
+
+        // a single chunk already is the whole file, in its own arena
+        if (chunks.size() == 1)
+            return std::move(chunks.front());
+
+        ObjData merged(arena);
+
+        merge_member(chunks, merged, &ObjData::m_vertices);
+        merge_member(chunks, merged, &ObjData::m_normals);
+        merge_member(chunks, merged, &ObjData::m_uvs);
+        merge_member(chunks, merged, &ObjData::m_corners);
+        merge_member(chunks, merged, &ObjData::m_polygons);
+        merge_member(chunks, merged, &ObjData::m_materials);
+        merge_member(chunks, merged, &ObjData::m_groups);
+        merge_member(chunks, merged, &ObjData::m_material_libs);
+
+        for (auto &chunk : chunks)
+            merged.m_attribs |= chunk.m_attribs;
+
+        return merged;
+    }
+
+    template <typename T>
+    static void merge_member(std::vector<ObjData> &chunks, ObjData &merged, std::pmr::vector<T> ObjData::*member) {
+
+        std::vector<size_t> offsets(chunks.size() + 1, 0);
+        for (size_t i = 0; i < chunks.size(); ++i)
+            offsets[i+1] = offsets[i] + (chunks[i].*member).size();
+
+        auto &dst = merged.*member;
+        dst.resize(offsets.back());
+
+        parallel_for(chunks.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                std::ranges::copy(chunks[i].*member, dst.begin() + offsets[i]);
+            }
+        });
+    }
+
+};
@@ -0,0 +1,39 @@
+#include "objfast.hh"
+#include "objfast_impl.hh"
+
+
+
+const ObjLineKernels OBJ_KERNELS_SCALAR {
+    "scalar",
+    scalar_floats,
+    scalar_face,
+};
+
+[[nodiscard]] std::span<const ObjLineKernels *const> obj_supported_kernels() {
+
+    struct Supported {
+        const ObjLineKernels *m_kernels[3];
+        size_t m_count = 0;
+    };
+
+    static const Supported supported = [] {
+        Supported s;
+        __builtin_cpu_init();
+
+        s.m_kernels[s.m_count++] = &OBJ_KERNELS_SCALAR;
+
+        if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+            s.m_kernels[s.m_count++] = &OBJ_KERNELS_SSE42;
+
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("popcnt"))
+            s.m_kernels[s.m_count++] = &OBJ_KERNELS_AVX2;
+
+        return s;
+    }();
+
+    return { supported.m_kernels, supported.m_count };
+}
+
+[[nodiscard]] const ObjLineKernels &obj_line_kernels() {
+    return *obj_supported_kernels().back();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+
+
+// one face line as read by the fast path, 0 marks an empty index ("1//3")
+struct ObjFaceLine {
+    static constexpr int MAX_CORNERS = 16;
+    uint32_t m_corners[MAX_CORNERS][3];
+    // number of slash separated indices per corner, 1 to 3
+    uint8_t m_components[MAX_CORNERS];
+    int m_count;
+};
+
+// Fast paths for the line shapes that make up almost all of a large OBJ file:
+// "v x y z", "vn x y z", "vt u v" and "f a/b/c ...". p points right after the
+// keyword. Every kernel returns the position after the line's newline, or
+// nullptr if the line is unusual (comments, exponents, negative indices, ...)
+// and has to go through ObjLexer instead.
+//
+// All kernels convert numbers the same way, so their results are identical.
+struct ObjLineKernels {
+    const char *m_name;
+    const char *(*m_floats)(const char *p, const char *end, float *out, int count);
+    const char *(*m_face)(const char *p, const char *end, ObjFaceLine &out);
+};
+
+extern const ObjLineKernels OBJ_KERNELS_SCALAR;
+extern const ObjLineKernels OBJ_KERNELS_SSE42;
+extern const ObjLineKernels OBJ_KERNELS_AVX2;
+
+// the fastest kernels the cpu supports, picked once at runtime
+[[nodiscard]] const ObjLineKernels &obj_line_kernels();
+
+// every kernel set the cpu supports, slowest first
+[[nodiscard]] std::span<const ObjLineKernels *const> obj_supported_kernels();
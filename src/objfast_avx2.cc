@@ -0,0 +1,92 @@
+// compiled with -mavx2 -mbmi -mpopcnt, only called if the cpu supports it
+#include <immintrin.h>
+
+#include "objfast.hh"
+#include "objfast_impl.hh"
+
+
+
+namespace {
+
+struct Avx2 {
+
+    [[nodiscard]] static LineMasks classify(const char *p) {
+        LineMasks m { };
+
+        for (int i = 0; i < SIMD_WINDOW; i += 32) {
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+            __m256i d = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+
+            auto bits = [&](__m256i eq) {
+                return uint64_t(uint32_t(_mm256_movemask_epi8(eq))) << i;
+            };
+
+            m.m_digit   |= bits(_mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d));
+            m.m_dot     |= bits(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('.')));
+            m.m_minus   |= bits(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('-')));
+            m.m_slash   |= bits(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('/')));
+            m.m_newline |= bits(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n')));
+            m.m_space   |= bits(_mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\t'))),
+                _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\r'))
+            ));
+        }
+
+        return m;
+    }
+
+    [[nodiscard]] static __m128i digits(const NumberRun &run) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(run.m_start));
+        auto *control = DIGIT_SHUFFLES.m_control[run.m_digits][run.m_integer];
+        return _mm_shuffle_epi8(
+            _mm_sub_epi8(v, _mm_set1_epi8('0')),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(control))
+        );
+    }
+
+    // Converts two runs per iteration, one in each 128 bit lane. All steps
+    // below work within their lane.
+    static void convert(const NumberRun *runs, int count, uint64_t *out) {
+        for (int i = 0; i < count; i += 2) {
+            __m128i high_lane = i + 1 < count ? digits(runs[i+1]) : _mm_setzero_si128();
+            __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(digits(runs[i])), high_lane, 1);
+
+            v = _mm256_maddubs_epi16(v, _mm256_setr_epi8(
+                10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1,
+                10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1
+            ));
+            v = _mm256_madd_epi16(v, _mm256_setr_epi16(
+                100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1
+            ));
+            v = _mm256_packus_epi32(v, v);
+            v = _mm256_madd_epi16(v, _mm256_setr_epi16(
+                10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1, 10000, 1
+            ));
+
+            out[i] = uint64_t(uint32_t(_mm256_extract_epi32(v, 0))) * 100000000
+                   + uint32_t(_mm256_extract_epi32(v, 1));
+
+            if (i + 1 < count) {
+                out[i+1] = uint64_t(uint32_t(_mm256_extract_epi32(v, 4))) * 100000000
+                         + uint32_t(_mm256_extract_epi32(v, 5));
+            }
+        }
+    }
+
+};
+
+const char *avx2_floats(const char *p, const char *end, float *out, int count) {
+    return simd_floats<Avx2>(p, end, out, count);
+}
+
+const char *avx2_face(const char *p, const char *end, ObjFaceLine &out) {
+    return simd_face<Avx2>(p, end, out);
+}
+
+} // namespace
+
+const ObjLineKernels OBJ_KERNELS_AVX2 {
+    "avx2",
+    avx2_floats,
+    avx2_face,
+};
@@ -0,0 +1,385 @@
+#pragma once
+
+// Shared implementation of the kernels in objfast.hh. It is included by one
+// translation unit per instruction set, each compiled with different target
+// flags. Everything in here has internal linkage, so the linker can never mix
+// up an AVX2 instantiation with the one of the baseline build. For the same
+// reason this avoids the standard library beyond plain C headers.
+
+#include <cstdint>
+#include <cstring>
+
+#include "objfast.hh"
+
+namespace {
+
+// every one of them is exact as a float, 5^10 still fits in 24 bits
+constexpr float POW10[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f,
+};
+
+// and these as a double
+constexpr double POW10_DOUBLE[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+    1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16,
+};
+
+// Clinger's fast path: a mantissa and a power of ten that are both exact
+// floats give the correctly rounded float in one division, bit for bit what
+// std::from_chars in the lexer returns.
+constexpr uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 24;
+constexpr int MAX_EXACT_FRACTION = 10;
+
+// The same in double precision is exact up to 2^53, rounding that to a
+// float is only wrong if the double landed right on a float midpoint.
+constexpr uint64_t MAX_EXACT_MANTISSA_DOUBLE = uint64_t(1) << 53;
+// the bits of a double's mantissa that a float does not have
+constexpr uint64_t FLOAT_DROPPED_BITS = (uint64_t(1) << 29) - 1;
+constexpr uint64_t FLOAT_MIDPOINT = uint64_t(1) << 28;
+
+// most characters one number may have on the fast path, longer ones fall back
+constexpr int MAX_FLOAT_DIGITS = 16;
+constexpr int MAX_INDEX_DIGITS = 9;
+
+[[nodiscard]] inline bool is_digit(char c) {
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+[[nodiscard]] inline bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// digits is the mantissa without the dot, fraction the number of digits
+// after it. False if the result might not be correctly rounded, then the
+// line falls back to the lexer.
+[[nodiscard]] inline bool make_float(uint64_t digits, int fraction, bool negative, float &out) {
+    float value;
+
+    if (digits <= MAX_EXACT_MANTISSA && fraction <= MAX_EXACT_FRACTION) {
+        value = static_cast<float>(digits) / POW10[fraction];
+    } else {
+        if (digits > MAX_EXACT_MANTISSA_DOUBLE)
+            return false;
+
+        // rounding to a double may move a value onto a float midpoint, but
+        // never across one, so any other double rounds to the right float
+        double wide = static_cast<double>(digits) / POW10_DOUBLE[fraction];
+        uint64_t bits;
+        memcpy(&bits, &wide, sizeof(bits));
+        if ((bits & FLOAT_DROPPED_BITS) == FLOAT_MIDPOINT)
+            return false;
+
+        value = static_cast<float>(wide);
+    }
+
+    out = negative ? -value : value;
+    return true;
+}
+
+// Expects at least one space, then a number that ends in a space or a newline.
+[[nodiscard]] inline const char *scalar_float(const char *p, const char *end, float &out) {
+
+    if (p == end || !is_space(*p))
+        return nullptr;
+
+    while (p != end && is_space(*p))
+        p++;
+
+    bool negative = p != end && *p == '-';
+    if (negative)
+        p++;
+
+    uint64_t digits = 0;
+    int count = 0;
+    int fraction = -1;
+
+    for (; p != end; p++) {
+        if (is_digit(*p)) {
+            digits = digits * 10 + (*p - '0');
+            count++;
+
+            if (fraction != -1)
+                fraction++;
+
+        } else if (*p == '.' && fraction == -1) {
+            fraction = 0;
+
+        } else {
+            break;
+        }
+    }
+
+    // same limit as the simd kernels, the dot counts towards it
+    if (count == 0 || count + (fraction != -1) > MAX_FLOAT_DIGITS)
+        return nullptr;
+
+    if (p != end && !is_space(*p) && *p != '\n')
+        return nullptr;
+
+    if (!make_float(digits, fraction == -1 ? 0 : fraction, negative, out))
+        return nullptr;
+
+    return p;
+}
+
+// skips trailing whitespace and the newline
+[[nodiscard]] inline const char *scalar_line_end(const char *p, const char *end) {
+    while (p != end && is_space(*p))
+        p++;
+
+    if (p == end)
+        return p;
+
+    return *p == '\n' ? p + 1 : nullptr;
+}
+
+[[nodiscard]] inline const char *scalar_floats(const char *p, const char *end, float *out, int count) {
+    for (int i = 0; i < count; ++i) {
+        p = scalar_float(p, end, out[i]);
+        if (p == nullptr)
+            return nullptr;
+    }
+
+    return scalar_line_end(p, end);
+}
+
+[[nodiscard]] inline const char *scalar_face(const char *p, const char *end, ObjFaceLine &out) {
+    out.m_count = 0;
+
+    while (true) {
+        const char *start = p;
+
+        while (p != end && is_space(*p))
+            p++;
+
+        if (p == end || *p == '\n')
+            break;
+
+        // corners have to be separated
+        if (p == start || out.m_count == ObjFaceLine::MAX_CORNERS)
+            return nullptr;
+
+        auto &corner = out.m_corners[out.m_count];
+        int component = 0;
+
+        while (true) {
+            uint32_t value = 0;
+            int digits = 0;
+
+            for (; p != end && is_digit(*p); p++, digits++)
+                value = value * 10 + (*p - '0');
+
+            // only the texture index may be left out, as in "1//3"
+            if (digits > MAX_INDEX_DIGITS || (digits == 0 && component != 1))
+                return nullptr;
+
+            corner[component++] = value;
+
+            if (p == end || *p != '/')
+                break;
+
+            if (component == 3)
+                return nullptr;
+
+            p++;
+        }
+
+        if (p != end && !is_space(*p) && *p != '\n')
+            return nullptr;
+
+        // "1/" is not a valid corner either
+        if (corner[component - 1] == 0 && component == 2)
+            return nullptr;
+
+        for (int i = component; i < 3; ++i)
+            corner[i] = 0;
+
+        out.m_components[out.m_count++] = component;
+    }
+
+    return scalar_line_end(p, end);
+}
+
+// Bit i of every mask describes byte i of a 64 byte window.
+struct LineMasks {
+    uint64_t m_digit;
+    uint64_t m_dot;
+    uint64_t m_minus;
+    uint64_t m_slash;
+    uint64_t m_space;
+    uint64_t m_newline;
+};
+
+// Shuffle controls that right-align the digits of a number in 16 bytes and
+// drop its dot. Indexed by [digits][digits before the dot], equal indices
+// mean there is no dot. Bytes left of the number are zeroed (0x80).
+struct DigitShuffles {
+    alignas(16) uint8_t m_control[17][17][16];
+
+    constexpr DigitShuffles() : m_control() {
+        for (int n = 0; n <= 16; ++n) {
+            for (int a = 0; a <= n; ++a) {
+                for (int k = 0; k < 16; ++k) {
+                    int t = k - (16 - n);
+                    m_control[n][a][k] = t < 0 ? 0x80 : (t < a ? t : t + 1);
+                }
+            }
+        }
+    }
+};
+
+constexpr DigitShuffles DIGIT_SHUFFLES;
+
+// A number found in the window: digit count, digits before the dot, sign.
+struct NumberRun {
+    const char *m_start;
+    int m_digits;
+    int m_integer;
+    bool m_negative;
+};
+
+// Isa provides classify(p) -> LineMasks for 64 bytes and
+// convert(runs, count, out) which turns NumberRuns into their integer digits.
+// Both may read up to 80 bytes past the start of the line.
+constexpr int SIMD_WINDOW = 64;
+constexpr int SIMD_READ = SIMD_WINDOW + 16;
+
+template <typename Isa>
+[[nodiscard]] inline const char *simd_floats(const char *p, const char *end, float *out, int count) {
+
+    if (end - p < SIMD_READ)
+        return scalar_floats(p, end, out, count);
+
+    LineMasks m = Isa::classify(p);
+
+    // lines longer than the window are rare, they are still valid
+    if (m.m_newline == 0)
+        return scalar_floats(p, end, out, count);
+
+    int length = __builtin_ctzll(m.m_newline);
+    uint64_t line = (uint64_t(1) << length) - 1;
+
+    uint64_t number = (m.m_digit | m.m_dot | m.m_minus) & line;
+    if ((number | (m.m_space & line)) != line || (m.m_space & 1) == 0)
+        return nullptr;
+
+    uint64_t starts = number & ~(number << 1);
+    if (__builtin_popcountll(starts) != count)
+        return nullptr;
+
+    NumberRun runs[4];
+
+    for (int i = 0; i < count; ++i) {
+        int s = __builtin_ctzll(starts);
+        starts &= starts - 1;
+
+        int size = __builtin_ctzll(~(number >> s));
+        uint64_t run = ((uint64_t(1) << size) - 1) << s;
+
+        bool negative = (m.m_minus >> s) & 1;
+        int dots = __builtin_popcountll(m.m_dot & run);
+
+        // a minus sign may only lead the number
+        if (__builtin_popcountll(m.m_minus & run) != int(negative) || dots > 1)
+            return nullptr;
+
+        int first = s + negative;
+        int digits = size - negative - dots;
+
+        if (digits == 0 || digits + dots > MAX_FLOAT_DIGITS)
+            return nullptr;
+
+        int integer = dots ? __builtin_ctzll(m.m_dot >> first) : digits;
+        runs[i] = { p + first, digits, integer, negative };
+    }
+
+    uint64_t values[4];
+    Isa::convert(runs, count, values);
+
+    for (int i = 0; i < count; ++i) {
+        if (!make_float(values[i], runs[i].m_digits - runs[i].m_integer, runs[i].m_negative, out[i]))
+            return nullptr;
+    }
+
+    return p + length + 1;
+}
+
+template <typename Isa>
+[[nodiscard]] inline const char *simd_face(const char *p, const char *end, ObjFaceLine &out) {
+
+    if (end - p < SIMD_READ)
+        return scalar_face(p, end, out);
+
+    LineMasks m = Isa::classify(p);
+
+    if (m.m_newline == 0)
+        return scalar_face(p, end, out);
+
+    int length = __builtin_ctzll(m.m_newline);
+    uint64_t line = (uint64_t(1) << length) - 1;
+
+    uint64_t corner = (m.m_digit | m.m_slash) & line;
+    if ((corner | (m.m_space & line)) != line || (m.m_space & 1) == 0)
+        return nullptr;
+
+    uint64_t starts = corner & ~(corner << 1);
+    int corners = __builtin_popcountll(starts);
+    if (corners > ObjFaceLine::MAX_CORNERS)
+        return nullptr;
+
+    NumberRun runs[ObjFaceLine::MAX_CORNERS * 3];
+    int run_count = 0;
+
+    for (int c = 0; c < corners; ++c) {
+        int s = __builtin_ctzll(starts);
+        starts &= starts - 1;
+
+        int end_of_corner = s + __builtin_ctzll(~(corner >> s));
+        int pos = s;
+        int component = 0;
+
+        while (true) {
+            int digits = __builtin_ctzll(~(m.m_digit >> pos));
+
+            // only the texture index may be left out, as in "1//3"
+            if (digits > MAX_INDEX_DIGITS || (digits == 0 && component != 1))
+                return nullptr;
+
+            if (digits != 0)
+                runs[run_count++] = { p + pos, digits, digits, false };
+
+            // marks where the converted run goes, see below
+            out.m_corners[c][component++] = digits != 0;
+
+            pos += digits;
+
+            if (pos == end_of_corner)
+                break;
+
+            // pos is a slash here, and a corner may not end with one
+            if (component == 3 || ++pos == end_of_corner)
+                return nullptr;
+        }
+
+        for (int i = component; i < 3; ++i)
+            out.m_corners[c][i] = 0;
+
+        out.m_components[c] = component;
+    }
+
+    uint64_t values[ObjFaceLine::MAX_CORNERS * 3];
+    Isa::convert(runs, run_count, values);
+
+    int next = 0;
+    for (int c = 0; c < corners; ++c) {
+        for (int i = 0; i < out.m_components[c]; ++i) {
+            if (out.m_corners[c][i] != 0)
+                out.m_corners[c][i] = values[next++];
+        }
+    }
+
+    out.m_count = corners;
+    return p + length + 1;
+}
+
+} // namespace
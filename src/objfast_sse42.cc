@@ -0,0 +1,77 @@
+// compiled with -msse4.2 -mpopcnt, only called if the cpu supports it
+#include <immintrin.h>
+
+#include "objfast.hh"
+#include "objfast_impl.hh"
+
+
+
+namespace {
+
+struct Sse42 {
+
+    [[nodiscard]] static LineMasks classify(const char *p) {
+        LineMasks m { };
+
+        for (int i = 0; i < SIMD_WINDOW; i += 16) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+            __m128i d = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+
+            auto bits = [&](__m128i eq) {
+                return uint64_t(uint16_t(_mm_movemask_epi8(eq))) << i;
+            };
+
+            m.m_digit   |= bits(_mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d));
+            m.m_dot     |= bits(_mm_cmpeq_epi8(c, _mm_set1_epi8('.')));
+            m.m_minus   |= bits(_mm_cmpeq_epi8(c, _mm_set1_epi8('-')));
+            m.m_slash   |= bits(_mm_cmpeq_epi8(c, _mm_set1_epi8('/')));
+            m.m_newline |= bits(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')));
+            m.m_space   |= bits(_mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\t'))),
+                _mm_cmpeq_epi8(c, _mm_set1_epi8('\r'))
+            ));
+        }
+
+        return m;
+    }
+
+    // right-aligns the digits of one run and folds them 2, 4 and 8 at a time
+    [[nodiscard]] static uint64_t convert_one(const NumberRun &run) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(run.m_start));
+        v = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+
+        auto *control = DIGIT_SHUFFLES.m_control[run.m_digits][run.m_integer];
+        v = _mm_shuffle_epi8(v, _mm_load_si128(reinterpret_cast<const __m128i*>(control)));
+
+        v = _mm_maddubs_epi16(v, _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+        v = _mm_madd_epi16(v, _mm_setr_epi16(100, 1, 100, 1, 100, 1, 100, 1));
+        v = _mm_packus_epi32(v, v);
+        v = _mm_madd_epi16(v, _mm_setr_epi16(10000, 1, 10000, 1, 10000, 1, 10000, 1));
+
+        uint64_t high = uint32_t(_mm_cvtsi128_si32(v));
+        uint64_t low = uint32_t(_mm_extract_epi32(v, 1));
+        return high * 100000000 + low;
+    }
+
+    static void convert(const NumberRun *runs, int count, uint64_t *out) {
+        for (int i = 0; i < count; ++i)
+            out[i] = convert_one(runs[i]);
+    }
+
+};
+
+const char *sse42_floats(const char *p, const char *end, float *out, int count) {
+    return simd_floats<Sse42>(p, end, out, count);
+}
+
+const char *sse42_face(const char *p, const char *end, ObjFaceLine &out) {
+    return simd_face<Sse42>(p, end, out);
+}
+
+} // namespace
+
+const ObjLineKernels OBJ_KERNELS_SSE42 {
+    "sse4.2",
+    sse42_floats,
+    sse42_face,
+};
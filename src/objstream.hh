@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <print>
+#include <span>
+#include <vector>
+
+#include "obj.hh"
+
+
+
+// Receives the vertices of one batch and the triangles indexing into them.
+// The view is only valid during the call.
+using ObjBatchSink = std::function<void(MeshView)>;
+
+// Parses an OBJ file without ever holding all of it in memory. The file is
+// read in blocks of whole lines and faces are assembled into batches of at
+// most batch_vertices unique vertices, which are handed to a sink and
+// then discarded.
+//
+// Batches have to share one layout before the faces are known, so unlike
+// ObjParser the vertex attributes are picked by the caller. Attributes a
+// face leaves out are zero. Batches are split into submeshes in file
+// order, grouping them by material is left to the sink.
+//
+// Faces can refer to any earlier v/vt/vn line, so the attribute tables are
+// the only storage that grows with the file. They are much smaller than
+// the text, the face corners or the assembled vertices.
+class ObjStreamParser {
+    std::ifstream m_file;
+    size_t m_block_size;
+    size_t m_batch_vertices;
+    ObjData m_tables;
+    // temporaries of the block being parsed
+    std::pmr::monotonic_buffer_resource m_block_arena;
+    ObjCornerMap m_corners;
+    Mesh m_batch;
+    ObjNameTable m_materials;
+    ObjNameTable m_groups;
+    // current usemtl and g/o statement, UINT32_MAX before the first one
+    uint32_t m_material = UINT32_MAX;
+    uint32_t m_group = UINT32_MAX;
+
+public:
+    ObjStreamParser(
+        const char *filename,
+        unsigned attribs = ATTRIB_POSITION | ATTRIB_UV,
+        size_t block_size = 1 << 20,
+        size_t batch_vertices = 1 << 16
+    )
+    : m_file(filename, std::ios::binary)
+    , m_block_size(block_size)
+    , m_batch_vertices(std::max<size_t>(batch_vertices, 3))
+    , m_corners(m_batch_vertices)
+    {
+        if (!m_file) {
+            std::println(stderr, "Failed to open file: {}", filename);
+            exit(EXIT_FAILURE);
+        }
+
+        if (!is_valid_attribs(attribs)) {
+            std::println(stderr, "Invalid vertex attributes: {:#x}", attribs);
+            exit(EXIT_FAILURE);
+        }
+
+        m_batch.m_attribs = attribs;
+    }
+
+    void parse(const ObjBatchSink &sink) {
+
+        std::vector<char> block(m_block_size);
+        size_t filled = 0;
+
+        while (true) {
+            m_file.read(block.data() + filled, block.size() - filled);
+            filled += m_file.gcount();
+            bool eof = filled < block.size();
+
+            std::string_view text(block.data(), filled);
+            size_t line_end = eof ? text.size() : text.rfind('\n') + 1;
+
+            // a single line longer than the block, give it more room
+            if (line_end == 0) {
+                block.resize(block.size() * 2);
+                continue;
+            }
+
+            parse_lines(text.substr(0, line_end), sink);
+            m_block_arena.release();
+
+            if (eof)
+                break;
+
+            // keep the partial last line for the next block
+            memmove(block.data(), block.data() + line_end, filled - line_end);
+            filled -= line_end;
+        }
+
+        flush(sink);
+    }
+
+private:
+    void parse_lines(std::string_view lines, const ObjBatchSink &sink) {
+        ObjData data = ObjChunkParser(lines, &obj_line_kernels(), &m_block_arena).parse();
+
+        data.rebase({
+            static_cast<unsigned int>(m_tables.m_vertices.size()),
+            static_cast<unsigned int>(m_tables.m_uvs.size()),
+            static_cast<unsigned int>(m_tables.m_normals.size()),
+        }, 0);
+
+        append(m_tables.m_vertices, data.m_vertices);
+        append(m_tables.m_uvs, data.m_uvs);
+        append(m_tables.m_normals, data.m_normals);
+        append(m_tables.m_material_libs, data.m_material_libs);
+
+        data.triangulate(m_tables.m_vertices);
+
+        auto &corners = data.m_corners;
+        size_t next_material = 0;
+        size_t next_group = 0;
+
+        for (size_t i = 0; i + 3 <= corners.size(); i += 3) {
+
+            for (; next_material < data.m_materials.size() && data.m_materials[next_material].m_first <= i; ++next_material)
+                m_material = m_materials.intern(data.m_materials[next_material].m_name);
+
+            for (; next_group < data.m_groups.size() && data.m_groups[next_group].m_first <= i; ++next_group)
+                m_group = m_groups.intern(data.m_groups[next_group].m_name);
+
+            // triangles never straddle two batches
+            if (m_corners.corners().size() + 3 > m_batch_vertices)
+                flush(sink);
+
+            add_to_submesh();
+
+            for (size_t j = i; j < i + 3; ++j) {
+                if (!m_tables.in_range(corners[j])) {
+                    std::println(stderr, "> Obj Parser Error:");
+                    std::println(stderr, "Face index out of range");
+                    exit(EXIT_FAILURE);
+                }
+
+                m_batch.m_indices.push_back(m_corners.insert(mask(corners[j])));
+            }
+        }
+    }
+
+    // Faces before the first statement get the name "", like in ObjParser.
+    void add_to_submesh() {
+        if (m_material == UINT32_MAX) m_material = m_materials.intern("");
+        if (m_group == UINT32_MAX) m_group = m_groups.intern("");
+
+        auto &submeshes = m_batch.m_submeshes;
+        if (submeshes.empty() || submeshes.back().m_material != m_material || submeshes.back().m_group != m_group) {
+            uint32_t first = m_batch.m_indices.size();
+            submeshes.push_back({ m_material, m_group, first, 0 });
+        }
+
+        submeshes.back().m_count += 3;
+    }
+
+    // drops the indices of attributes the batch has no room for, so corners
+    // that only differ in those still share a vertex
+    [[nodiscard]] ObjCorner mask(ObjCorner corner) const {
+        if ((m_batch.m_attribs & ATTRIB_UV) == 0) corner.m_tex = 0;
+        if ((m_batch.m_attribs & ATTRIB_NORMAL) == 0) corner.m_norm = 0;
+        return corner;
+    }
+
+    void flush(const ObjBatchSink &sink) {
+        if (m_batch.m_indices.empty())
+            return;
+
+        dispatch_attribs(m_batch.m_attribs, [&]<unsigned A>() {
+            auto unique = m_corners.corners();
+            m_batch.resize_vertices<A>(unique.size());
+
+            auto vertices = m_batch.vertices<A>();
+            for (size_t i = 0; i < unique.size(); ++i)
+                vertices[i] = m_tables.vertex<A>(unique[i]);
+        });
+
+        auto view = m_batch.view();
+        view.m_materials = m_materials.names();
+        view.m_groups = m_groups.names();
+        view.m_material_libs = m_tables.m_material_libs;
+        sink(view);
+
+        m_batch.m_indices.clear();
+        m_batch.m_submeshes.clear();
+        m_corners.clear();
+    }
+
+    template <typename T>
+    static void append(std::pmr::vector<T> &dst, const std::pmr::vector<T> &src) {
+        dst.insert(dst.end(), src.begin(), src.end());
+    }
+
+};
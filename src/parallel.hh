@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+
+
+// asked once, glibc reads it from /sys on every call
+[[nodiscard]] inline size_t thread_count() {
+    static const size_t count = std::max(1u, std::thread::hardware_concurrency());
+    return count;
+}
+
+// Splits [0, count) into one contiguous range per thread and calls fn(begin, end)
+// for each of them. Ranges smaller than min_batch are not worth a thread, so
+// small inputs just run on the calling thread.
+template <typename Fn>
+void parallel_for(size_t count, Fn fn, size_t min_batch = 1, size_t threads = thread_count()) {
+
+    threads = std::clamp<size_t>(count / std::max<size_t>(min_batch, 1), 1, threads);
+
+    if (threads == 1) {
+        fn(size_t(0), count);
+        return;
+    }
+
+    std::vector<std::jthread> workers;
+    workers.reserve(threads - 1);
+
+    for (size_t i = 1; i < threads; ++i) {
+        size_t begin = count * i / threads;
+        size_t end = count * (i + 1) / threads;
+        workers.emplace_back([=] { fn(begin, end); });
+    }
+
+    fn(size_t(0), count / threads);
+}
+
+// Threads that stay around and run jobs in the order they were submitted,
+// for work the caller should not wait for, like decoding textures while
+// frames keep coming. Jobs still queued when the pool goes away are dropped,
+// running ones are waited for.
+class WorkerPool {
+    std::mutex m_mutex;
+    std::condition_variable_any m_wake;
+    std::deque<std::function<void()>> m_jobs;
+    // last, so the threads stop before the queue goes away
+    std::vector<std::jthread> m_threads;
+
+public:
+    explicit WorkerPool(size_t threads = thread_count()) {
+        for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+            m_threads.emplace_back([this](std::stop_token stop) { run(stop); });
+    }
+
+    ~WorkerPool() {
+        // every thread is told first, otherwise the ones joined last would
+        // keep taking jobs while the others are waited for
+        for (auto &thread : m_threads)
+            thread.request_stop();
+
+        std::lock_guard lock(m_mutex);
+        m_jobs.clear();
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool &operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_wake.notify_one();
+    }
+
+private:
+    void run(std::stop_token stop) {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock lock(m_mutex);
+                // the wait also returns with jobs left once stop is requested
+                if (!m_wake.wait(lock, stop, [&] { return !m_jobs.empty(); }) || stop.stop_requested())
+                    return;
+
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
@@ -0,0 +1,292 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "mesh.hh"
+#include "parallel.hh"
+
+
+
+enum class PositionFormat {
+    FLOAT,
+    // both relative to the bounding box of the mesh, padded to 8 bytes
+    HALF,
+    UNORM16,
+};
+
+// Tangents are stored the same way, followed by the sign of the bitangent.
+enum class NormalFormat {
+    FLOAT,
+    // two snorm16 coordinates on the unfolded octahedron
+    OCTAHEDRAL,
+};
+
+enum class UvFormat {
+    FLOAT,
+    HALF,
+    // relative to the uv range of the mesh
+    UNORM16,
+};
+
+enum class ColorFormat {
+    FLOAT,
+    // rgb in [0, 1], padded to 4 bytes
+    UNORM8,
+};
+
+// How each attribute of a vertex is stored on the GPU, in the order of
+// PackedVertex. Attributes a mesh does not have take no space.
+struct VertexFormat {
+    PositionFormat m_position = PositionFormat::FLOAT;
+    NormalFormat m_normal = NormalFormat::FLOAT;
+    UvFormat m_uv = UvFormat::FLOAT;
+    ColorFormat m_color = ColorFormat::FLOAT;
+
+    [[nodiscard]] size_t position_size() const {
+        return m_position == PositionFormat::FLOAT ? 12 : 8;
+    }
+
+    [[nodiscard]] size_t uv_size() const {
+        return m_uv == UvFormat::FLOAT ? 8 : 4;
+    }
+
+    [[nodiscard]] size_t normal_size() const {
+        return m_normal == NormalFormat::FLOAT ? 12 : 4;
+    }
+
+    // the sign is padded to 8 bytes when packed
+    [[nodiscard]] size_t tangent_size() const {
+        return m_normal == NormalFormat::FLOAT ? 16 : 8;
+    }
+
+    [[nodiscard]] size_t color_size() const {
+        return m_color == ColorFormat::FLOAT ? 12 : 4;
+    }
+
+    [[nodiscard]] size_t stride(unsigned attribs) const {
+        return position_size()
+            + (attribs & ATTRIB_UV ? uv_size() : 0)
+            + (attribs & ATTRIB_NORMAL ? normal_size() : 0)
+            + (attribs & ATTRIB_TANGENT ? tangent_size() : 0)
+            + (attribs & ATTRIB_COLOR ? color_size() : 0);
+    }
+};
+
+// same as PackedVertex
+static constexpr VertexFormat VERTEX_FORMAT_FLOAT { };
+
+// 16 bytes for a vertex with position, uv and normal instead of 32, 24
+// with a tangent instead of 48, 28 with a color instead of 60. Uvs are
+// unorm16 over the mesh's range, halves are only 2^-11 apart in [0.5, 1),
+// a few texels of a 4K map.
+static constexpr VertexFormat VERTEX_FORMAT_COMPACT {
+    PositionFormat::HALF,
+    NormalFormat::OCTAHEDRAL,
+    UvFormat::UNORM16,
+    ColorFormat::UNORM8,
+};
+
+// Rounds to the nearest half float, ties to even. Values out of range become
+// infinity, tiny ones denormals or zero.
+[[nodiscard]] inline uint16_t float_to_half(float value) {
+    uint32_t bits = std::bit_cast<uint32_t>(value);
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t mantissa = bits & 0x7fffff;
+    int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+
+    if (exponent >= 31)
+        return sign | 0x7c00;
+
+    // denormal, the implicit one becomes explicit
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t tie = 1u << (shift - 1);
+        return sign | (half + (rest > tie || (rest == tie && (half & 1))));
+    }
+
+    // a carry out of the mantissa correctly bumps the exponent
+    uint32_t half = (exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    return sign | (half + (rest > 0x1000 || (rest == 0x1000 && (half & 1))));
+}
+
+// value in [0, 1]
+[[nodiscard]] inline uint16_t float_to_unorm16(float value) {
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+// value in [0, 1]
+[[nodiscard]] inline uint8_t float_to_unorm8(float value) {
+    return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+// value in [-1, 1]
+[[nodiscard]] inline int16_t float_to_snorm16(float value) {
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+// Projects a unit vector onto the octahedron and unfolds the lower half over
+// the corners (Cigolle et al. 2014). Zero vectors map to +z.
+[[nodiscard]] inline glm::vec2 octahedral_encode(glm::vec3 n) {
+    float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (sum == 0.0f)
+        return glm::vec2(0.0f);
+
+    n /= sum;
+    if (n.z >= 0.0f)
+        return glm::vec2(n.x, n.y);
+
+    return glm::vec2(
+        (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+        (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f)
+    );
+}
+
+// Vertices in a VertexFormat, ready for upload. The shader gets the original
+// values back as offset + stored * scale.
+struct QuantizedVertices {
+    VertexFormat m_format;
+    unsigned m_attribs = ATTRIB_POSITION;
+    std::vector<std::byte> m_data;
+    glm::vec3 m_pos_offset { 0.0f };
+    glm::vec3 m_pos_scale { 1.0f };
+    glm::vec2 m_uv_offset { 0.0f };
+    glm::vec2 m_uv_scale { 1.0f };
+
+    [[nodiscard]] size_t stride() const {
+        return m_format.stride(m_attribs);
+    }
+};
+
+[[nodiscard]] inline QuantizedVertices quantize_vertices(MeshView mesh, VertexFormat format) {
+
+    QuantizedVertices out { format, mesh.m_attribs, { } };
+    size_t stride = out.stride();
+    size_t count = mesh.vertex_count();
+    out.m_data.resize(count * stride);
+
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        auto vertices = mesh.vertices<A>();
+
+        glm::vec3 pos_min(INFINITY), pos_max(-INFINITY);
+        glm::vec2 uv_min(INFINITY), uv_max(-INFINITY);
+
+        for (auto &vertex : vertices) {
+            pos_min = glm::min(pos_min, vertex.m_pos);
+            pos_max = glm::max(pos_max, vertex.m_pos);
+
+            if constexpr ((A & ATTRIB_UV) != 0) {
+                uv_min = glm::min(uv_min, vertex.m_uv);
+                uv_max = glm::max(uv_max, vertex.m_uv);
+            }
+        }
+
+        // a flat axis is stored as 0, any scale will do
+        auto extent = [](auto min, auto max) {
+            auto size = max - min;
+            for (int i = 0; i < size.length(); ++i)
+                size[i] = size[i] > 0.0f ? size[i] : 1.0f;
+            return size;
+        };
+
+        if (count != 0 && format.m_position == PositionFormat::HALF) {
+            // centered, halves are most precise around zero
+            out.m_pos_scale = extent(pos_min, pos_max) * 0.5f;
+            out.m_pos_offset = (pos_min + pos_max) * 0.5f;
+
+        } else if (count != 0 && format.m_position == PositionFormat::UNORM16) {
+            out.m_pos_scale = extent(pos_min, pos_max);
+            out.m_pos_offset = pos_min;
+        }
+
+        // uvs of tiled textures go past 1, the steps grow with the range
+        if constexpr ((A & ATTRIB_UV) != 0) {
+            if (count != 0 && format.m_uv == UvFormat::UNORM16) {
+                out.m_uv_scale = extent(uv_min, uv_max);
+                out.m_uv_offset = uv_min;
+            }
+        }
+
+        parallel_for(count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                auto *p = out.m_data.data() + i * stride;
+
+                auto put = [&](auto value) {
+                    memcpy(p, &value, sizeof(value));
+                    p += sizeof(value);
+                };
+
+                auto &vertex = vertices[i];
+                glm::vec3 pos = (vertex.m_pos - out.m_pos_offset) / out.m_pos_scale;
+
+                switch (format.m_position) {
+                    case PositionFormat::FLOAT:
+                        put(vertex.m_pos);
+                        break;
+                    case PositionFormat::HALF:
+                        put(std::array { float_to_half(pos.x), float_to_half(pos.y), float_to_half(pos.z), uint16_t(0) });
+                        break;
+                    case PositionFormat::UNORM16:
+                        put(std::array { float_to_unorm16(pos.x), float_to_unorm16(pos.y), float_to_unorm16(pos.z), uint16_t(0) });
+                        break;
+                }
+
+                if constexpr ((A & ATTRIB_UV) != 0) {
+                    glm::vec2 uv = (vertex.m_uv - out.m_uv_offset) / out.m_uv_scale;
+
+                    switch (format.m_uv) {
+                        case UvFormat::FLOAT:   put(vertex.m_uv); break;
+                        case UvFormat::HALF:    put(std::array { float_to_half(uv.x), float_to_half(uv.y) }); break;
+                        case UvFormat::UNORM16: put(std::array { float_to_unorm16(uv.x), float_to_unorm16(uv.y) }); break;
+                    }
+                }
+
+                if constexpr ((A & ATTRIB_NORMAL) != 0) {
+                    if (format.m_normal == NormalFormat::FLOAT) {
+                        put(vertex.m_normal);
+                    } else {
+                        glm::vec2 e = octahedral_encode(vertex.m_normal);
+                        put(std::array { float_to_snorm16(e.x), float_to_snorm16(e.y) });
+                    }
+                }
+
+                if constexpr ((A & ATTRIB_TANGENT) != 0) {
+                    if (format.m_normal == NormalFormat::FLOAT) {
+                        put(vertex.m_tangent);
+                    } else {
+                        glm::vec2 e = octahedral_encode(glm::vec3(vertex.m_tangent));
+                        put(std::array { float_to_snorm16(e.x), float_to_snorm16(e.y), float_to_snorm16(vertex.m_tangent.w), int16_t(0) });
+                    }
+                }
+
+                if constexpr ((A & ATTRIB_COLOR) != 0) {
+                    if (format.m_color == ColorFormat::FLOAT) {
+                        put(vertex.m_color);
+                    } else {
+                        auto &c = vertex.m_color;
+                        put(std::array { float_to_unorm8(c.x), float_to_unorm8(c.y), float_to_unorm8(c.z), uint8_t(0) });
+                    }
+                }
+            }
+        }, 1 << 14);
+    });
+
+    return out;
+}
@@ -7,48 +7,222 @@
 #include "vertex.hh"
 #include "vertexarray.hh"
 #include "vertexbuffer.hh"
+#include "indexbuffer.hh"
+#include "mesh.hh"
+#include "quantize.hh"
+#include "lod.hh"
+#include "meshlet.hh"
 #include "shader.hh"
 #include "texture.hh"
+#include "material.hh"
 #include "camera.hh"
 #include "main.hh"
 
 class Renderer {
-    std::span<const Vertex> m_vertices;
     Shader m_shader { "shader.vert",  "shader.frag" };
     VertexArray m_vao;
-    VertexBuffer m_vbo { m_vertices };
+    VertexBuffer m_vbo;
+    IndexBuffer m_ibo;
+
+    // contiguous indices of one material, drawn with a single call
+    struct DrawRange {
+        uint32_t m_material;
+        uint32_t m_first;
+        uint32_t m_count;
+    };
+
+    // as in MeshView, for each level of detail, 0 is the full mesh
+    std::vector<Meshlet> m_meshlets;
+    std::vector<uint32_t> m_meshlet_levels;
+    std::vector<float> m_lod_errors;
+    BoundingSphere m_bounds;
+
+    // rebuilt every frame from the meshlets that survive culling
+    std::vector<uint8_t> m_visible;
+    std::vector<DrawRange> m_draws;
+    CullStats m_cull_stats;
+
+    // a level is good enough once its error covers at most this many pixels
+    static constexpr float LOD_PIXEL_ERROR = 1.0f;
 
 public:
-    Renderer(std::span<const Vertex> vertices) : m_vertices(vertices)
+    // The vertices are converted to format on upload, the mesh keeps floats.
+    // Draws the meshlets of the mesh, see build_meshlets().
+    Renderer(MeshView mesh, VertexFormat format = VERTEX_FORMAT_FLOAT)
+        : Renderer(mesh, quantize_vertices(mesh, format))
+    { }
+
+    // materials are indexed by Submesh::m_material
+    void render(std::span<const LoadedMaterial> materials, State& state, glm::vec3 pos) {
+
+        auto mvp = state.model_view_projection(pos);
+        m_shader.set_uniform("u_mvp", mvp);
+
+        m_shader.use();
+        m_vao.bind();
+
+        // the model is only translated, this is the camera in model space
+        size_t lod = select_lod(state, pos);
+        auto meshlets = std::span(m_meshlets).subspan(m_meshlet_levels[lod], m_meshlet_levels[lod + 1] - m_meshlet_levels[lod]);
+        m_visible.resize(meshlets.size());
+        m_cull_stats = cull_meshlets(meshlets, mvp, state.cam.position() - pos, state.backface_culling, m_visible);
+
+        make_draws(meshlets);
+
+        // only while it draws, the meshlets it dropped relied on it
+        if (state.backface_culling)
+            glEnable(GL_CULL_FACE);
+
+        size_t index_size = m_ibo.type() == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+
+        for (auto &draw : m_draws) {
+            if (draw.m_material < materials.size())
+                bind_material(materials[draw.m_material]);
+
+            auto offset = reinterpret_cast<void*>(draw.m_first * index_size);
+            glDrawElements(GL_TRIANGLES, draw.m_count, m_ibo.type(), offset);
+        }
+
+        glDisable(GL_CULL_FACE);
+    }
+
+    // of the last frame
+    [[nodiscard]] const CullStats &cull_stats() const {
+        return m_cull_stats;
+    }
+
+private:
+    Renderer(MeshView mesh, const QuantizedVertices &vertices)
+        : m_vao(vertices.stride())
+        , m_vbo(vertices.m_data)
+        , m_ibo(all_indices(mesh), mesh.vertex_count())
+        , m_meshlets(mesh.m_meshlets.begin(), mesh.m_meshlets.end())
+        , m_meshlet_levels(mesh.m_meshlet_levels.begin(), mesh.m_meshlet_levels.end())
+        , m_bounds(bounding_sphere(mesh))
     {
+        // the element buffer binding is part of the vertex array state
+        m_vao.bind();
+        m_ibo.bind();
+
         m_shader.use();
         m_shader.set_uniform("tex", 0);
+        m_shader.set_uniform("tex_specular", 1);
+        m_shader.set_uniform("tex_normal", 2);
+        m_shader.set_uniform("tex_alpha", 3);
+
+        m_shader.set_uniform("u_pos_offset", vertices.m_pos_offset);
+        m_shader.set_uniform("u_pos_scale", vertices.m_pos_scale);
+        m_shader.set_uniform("u_uv_offset", vertices.m_uv_offset);
+        m_shader.set_uniform("u_uv_scale", vertices.m_uv_scale);
+        m_shader.set_uniform("u_oct_normal", vertices.m_format.m_normal == NormalFormat::OCTAHEDRAL);
+        m_shader.set_uniform("u_has_normal", (mesh.m_attribs & ATTRIB_NORMAL) != 0);
+        m_shader.set_uniform("u_has_tangent", (mesh.m_attribs & ATTRIB_TANGENT) != 0);
+        m_shader.set_uniform("u_has_color", (mesh.m_attribs & ATTRIB_COLOR) != 0);
+
+        add_attribs(vertices.m_format, mesh.m_attribs);
+
+        for (auto &lod : mesh.m_lods)
+            m_lod_errors.push_back(lod.m_error);
+    }
+
+    // those of the full mesh followed by those of the levels, as the
+    // meshlets count them
+    [[nodiscard]] static std::vector<uint32_t> all_indices(MeshView mesh) {
+        std::vector<uint32_t> indices;
+        indices.reserve(mesh.m_indices.size() + mesh.m_lod_indices.size());
+        indices.insert(indices.end(), mesh.m_indices.begin(), mesh.m_indices.end());
+        indices.insert(indices.end(), mesh.m_lod_indices.begin(), mesh.m_lod_indices.end());
+        return indices;
+    }
 
-        GLuint pos = m_shader.get_attrib_loc("a_pos");
-        GLuint uv  = m_shader.get_attrib_loc("a_uv");
+    // Visible meshlets that follow each other in the index buffer merge into
+    // one draw, they are in submesh order and so grouped by material.
+    void make_draws(std::span<const Meshlet> meshlets) {
+        m_draws.clear();
 
-        m_vao.add<float>(pos, 3);
-        m_vao.add<float>(uv, 2);
+        for (size_t i = 0; i < meshlets.size(); ++i) {
+            if (!m_visible[i])
+                continue;
+
+            auto &meshlet = meshlets[i];
+            auto *last = m_draws.empty() ? nullptr : &m_draws.back();
+
+            if (last && last->m_material == meshlet.m_material && last->m_first + last->m_count == meshlet.m_first)
+                last->m_count += meshlet.m_count;
+            else
+                m_draws.push_back({ meshlet.m_material, meshlet.m_first, meshlet.m_count });
+        }
     }
 
-    void render(Texture& texture, State& state, glm::vec3 pos) {
+    // The simplest level whose error, projected at the distance of the
+    // nearest point of the bounds, stays below LOD_PIXEL_ERROR.
+    [[nodiscard]] size_t select_lod(const State &state, glm::vec3 pos) const {
+        float distance = glm::length(state.cam.position() - (pos + m_bounds.m_center)) - m_bounds.m_radius;
+        if (distance <= 0.0f)
+            return 0;
 
-        auto view = state.cam.get_view_matrix();
+        float pixels_per_unit = state.viewport.y / (2.0f * std::tan(glm::radians(state.fov_deg) * 0.5f) * distance);
 
-        float aspect_ratio = static_cast<float>(WIDTH) / HEIGHT;
-        auto proj = glm::perspective(glm::radians(state.fov_deg), aspect_ratio, 0.1f, 100.0f);
+        size_t lod = 0;
+        while (lod < m_lod_errors.size() && m_lod_errors[lod] * pixels_per_unit <= LOD_PIXEL_ERROR)
+            lod++;
 
-        glm::mat4 model(1.0f);
-        model = glm::translate(model, pos);
+        return lod;
+    }
 
-        auto u_mvp = proj * view * model;
-        m_shader.set_uniform("u_mvp", u_mvp);
+    // same order as in PackedVertex, attributes the mesh lacks read as 0
+    void add_attribs(VertexFormat format, unsigned attribs) {
+        GLuint pos    = m_shader.get_attrib_loc("a_pos");
+        GLuint uv     = m_shader.get_attrib_loc("a_uv");
+        GLuint normal = m_shader.get_attrib_loc("a_normal");
+        GLuint tangent = m_shader.get_attrib_loc("a_tangent");
+        GLuint color = m_shader.get_attrib_loc("a_color");
+
+        switch (format.m_position) {
+            case PositionFormat::FLOAT:   m_vao.add<float>(pos, 3); break;
+            case PositionFormat::HALF:    m_vao.add<Half>(pos, 3).skip(sizeof(Half)); break;
+            case PositionFormat::UNORM16: m_vao.add<Normalized<GLushort>>(pos, 3).skip(sizeof(GLushort)); break;
+        }
+
+        if (attribs & ATTRIB_UV) {
+            switch (format.m_uv) {
+                case UvFormat::FLOAT:   m_vao.add<float>(uv, 2); break;
+                case UvFormat::HALF:    m_vao.add<Half>(uv, 2); break;
+                case UvFormat::UNORM16: m_vao.add<Normalized<GLushort>>(uv, 2); break;
+            }
+        }
+
+        if (attribs & ATTRIB_NORMAL) {
+            switch (format.m_normal) {
+                case NormalFormat::FLOAT:      m_vao.add<float>(normal, 3); break;
+                case NormalFormat::OCTAHEDRAL: m_vao.add<Normalized<GLshort>>(normal, 2); break;
+            }
+        }
+
+        if (attribs & ATTRIB_TANGENT) {
+            switch (format.m_normal) {
+                case NormalFormat::FLOAT:      m_vao.add<float>(tangent, 4); break;
+                case NormalFormat::OCTAHEDRAL: m_vao.add<Normalized<GLshort>>(tangent, 3).skip(sizeof(GLshort)); break;
+            }
+        }
+
+        if (attribs & ATTRIB_COLOR) {
+            switch (format.m_color) {
+                case ColorFormat::FLOAT:  m_vao.add<float>(color, 3); break;
+                case ColorFormat::UNORM8: m_vao.add<Normalized<GLubyte>>(color, 3).skip(sizeof(GLubyte)); break;
+            }
+        }
+    }
 
-        texture.bind();
-        m_shader.use();
-        m_vao.bind();
+    void bind_material(const LoadedMaterial &material) {
+        material.m_diffuse_map->bind(GL_TEXTURE0);
+        material.m_specular_map->bind(GL_TEXTURE1);
+        material.m_normal_map->bind(GL_TEXTURE2);
+        material.m_alpha_map->bind(GL_TEXTURE3);
 
-        glDrawArrays(GL_TRIANGLES, 0, m_vertices.size());
+        m_shader.set_uniform("u_diffuse", material.m_material.m_diffuse);
+        m_shader.set_uniform("u_opacity", material.m_material.m_opacity);
+        m_shader.set_uniform("u_normal_map", !material.m_material.m_normal_map.empty());
     }
 
 };
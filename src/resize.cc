@@ -0,0 +1,66 @@
+#include <atomic>
+
+#include "stb_image_resize2.h"
+
+#include "resize.hh"
+#include "parallel.hh"
+
+
+
+namespace {
+
+// below this many output pixels, building samplers for every thread costs
+// more than it saves
+constexpr size_t SPLIT_MIN_PIXELS = 256 * 256;
+
+[[nodiscard]] stbir_pixel_layout pixel_layout(int channels, bool premultiplied) {
+    switch (channels) {
+        case 1: return STBIR_1CHANNEL;
+        case 2: return STBIR_2CHANNEL;
+        case 3: return STBIR_RGB;
+    }
+    return premultiplied ? STBIR_RGBA_PM : STBIR_RGBA;
+}
+
+} // namespace
+
+[[nodiscard]] bool resize_image(
+    const uint8_t *pixels,
+    int width,
+    int height,
+    int channels,
+    uint8_t *out,
+    int out_width,
+    int out_height,
+    const ResizeOptions &options
+) {
+    if (channels < 1 || channels > 4)
+        return false;
+
+    STBIR_RESIZE resize;
+    stbir_resize_init(
+        &resize,
+        pixels, width, height, 0,
+        out, out_width, out_height, 0,
+        pixel_layout(channels, options.m_premultiplied),
+        options.m_srgb ? STBIR_TYPE_UINT8_SRGB : STBIR_TYPE_UINT8
+    );
+
+    size_t out_pixels = size_t(out_width) * out_height;
+    int threads = out_pixels < SPLIT_MIN_PIXELS ? 1 : static_cast<int>(thread_count());
+
+    // each split is a band of output rows, it may make fewer than asked for
+    int splits = stbir_build_samplers_with_splits(&resize, threads);
+    if (splits == 0)
+        return false;
+
+    std::atomic<bool> ok = true;
+
+    parallel_for(splits, [&](size_t begin, size_t end) {
+        if (!stbir_resize_extended_split(&resize, begin, end - begin))
+            ok = false;
+    }, 1, splits);
+
+    stbir_free_samplers(&resize);
+    return ok;
+}
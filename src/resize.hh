@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+
+
+struct ResizeOptions {
+    // filter every channel but alpha in linear light, like MipOptions
+    bool m_srgb = false;
+    // the colors of four channel images are already multiplied by alpha,
+    // otherwise they are weighted by it while they are filtered
+    bool m_premultiplied = false;
+
+    bool operator==(const ResizeOptions&) const = default;
+};
+
+// Resizes pixels with 1 to 4 channels of 8 bits into out, which has to hold
+// out_width * out_height of them, with stb_image_resize2's default filters.
+// Four channels are rgba, the others are filtered independently. Large
+// images are split between threads. Returns false if stb_image_resize2
+// fails.
+[[nodiscard]] bool resize_image(
+    const uint8_t *pixels,
+    int width,
+    int height,
+    int channels,
+    uint8_t *out,
+    int out_width,
+    int out_height,
+    const ResizeOptions &options = { }
+);
@@ -37,6 +37,11 @@ Shader &Shader::set_uniform(const char *name, float value) {
     return *this;
 }
 
+Shader &Shader::set_uniform(const char *name, glm::vec2 value) {
+    glUniform2f(glGetUniformLocation(m_id, name), value.x, value.y);
+    return *this;
+}
+
 Shader &Shader::set_uniform(const char *name, glm::vec3 value) {
     glUniform3f(glGetUniformLocation(m_id, name), value.x, value.y, value.z);
     return *this;
@@ -1,11 +1,50 @@
 #version 330 core
 
 in vec2 uv;
+in vec3 normal;
+in vec4 tangent;
+in vec3 color;
 
 out vec4 fragment;
 uniform sampler2D tex;
+uniform sampler2D tex_normal;
+uniform sampler2D tex_alpha;
+uniform vec3 u_diffuse;
+uniform float u_opacity;
+
+// what the mesh and the material have, unlit without normals
+uniform bool u_has_normal;
+uniform bool u_has_tangent;
+uniform bool u_has_color;
+uniform bool u_normal_map;
+
+// in model space, models are only ever translated
+const vec3 LIGHT = normalize(vec3(0.3f, 1.0f, 0.6f));
+const float AMBIENT = 0.3f;
 
 void main() {
     // fragment = vec4(color, 1.0f);
-    fragment = texture(tex, uv);
+    fragment = texture(tex, uv) * vec4(u_diffuse, u_opacity);
+    fragment.a *= texture(tex_alpha, uv).r;
+
+    if (!u_has_normal)
+        return;
+
+    vec3 n = normalize(normal);
+
+    // the bitangent is rebuilt per pixel and the frame left unnormalized,
+    // as MikkTSpace expects
+    if (u_has_tangent && u_normal_map) {
+        vec3 bitangent = tangent.w * cross(normal, tangent.xyz);
+        // BC5 normal maps only store x and y, z is rebuilt for every kind
+        // of normal map so they all look the same
+        vec2 xy = texture(tex_normal, uv).xy * 2.0f - 1.0f;
+        vec3 mapped = vec3(xy, sqrt(max(1.0f - dot(xy, xy), 0.0f)));
+        n = normalize(mapped.x * tangent.xyz + mapped.y * bitangent + mapped.z * normal);
+    }
+
+    // the vertex color holds the baked ambient occlusion, which only
+    // darkens light that comes from everywhere
+    vec3 ambient = AMBIENT * (u_has_color ? color : vec3(1.0f));
+    fragment.rgb *= ambient + (1.0f - AMBIENT) * max(dot(n, LIGHT), 0.0f);
 }
@@ -26,6 +26,7 @@ public:
     [[nodiscard]] GLuint get_attrib_loc(const char *name) const;
     Shader &set_uniform(const char *name, int value);
     Shader &set_uniform(const char *name, float value);
+    Shader &set_uniform(const char *name, glm::vec2 value);
     Shader &set_uniform(const char *name, glm::vec3 value);
     Shader &set_uniform(const char *name, glm::mat4 value);
 
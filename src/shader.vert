@@ -2,13 +2,39 @@
 
 in vec3 a_pos;
 in vec2 a_uv;
+in vec3 a_normal;
+in vec4 a_tangent;
+in vec3 a_color;
 
 out vec2 uv;
+out vec3 normal;
+out vec4 tangent;
+out vec3 color;
 
 uniform mat4 u_mvp;
 
+// quantized attributes come back as offset + stored * scale
+uniform vec3 u_pos_offset;
+uniform vec3 u_pos_scale;
+uniform vec2 u_uv_offset;
+uniform vec2 u_uv_scale;
+
+// a_normal.xy and a_tangent.xy are points on the unfolded octahedron, the
+// sign of the bitangent follows in a_tangent.z
+uniform bool u_oct_normal;
+
+vec3 octahedral_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (n.z < 0.0f)
+        n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+    return normalize(n);
+}
+
 void main() {
-    gl_Position = u_mvp * vec4(a_pos, 1.0f);
+    gl_Position = u_mvp * vec4(u_pos_offset + a_pos * u_pos_scale, 1.0f);
 
-    uv = a_uv;
+    uv = u_uv_offset + a_uv * u_uv_scale;
+    normal = u_oct_normal ? octahedral_decode(a_normal.xy) : a_normal;
+    tangent = u_oct_normal ? vec4(octahedral_decode(a_tangent.xy), a_tangent.z) : a_tangent;
+    color = a_color;
 }
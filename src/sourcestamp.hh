@@ -0,0 +1,63 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+#include <sys/stat.h>
+
+#include "mappedfile.hh"
+
+
+
+// What a cache file remembers about the file it was built from, to notice
+// when it is out of date.
+struct SourceStamp {
+    uint64_t m_size;
+    int64_t m_mtime;
+};
+
+[[nodiscard]] inline std::optional<SourceStamp> stamp_source(const char *source) {
+    struct stat st;
+    if (stat(source, &st) != 0)
+        return { };
+
+    return SourceStamp {
+        static_cast<uint64_t>(st.st_size),
+        st.st_mtim.tv_sec * 1'000'000'000ll + st.st_mtim.tv_nsec,
+    };
+}
+
+// Not cryptographic, only needs to notice that a file changed. Four
+// independent lanes keep the multiplies from serializing on large files.
+[[nodiscard]] inline uint64_t hash_bytes(std::string_view data) {
+    constexpr uint64_t prime = 0x9e3779b97f4a7c15ull;
+    uint64_t lanes[4] = { prime, prime * 3, prime * 5, prime * 7 };
+
+    size_t i = 0;
+    for (; i + 32 <= data.size(); i += 32) {
+        for (size_t l = 0; l < 4; ++l) {
+            uint64_t word;
+            memcpy(&word, data.data() + i + l * 8, sizeof(word));
+            lanes[l] = std::rotl(lanes[l] ^ (word * prime), 31) * 0xc2b2ae3d27d4eb4full;
+        }
+    }
+
+    uint64_t h = data.size() * prime;
+    for (uint64_t lane : lanes)
+        h = std::rotl(h ^ lane, 27) * prime;
+
+    for (; i < data.size(); ++i)
+        h = (h ^ static_cast<uint8_t>(data[i])) * 0x100000001b3ull;
+
+    return h ^ (h >> 33);
+}
+
+[[nodiscard]] inline std::optional<uint64_t> hash_source(const char *source) {
+    auto file = MappedFile::try_open(source);
+    if (!file)
+        return { };
+    return hash_bytes(file->view());
+}
@@ -0,0 +1,56 @@
+#include "streamkernels.hh"
+#include "streamkernels_impl.hh"
+
+
+
+namespace {
+
+void points(const float *matrix, const float *const in[3], float *const out[3], size_t count) {
+    scalar_points(matrix, in, out, 0, count);
+}
+
+void directions(const float *matrix, const float *const in[3], float *const out[3], size_t count) {
+    scalar_directions(matrix, in, out, 0, count);
+}
+
+void bounds(const float *const in[3], size_t count, float min[3], float max[3]) {
+    scalar_bounds(in, 0, count, min, max);
+}
+
+} // namespace
+
+const StreamKernels STREAM_KERNELS_SCALAR {
+    "scalar",
+    points,
+    directions,
+    bounds,
+};
+
+[[nodiscard]] std::span<const StreamKernels *const> stream_supported_kernels() {
+
+    struct Supported {
+        const StreamKernels *m_kernels[3];
+        size_t m_count = 0;
+    };
+
+    static const Supported supported = [] {
+        Supported s;
+        __builtin_cpu_init();
+
+        s.m_kernels[s.m_count++] = &STREAM_KERNELS_SCALAR;
+
+        // part of x86-64, always there
+        s.m_kernels[s.m_count++] = &STREAM_KERNELS_SSE;
+
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            s.m_kernels[s.m_count++] = &STREAM_KERNELS_AVX2;
+
+        return s;
+    }();
+
+    return { supported.m_kernels, supported.m_count };
+}
+
+[[nodiscard]] const StreamKernels &stream_kernels() {
+    return *stream_supported_kernels().back();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+
+
+// Batch kernels over vertex attributes stored as one array per coordinate.
+// Matrices are 16 floats in column major order, as glm stores them. Output
+// arrays may be the input arrays, but must not overlap them otherwise.
+//
+// The vector kernels fuse multiplies and adds where the cpu can, so results
+// agree with the scalar ones to within rounding, not bit for bit.
+struct StreamKernels {
+    const char *m_name;
+    // out = matrix * (in, 1)
+    void (*m_points)(const float *matrix, const float *const in[3], float *const out[3], size_t count);
+    // out = normalize(upper 3x3 of matrix * in), zero vectors stay zero
+    void (*m_directions)(const float *matrix, const float *const in[3], float *const out[3], size_t count);
+    // min and max of each coordinate, left as they are if count is 0
+    void (*m_bounds)(const float *const in[3], size_t count, float min[3], float max[3]);
+};
+
+extern const StreamKernels STREAM_KERNELS_SCALAR;
+extern const StreamKernels STREAM_KERNELS_SSE;
+extern const StreamKernels STREAM_KERNELS_AVX2;
+
+// the fastest kernels the cpu supports, picked once at runtime
+[[nodiscard]] const StreamKernels &stream_kernels();
+
+// every kernel set the cpu supports, slowest first
+[[nodiscard]] std::span<const StreamKernels *const> stream_supported_kernels();
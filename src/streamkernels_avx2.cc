@@ -0,0 +1,104 @@
+// compiled with -mavx2 -mfma, only called if the cpu supports it
+#include <immintrin.h>
+
+#include "streamkernels.hh"
+#include "streamkernels_impl.hh"
+
+
+
+namespace {
+
+struct Matrix {
+    __m256 m[12];
+
+    explicit Matrix(const float *matrix) {
+        for (int col = 0; col < 4; ++col)
+            for (int row = 0; row < 3; ++row)
+                m[col * 3 + row] = _mm256_set1_ps(matrix[col * 4 + row]);
+    }
+
+    // row of the upper 3x3 times x, y, z, plus add
+    [[nodiscard]] __m256 dot(int row, __m256 x, __m256 y, __m256 z, __m256 add) const {
+        return _mm256_fmadd_ps(m[row], x, _mm256_fmadd_ps(m[3 + row], y, _mm256_fmadd_ps(m[6 + row], z, add)));
+    }
+};
+
+void avx2_points(const float *matrix, const float *const in[3], float *const out[3], size_t count) {
+    Matrix m(matrix);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(in[0] + i);
+        __m256 y = _mm256_loadu_ps(in[1] + i);
+        __m256 z = _mm256_loadu_ps(in[2] + i);
+
+        for (int row = 0; row < 3; ++row)
+            _mm256_storeu_ps(out[row] + i, m.dot(row, x, y, z, m.m[9 + row]));
+    }
+
+    scalar_points(matrix, in, out, i, count);
+}
+
+void avx2_directions(const float *matrix, const float *const in[3], float *const out[3], size_t count) {
+    Matrix m(matrix);
+    __m256 zero = _mm256_setzero_ps();
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(in[0] + i);
+        __m256 y = _mm256_loadu_ps(in[1] + i);
+        __m256 z = _mm256_loadu_ps(in[2] + i);
+
+        __m256 tx = m.dot(0, x, y, z, zero);
+        __m256 ty = m.dot(1, x, y, z, zero);
+        __m256 tz = m.dot(2, x, y, z, zero);
+
+        // exact square root and division, rsqrt would differ from scalar
+        __m256 length2 = _mm256_fmadd_ps(tx, tx, _mm256_fmadd_ps(ty, ty, _mm256_mul_ps(tz, tz)));
+        __m256 inverse = _mm256_and_ps(
+            _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(length2)),
+            _mm256_cmp_ps(length2, zero, _CMP_GT_OQ)
+        );
+
+        _mm256_storeu_ps(out[0] + i, _mm256_mul_ps(tx, inverse));
+        _mm256_storeu_ps(out[1] + i, _mm256_mul_ps(ty, inverse));
+        _mm256_storeu_ps(out[2] + i, _mm256_mul_ps(tz, inverse));
+    }
+
+    scalar_directions(matrix, in, out, i, count);
+}
+
+void avx2_bounds(const float *const in[3], size_t count, float min[3], float max[3]) {
+    size_t vector_end = count / 8 * 8;
+
+    for (int k = 0; k < 3; ++k) {
+        __m256 lo = _mm256_set1_ps(min[k]);
+        __m256 hi = _mm256_set1_ps(max[k]);
+
+        for (size_t i = 0; i < vector_end; i += 8) {
+            __m256 v = _mm256_loadu_ps(in[k] + i);
+            lo = _mm256_min_ps(lo, v);
+            hi = _mm256_max_ps(hi, v);
+        }
+
+        alignas(32) float lanes[2][8];
+        _mm256_store_ps(lanes[0], lo);
+        _mm256_store_ps(lanes[1], hi);
+
+        for (int lane = 0; lane < 8; ++lane) {
+            min[k] = lanes[0][lane] < min[k] ? lanes[0][lane] : min[k];
+            max[k] = lanes[1][lane] > max[k] ? lanes[1][lane] : max[k];
+        }
+    }
+
+    scalar_bounds(in, vector_end, count, min, max);
+}
+
+} // namespace
+
+const StreamKernels STREAM_KERNELS_AVX2 {
+    "avx2",
+    avx2_points,
+    avx2_directions,
+    avx2_bounds,
+};
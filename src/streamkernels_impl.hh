@@ -0,0 +1,49 @@
+#pragma once
+
+// Scalar kernels of streamkernels.hh, and the loop tails of the vector ones.
+// Included by one translation unit per instruction set, so everything in
+// here has internal linkage and only uses plain C headers, like
+// objfast_impl.hh.
+
+#include <math.h>
+#include <stddef.h>
+
+#include "streamkernels.hh"
+
+namespace {
+
+inline void scalar_points(const float *m, const float *const in[3], float *const out[3], size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        float x = in[0][i], y = in[1][i], z = in[2][i];
+        out[0][i] = m[0] * x + m[4] * y + m[8]  * z + m[12];
+        out[1][i] = m[1] * x + m[5] * y + m[9]  * z + m[13];
+        out[2][i] = m[2] * x + m[6] * y + m[10] * z + m[14];
+    }
+}
+
+inline void scalar_directions(const float *m, const float *const in[3], float *const out[3], size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+        float x = in[0][i], y = in[1][i], z = in[2][i];
+        float tx = m[0] * x + m[4] * y + m[8]  * z;
+        float ty = m[1] * x + m[5] * y + m[9]  * z;
+        float tz = m[2] * x + m[6] * y + m[10] * z;
+
+        float length2 = tx * tx + ty * ty + tz * tz;
+        float inverse = length2 > 0.0f ? 1.0f / sqrtf(length2) : 0.0f;
+
+        out[0][i] = tx * inverse;
+        out[1][i] = ty * inverse;
+        out[2][i] = tz * inverse;
+    }
+}
+
+inline void scalar_bounds(const float *const in[3], size_t begin, size_t end, float min[3], float max[3]) {
+    for (int k = 0; k < 3; ++k) {
+        for (size_t i = begin; i < end; ++i) {
+            min[k] = in[k][i] < min[k] ? in[k][i] : min[k];
+            max[k] = in[k][i] > max[k] ? in[k][i] : max[k];
+        }
+    }
+}
+
+} // namespace
@@ -0,0 +1,103 @@
+// SSE2 is part of x86-64, so this needs no extra compiler flags
+#include <immintrin.h>
+
+#include "streamkernels.hh"
+#include "streamkernels_impl.hh"
+
+
+
+namespace {
+
+struct Matrix {
+    __m128 m[12];
+
+    explicit Matrix(const float *matrix) {
+        for (int col = 0; col < 4; ++col)
+            for (int row = 0; row < 3; ++row)
+                m[col * 3 + row] = _mm_set1_ps(matrix[col * 4 + row]);
+    }
+
+    // row of the upper 3x3 times x, y, z
+    [[nodiscard]] __m128 dot(int row, __m128 x, __m128 y, __m128 z) const {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[row], x), _mm_mul_ps(m[3 + row], y)), _mm_mul_ps(m[6 + row], z));
+    }
+};
+
+void sse_points(const float *matrix, const float *const in[3], float *const out[3], size_t count) {
+    Matrix m(matrix);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(in[0] + i);
+        __m128 y = _mm_loadu_ps(in[1] + i);
+        __m128 z = _mm_loadu_ps(in[2] + i);
+
+        for (int row = 0; row < 3; ++row)
+            _mm_storeu_ps(out[row] + i, _mm_add_ps(m.dot(row, x, y, z), m.m[9 + row]));
+    }
+
+    scalar_points(matrix, in, out, i, count);
+}
+
+void sse_directions(const float *matrix, const float *const in[3], float *const out[3], size_t count) {
+    Matrix m(matrix);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(in[0] + i);
+        __m128 y = _mm_loadu_ps(in[1] + i);
+        __m128 z = _mm_loadu_ps(in[2] + i);
+
+        __m128 tx = m.dot(0, x, y, z);
+        __m128 ty = m.dot(1, x, y, z);
+        __m128 tz = m.dot(2, x, y, z);
+
+        // exact square root and division, rsqrt would differ from scalar
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz));
+        __m128 inverse = _mm_and_ps(
+            _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length2)),
+            _mm_cmpgt_ps(length2, _mm_setzero_ps())
+        );
+
+        _mm_storeu_ps(out[0] + i, _mm_mul_ps(tx, inverse));
+        _mm_storeu_ps(out[1] + i, _mm_mul_ps(ty, inverse));
+        _mm_storeu_ps(out[2] + i, _mm_mul_ps(tz, inverse));
+    }
+
+    scalar_directions(matrix, in, out, i, count);
+}
+
+void sse_bounds(const float *const in[3], size_t count, float min[3], float max[3]) {
+    size_t vector_end = count / 4 * 4;
+
+    for (int k = 0; k < 3; ++k) {
+        __m128 lo = _mm_set1_ps(min[k]);
+        __m128 hi = _mm_set1_ps(max[k]);
+
+        for (size_t i = 0; i < vector_end; i += 4) {
+            __m128 v = _mm_loadu_ps(in[k] + i);
+            lo = _mm_min_ps(lo, v);
+            hi = _mm_max_ps(hi, v);
+        }
+
+        alignas(16) float lanes[2][4];
+        _mm_store_ps(lanes[0], lo);
+        _mm_store_ps(lanes[1], hi);
+
+        for (int lane = 0; lane < 4; ++lane) {
+            min[k] = lanes[0][lane] < min[k] ? lanes[0][lane] : min[k];
+            max[k] = lanes[1][lane] > max[k] ? lanes[1][lane] : max[k];
+        }
+    }
+
+    scalar_bounds(in, vector_end, count, min, max);
+}
+
+} // namespace
+
+const StreamKernels STREAM_KERNELS_SSE {
+    "sse",
+    sse_points,
+    sse_directions,
+    sse_bounds,
+};
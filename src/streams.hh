@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "mesh.hh"
+#include "parallel.hh"
+#include "streamkernels.hh"
+
+
+
+// Vertex attributes of a mesh with one array per coordinate, the layout the
+// batch kernels of streamkernels.hh work on. Attributes the mesh lacks are
+// empty.
+struct VertexStreams {
+    std::array<std::vector<float>, 3> m_positions;
+    std::array<std::vector<float>, 3> m_normals;
+    std::array<std::vector<float>, 3> m_tangents;
+    // the sign of the bitangent, w of the tangent
+    std::vector<float> m_signs;
+
+    [[nodiscard]] size_t size() const {
+        return m_positions[0].size();
+    }
+
+    [[nodiscard]] bool has_normals() const {
+        return !m_normals[0].empty();
+    }
+
+    [[nodiscard]] bool has_tangents() const {
+        return !m_tangents[0].empty();
+    }
+
+    void resize(size_t count, bool normals, bool tangents) {
+        for (int k = 0; k < 3; ++k) {
+            m_positions[k].resize(count);
+            m_normals[k].resize(normals ? count : 0);
+            m_tangents[k].resize(tangents ? count : 0);
+        }
+        m_signs.resize(tangents ? count : 0);
+    }
+};
+
+struct BoundingBox {
+    glm::vec3 m_min { INFINITY };
+    glm::vec3 m_max { -INFINITY };
+};
+
+// minimum batch for a thread of its own, smaller meshes run on the caller
+static constexpr size_t STREAM_MIN_BATCH = 1 << 15;
+
+[[nodiscard]] inline VertexStreams load_streams(MeshView mesh) {
+
+    VertexStreams streams;
+    streams.resize(mesh.vertex_count(), mesh.m_attribs & ATTRIB_NORMAL, mesh.m_attribs & ATTRIB_TANGENT);
+
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        auto vertices = mesh.vertices<A>();
+
+        parallel_for(vertices.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                    streams.m_positions[k][i] = vertices[i].m_pos[k];
+                    if constexpr ((A & ATTRIB_NORMAL) != 0)
+                        streams.m_normals[k][i] = vertices[i].m_normal[k];
+                    if constexpr ((A & ATTRIB_TANGENT) != 0)
+                        streams.m_tangents[k][i] = vertices[i].m_tangent[k];
+                }
+
+                if constexpr ((A & ATTRIB_TANGENT) != 0)
+                    streams.m_signs[i] = vertices[i].m_tangent.w;
+            }
+        }, STREAM_MIN_BATCH);
+    });
+
+    return streams;
+}
+
+// Writes the streams back into the vertices of mesh, which has to have as
+// many. Attributes the mesh has but the streams lack are left alone.
+inline void store_streams(const VertexStreams &streams, Mesh &mesh) {
+
+    dispatch_attribs(mesh.m_attribs, [&]<unsigned A>() {
+        auto vertices = mesh.vertices<A>();
+
+        parallel_for(vertices.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                for (int k = 0; k < 3; ++k) {
+                    vertices[i].m_pos[k] = streams.m_positions[k][i];
+                    if constexpr ((A & ATTRIB_NORMAL) != 0)
+                        if (streams.has_normals())
+                            vertices[i].m_normal[k] = streams.m_normals[k][i];
+                    if constexpr ((A & ATTRIB_TANGENT) != 0)
+                        if (streams.has_tangents())
+                            vertices[i].m_tangent[k] = streams.m_tangents[k][i];
+                }
+
+                if constexpr ((A & ATTRIB_TANGENT) != 0)
+                    if (streams.has_tangents())
+                        vertices[i].m_tangent.w = streams.m_signs[i];
+            }
+        }, STREAM_MIN_BATCH);
+    });
+}
+
+// Runs kernel(in, out, count) on ranges of the streams in parallel. out may
+// hold more elements than in, for copies of in one after another.
+template <typename Kernel>
+void for_stream_ranges(
+    const std::array<std::vector<float>, 3> &in,
+    std::array<std::vector<float>, 3> &out,
+    Kernel kernel
+) {
+    size_t count = in[0].size();
+    if (count == 0)
+        return;
+
+    parallel_for(out[0].size(), [&](size_t begin, size_t end) {
+        while (begin < end) {
+            size_t first = begin % count;
+            size_t n = std::min(end - begin, count - first);
+
+            const float *const from[3] = { in[0].data() + first, in[1].data() + first, in[2].data() + first };
+            float *const to[3] = { out[0].data() + begin, out[1].data() + begin, out[2].data() + begin };
+            kernel(begin / count, from, to, n);
+
+            begin += n;
+        }
+    }, STREAM_MIN_BATCH);
+}
+
+// The matrices each attribute is transformed with. Normals need the inverse
+// transpose to stay perpendicular under non-uniform scales, and the
+// bitangent flips with the handedness of the matrix.
+struct StreamTransform {
+    glm::mat4 m_points;
+    glm::mat4 m_normals;
+    float m_sign;
+
+    explicit StreamTransform(const glm::mat4 &matrix)
+        : m_points(matrix)
+        , m_normals(glm::transpose(glm::inverse(matrix)))
+        , m_sign(glm::determinant(matrix) < 0.0f ? -1.0f : 1.0f)
+    { }
+};
+
+// Writes copies of in, one transformed by each matrix, to out one after
+// another. This is what baking a transform and flattening instances into a
+// single mesh both come down to.
+inline void transform_streams(
+    const VertexStreams &in,
+    VertexStreams &out,
+    std::span<const glm::mat4> matrices,
+    const StreamKernels &kernels = stream_kernels()
+) {
+    std::vector<StreamTransform> transforms(matrices.begin(), matrices.end());
+    out.resize(in.size() * matrices.size(), in.has_normals(), in.has_tangents());
+
+    for_stream_ranges(in.m_positions, out.m_positions, [&](size_t copy, auto from, auto to, size_t n) {
+        kernels.m_points(glm::value_ptr(transforms[copy].m_points), from, to, n);
+    });
+
+    if (in.has_normals()) {
+        for_stream_ranges(in.m_normals, out.m_normals, [&](size_t copy, auto from, auto to, size_t n) {
+            kernels.m_directions(glm::value_ptr(transforms[copy].m_normals), from, to, n);
+        });
+    }
+
+    if (in.has_tangents()) {
+        for_stream_ranges(in.m_tangents, out.m_tangents, [&](size_t copy, auto from, auto to, size_t n) {
+            kernels.m_directions(glm::value_ptr(transforms[copy].m_points), from, to, n);
+        });
+
+        for (size_t copy = 0; copy < transforms.size(); ++copy) {
+            auto signs = std::span(out.m_signs).subspan(copy * in.size(), in.size());
+            std::transform(in.m_signs.begin(), in.m_signs.end(), signs.begin(), [&](float sign) {
+                return sign * transforms[copy].m_sign;
+            });
+        }
+    }
+}
+
+inline void transform_streams(VertexStreams &streams, const glm::mat4 &matrix, const StreamKernels &kernels = stream_kernels()) {
+    transform_streams(streams, streams, std::span(&matrix, 1), kernels);
+}
+
+inline void rotate_streams(VertexStreams &streams, float angle, glm::vec3 axis, const StreamKernels &kernels = stream_kernels()) {
+    transform_streams(streams, glm::rotate(glm::mat4(1.0f), angle, axis), kernels);
+}
+
+inline void scale_streams(VertexStreams &streams, glm::vec3 factors, const StreamKernels &kernels = stream_kernels()) {
+    transform_streams(streams, glm::scale(glm::mat4(1.0f), factors), kernels);
+}
+
+[[nodiscard]] inline BoundingBox stream_bounds(const VertexStreams &streams, const StreamKernels &kernels = stream_kernels()) {
+
+    size_t threads = std::clamp<size_t>(streams.size() / STREAM_MIN_BATCH, 1, thread_count());
+    std::vector<BoundingBox> boxes(threads);
+
+    parallel_for(threads, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            size_t first = streams.size() * t / threads;
+            size_t count = streams.size() * (t + 1) / threads - first;
+            auto &p = streams.m_positions;
+
+            const float *const from[3] = { p[0].data() + first, p[1].data() + first, p[2].data() + first };
+            kernels.m_bounds(from, count, &boxes[t].m_min.x, &boxes[t].m_max.x);
+        }
+    });
+
+    BoundingBox box;
+    for (auto &part : boxes) {
+        box.m_min = glm::min(box.m_min, part.m_min);
+        box.m_max = glm::max(box.m_max, part.m_max);
+    }
+
+    return box;
+}
+
+// Applies matrix to the vertices of mesh for good.
+inline void bake_transform(Mesh &mesh, const glm::mat4 &matrix) {
+    auto streams = load_streams(mesh.view());
+    transform_streams(streams, matrix);
+    store_streams(streams, mesh);
+}
+
+// One mesh with a copy of mesh for every matrix, each copy's vertices and
+// indices after those of the copy before. Levels of detail are dropped.
+[[nodiscard]] inline Mesh flatten_instances(MeshView mesh, std::span<const glm::mat4> matrices) {
+
+    VertexStreams copies;
+    transform_streams(load_streams(mesh), copies, matrices);
+
+    Mesh flat;
+    flat.m_attribs = mesh.m_attribs;
+    flat.m_vertices.resize(mesh.m_vertices.size() * matrices.size());
+    flat.m_materials.assign(mesh.m_materials.begin(), mesh.m_materials.end());
+    flat.m_groups.assign(mesh.m_groups.begin(), mesh.m_groups.end());
+    flat.m_material_libs.assign(mesh.m_material_libs.begin(), mesh.m_material_libs.end());
+
+    // uvs and anything else the streams do not cover
+    for (size_t copy = 0; copy < matrices.size(); ++copy)
+        std::copy(mesh.m_vertices.begin(), mesh.m_vertices.end(), flat.m_vertices.begin() + copy * mesh.m_vertices.size());
+
+    store_streams(copies, flat);
+
+    // submeshes stay sorted by material, every copy of one follows the other
+    auto submeshes = mesh.m_submeshes;
+    Submesh whole { 0, 0, 0, static_cast<uint32_t>(mesh.m_indices.size()) };
+    if (submeshes.empty())
+        submeshes = std::span(&whole, 1);
+
+    for (auto &submesh : submeshes) {
+        for (size_t copy = 0; copy < matrices.size(); ++copy) {
+            uint32_t base = copy * mesh.vertex_count();
+            Submesh part = submesh;
+            part.m_first = flat.m_indices.size();
+
+            for (uint32_t index : mesh.m_indices.subspan(submesh.m_first, submesh.m_count))
+                flat.m_indices.push_back(base + index);
+
+            flat.m_submeshes.push_back(part);
+        }
+    }
+
+    if (mesh.m_submeshes.empty())
+        flat.m_submeshes.clear();
+
+    return flat;
+}
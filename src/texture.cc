@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <filesystem>
 #include <memory>
 #include <print>
@@ -5,13 +6,25 @@
 // #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-// #define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include "stb_image_resize2.h"
-
 #include "texture.hh"
 
 
 
+// EXT_texture_compression_s3tc is not core, but every desktop driver has it
+static constexpr GLenum COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+static constexpr GLenum COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3;
+
+[[nodiscard]] static GLenum compressed_format(BlockFormat format) {
+    switch (format) {
+        case BlockFormat::BC1:  return COMPRESSED_RGB_S3TC_DXT1;
+        case BlockFormat::BC3:  return COMPRESSED_RGBA_S3TC_DXT5;
+        case BlockFormat::BC5:  return GL_COMPRESSED_RG_RGTC2;
+        case BlockFormat::BC7:  return GL_COMPRESSED_RGBA_BPTC_UNORM;
+        case BlockFormat::NONE: break;
+    }
+    return 0;
+}
+
 Texture::Texture(
     GLenum unit,
     const char *filename,
@@ -34,9 +47,69 @@ Texture::Texture(
     , m_unit(unit)
 { }
 
+Texture::Texture(GLenum unit, GLenum format, ImageData image)
+    : m_unit(unit)
+{
+    auto [data, width, height] = std::move(image);
+    m_texture = create_texture(format, width, height, std::move(data));
+}
+
 Texture &Texture::bind() {
-    glActiveTexture(m_unit);
+    return bind(m_unit);
+}
+
+Texture &Texture::bind(GLenum unit) {
+    glActiveTexture(unit);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    return *this;
+}
+
+Texture &Texture::upload(GLenum format, ImageData image, std::span<const uint8_t> mips) {
+    auto [data, width, height] = std::move(image);
+    if (data == nullptr)
+        return *this;
+
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    upload_levels(format, width, height, data.get(), mips.empty() ? nullptr : mips.data());
+    return *this;
+}
+
+Texture &Texture::upload(GLenum format, int width, int height, GLuint buffer, size_t offset, bool mips) {
     glBindTexture(GL_TEXTURE_2D, m_texture);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+
+    // with a buffer bound, the pointers are offsets into it
+    const uint8_t *top = reinterpret_cast<const uint8_t*>(offset);
+    upload_levels(format, width, height, top, mips ? top + size_t(width) * height * channel_count(format) : nullptr);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return *this;
+}
+
+Texture &Texture::upload(const CompressedImage &image, GLuint buffer, size_t offset) {
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+
+    // with a buffer bound, the pointer is an offset into it
+    const uint8_t *base = buffer != 0 ? reinterpret_cast<const uint8_t*>(offset) : image.m_data.data();
+
+    for (size_t i = 0; i < image.m_levels.size(); ++i) {
+        auto &level = image.m_levels[i];
+        glCompressedTexImage2D(
+            GL_TEXTURE_2D,
+            i,
+            compressed_format(image.m_format),
+            level.m_width,
+            level.m_height,
+            0,
+            level.m_size,
+            base + level.m_offset
+        );
+    }
+
+    // every level is there already, none are generated
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.m_levels.size() - 1);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
     return *this;
 }
 
@@ -50,6 +123,12 @@ Texture &Texture::bind() {
     glGenTextures(1, &tex);
     glBindTexture(GL_TEXTURE_2D, tex);
 
+    upload_pixels(format, width, height, data.get());
+    return tex;
+}
+
+// into the texture bound to GL_TEXTURE_2D
+void Texture::upload_pixels(GLenum format, int width, int height, const uint8_t *data) {
     glTexImage2D(
         GL_TEXTURE_2D,
         0,
@@ -59,10 +138,34 @@ Texture &Texture::bind() {
         0,
         format,
         GL_UNSIGNED_BYTE,
-        data.get()
+        data
     );
     glGenerateMipmap(GL_TEXTURE_2D);
-    return tex;
+}
+
+// Into the texture bound to GL_TEXTURE_2D, whose storage is allocated once
+// for every level and then only copied into. mips are the levels below the
+// top one as build_mips() lays them out, or generated if it is null.
+void Texture::upload_levels(GLenum format, int width, int height, const uint8_t *data, const uint8_t *mips) {
+    int levels = mip_count(width, height);
+    glTexStorage2D(GL_TEXTURE_2D, levels, sized_format(format), width, height);
+
+    // rows of small levels are not padded to 4 bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    const uint8_t *level_data = data;
+
+    for (int level = 0; level < (mips != nullptr ? levels : 1); ++level) {
+        int w = mip_size(width, level), h = mip_size(height, level);
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, w, h, format, GL_UNSIGNED_BYTE, level_data);
+
+        level_data = level == 0 ? mips : level_data + size_t(w) * h * channel_count(format);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (mips == nullptr)
+        glGenerateMipmap(GL_TEXTURE_2D);
 }
 
 [[nodiscard]] GLuint Texture::load_texture(
@@ -72,28 +175,7 @@ Texture &Texture::bind() {
     int resize_width,
     int resize_height
 ) {
-
-    auto [data, width, height] = load_image(filename, flip_vert);
-
-    uint8_t *newdata = stbir_resize_uint8_linear(
-        data.get(),
-        width,
-        height,
-        0,
-        nullptr,
-        resize_width,
-        resize_height,
-        0,
-        STBIR_RGB
-    );
-
-    if (newdata == nullptr)
-        std::println(stderr, "Failed to resize image: {}", filename);
-
-    width = resize_width;
-    height = resize_height;
-    data.reset(newdata);
-
+    auto [data, width, height] = decode(filename, flip_vert, format, resize_width, resize_height);
     return create_texture(format, width, height, std::move(data));
 }
 
@@ -102,17 +184,44 @@ Texture &Texture::bind() {
     bool flip_vert,
     GLenum format
 ) {
-    auto [data, width, height] = load_image(filename, flip_vert);
+    auto [data, width, height] = decode(filename, flip_vert, format);
     return create_texture(format, width, height, std::move(data));
 }
 
+[[nodiscard]] Texture::ImageData Texture::decode(
+    const char *filename,
+    bool flip_vert,
+    GLenum format,
+    int resize_width,
+    int resize_height,
+    const ResizeOptions &options
+) {
+
+    int channels = channel_count(format);
+    auto [data, width, height] = load_image(filename, flip_vert, channels);
+
+    if (data == nullptr || resize_width == 0 || resize_height == 0)
+        return { std::move(data), width, height };
+
+    // malloc, like stbi, so StbiDeleter frees either
+    StbiData resized(static_cast<uint8_t*>(malloc(size_t(resize_width) * resize_height * channels)));
+
+    if (resized == nullptr || !resize_image(data.get(), width, height, channels, resized.get(), resize_width, resize_height, options)) {
+        std::println(stderr, "Failed to resize image: {}", filename);
+        resized.reset();
+    }
+
+    return { std::move(resized), resize_width, resize_height };
+}
+
 [[nodiscard]] Texture::ImageData
-Texture::load_image(const char *filename, bool flip_vert) {
+Texture::load_image(const char *filename, bool flip_vert, int channels) {
 
-    stbi_set_flip_vertically_on_load(flip_vert);
+    // the flag is per thread, so images can be decoded in parallel
+    stbi_set_flip_vertically_on_load_thread(flip_vert);
 
-    int width, height, nr_channels;
-    uint8_t *data = stbi_load(filename, &width, &height, &nr_channels, 0);
+    int width = 0, height = 0, nr_channels;
+    uint8_t *data = stbi_load(filename, &width, &height, &nr_channels, channels);
     if (data == nullptr)
         std::println(stderr, "Failed to load image: {}", filename);
 
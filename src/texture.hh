@@ -1,11 +1,16 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <span>
+#include <tuple>
 
 #include "stb_image.h"
 
+#include "blockcompress.hh"
+#include "resize.hh"
+
 #include "glad/gl.h"
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -16,24 +21,77 @@
 
 
 
+[[nodiscard]] inline int channel_count(GLenum format) {
+    switch (format) {
+        case GL_RED:  return 1;
+        case GL_RG:   return 2;
+        case GL_RGB:  return 3;
+        case GL_RGBA: return 4;
+    }
+    return 0;
+}
+
+// the internal format immutable storage needs for format
+[[nodiscard]] inline GLenum sized_format(GLenum format) {
+    switch (format) {
+        case GL_RED:  return GL_R8;
+        case GL_RG:   return GL_RG8;
+        case GL_RGB:  return GL_RGB8;
+        case GL_RGBA: return GL_RGBA8;
+    }
+    return 0;
+}
+
 class Texture {
     GLuint m_texture;
     GLenum m_unit;
 
 public:
+    // a named type, a lambda's would differ between translation units
+    struct StbiDeleter {
+        void operator()(uint8_t* data) const { stbi_image_free(data); }
+    };
+    using StbiData = std::unique_ptr<uint8_t, StbiDeleter>;
+    using ImageData = std::tuple<StbiData, int, int>;
+
     // unit: GL_TEXTUREn
     Texture(GLenum unit, char const* filename, bool flip_vert, GLenum format);
     Texture(GLenum unit, char const* filename, bool flip_vert, GLenum format, int resize_width, int resize_height);
+    // uploads pixels from decode()
+    Texture(GLenum unit, GLenum format, ImageData image);
     Texture& bind();
+    Texture& bind(GLenum unit);
 
-private:
-    using StbiDeleter = decltype([](uint8_t* data) { stbi_image_free(data); });
-    using StbiData = std::unique_ptr<uint8_t, StbiDeleter>;
-    using ImageData = std::tuple<StbiData, int, int>;
+    // Replaces what the texture holds with pixels from decode(), for textures
+    // that start out as a placeholder. Ignores images that failed to decode.
+    // mips are the levels below from build_mips(), generated if empty. The
+    // new storage is immutable, so this works once per texture.
+    Texture& upload(GLenum format, ImageData image, std::span<const uint8_t> mips = { });
+    // The same with the pixels at offset in a pixel unpack buffer, which
+    // lets the copy run without the driver holding on to client memory. With
+    // mips, the levels below follow the top one in the buffer.
+    Texture& upload(GLenum format, int width, int height, GLuint buffer, size_t offset, bool mips = false);
+    // Replaces it with every level of a block compressed image, from its
+    // data or, if buffer is not 0, from offset in a pixel unpack buffer
+    // that holds the same bytes.
+    Texture& upload(const CompressedImage &image, GLuint buffer = 0, size_t offset = 0);
+
+    // Decodes into as many channels as format has, and resizes unless the
+    // size is 0. Does not touch OpenGL, so it may run on any thread.
+    [[nodiscard]] static ImageData decode(
+        const char *filename,
+        bool flip_vert,
+        GLenum format,
+        int resize_width = 0,
+        int resize_height = 0,
+        const ResizeOptions &options = { }
+    );
 
+private:
     [[nodiscard]] static ImageData load_image(
         const char *filename,
-        bool flip_vert
+        bool flip_vert,
+        int channels
     );
 
     [[nodiscard]] static GLuint load_texture(
@@ -57,4 +115,19 @@ private:
         StbiData data
     );
 
+    static void upload_pixels(
+        GLenum format,
+        int width,
+        int height,
+        const uint8_t *data
+    );
+
+    static void upload_levels(
+        GLenum format,
+        int width,
+        int height,
+        const uint8_t *data,
+        const uint8_t *mips
+    );
+
 };
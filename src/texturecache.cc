@@ -0,0 +1,204 @@
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <unordered_set>
+#include <vector>
+
+#include "texturecache.hh"
+#include "texturefile.hh"
+#include "parallel.hh"
+
+
+
+[[nodiscard]] static std::shared_ptr<Texture> make_pixel(Placeholder color) {
+    Texture::StbiData pixel(static_cast<uint8_t*>(malloc(color.size())));
+    memcpy(pixel.get(), color.data(), color.size());
+    return std::make_shared<Texture>(GL_TEXTURE0, GL_RGB, Texture::ImageData(std::move(pixel), 1, 1));
+}
+
+// what the cache file of a block compressed texture depends on besides its source
+[[nodiscard]] static std::string cache_variant(const TextureKey &key) {
+    auto &mips = key.m_mips;
+    return std::format(
+        "{} {} {}x{} {} {} {} {}",
+        key.m_flip_vert,
+        key.m_format,
+        key.m_width,
+        key.m_height,
+        static_cast<uint32_t>(key.m_block),
+        mips.m_srgb,
+        mips.m_preserve_coverage,
+        mips.m_alpha_reference
+    );
+}
+
+[[nodiscard]] size_t TextureCache::Decoded::size() const {
+    // the client copies are gone by then, the ring holds all of it
+    if (m_staged)
+        return m_staged->m_bytes.size();
+
+    if (m_compressed.m_format != BlockFormat::NONE)
+        return m_compressed.m_levels.back().m_offset + m_compressed.m_levels.back().m_size;
+
+    auto &[data, width, height] = m_image;
+    return size_t(width) * height * channel_count(m_key.m_format) + m_mips.size();
+}
+
+TextureCache::~TextureCache() {
+    // jobs waiting for ring space give up, so the pool can stop
+    if (m_ring)
+        m_ring->close();
+}
+
+[[nodiscard]] TextureCache::Decoded TextureCache::prepare(const TextureKey &key) {
+    Decoded decoded { key, { }, { }, { }, std::nullopt };
+
+    if (key.m_block != BlockFormat::NONE) {
+        if (auto cached = CachedTexture::load(key.m_path.c_str(), cache_variant(key))) {
+            decoded.m_compressed = std::move(*cached);
+            return decoded;
+        }
+    }
+
+    decoded.m_image = Texture::decode(
+        key.m_path.c_str(),
+        key.m_flip_vert,
+        key.m_format,
+        key.m_width,
+        key.m_height,
+        { .m_srgb = key.m_mips.m_srgb }
+    );
+    auto &[data, width, height] = decoded.m_image;
+
+    if (data == nullptr)
+        return decoded;
+
+    int channels = channel_count(key.m_format);
+
+    if (key.m_block != BlockFormat::NONE) {
+        decoded.m_compressed = compress_image(data.get(), width, height, channels, key.m_block, key.m_mips);
+        CachedTexture::store(key.m_path.c_str(), cache_variant(key), decoded.m_compressed);
+        data.reset();
+    } else {
+        decoded.m_mips.resize(mip_chain_size(width, height, channels));
+        build_mips(data.get(), width, height, channels, decoded.m_mips.data(), key.m_mips);
+    }
+
+    return decoded;
+}
+
+void TextureCache::upload(Decoded &decoded) {
+    auto &[key, image, compressed, mips, staged] = decoded;
+    auto &texture = *m_textures.at(key);
+
+    if (compressed.m_format != BlockFormat::NONE) {
+        if (staged)
+            texture.upload(compressed, m_ring->id(), staged->m_offset);
+        else
+            texture.upload(compressed);
+    } else if (staged) {
+        auto &[data, width, height] = image;
+        texture.upload(key.m_format, width, height, m_ring->id(), staged->m_offset, true);
+    } else {
+        texture.upload(key.m_format, std::move(image), mips);
+    }
+
+    if (staged)
+        m_ring->retire(*staged);
+}
+
+void TextureCache::load(std::span<const TextureKey> keys) {
+
+    std::unordered_set<TextureKey> seen;
+    std::vector<const TextureKey*> missing;
+
+    for (auto &key : keys) {
+        if (!m_textures.contains(key) && seen.insert(key).second)
+            missing.push_back(&key);
+    }
+
+    std::vector<Decoded> prepared(missing.size());
+
+    parallel_for(missing.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            prepared[i] = prepare(*missing[i]);
+    });
+
+    for (auto &decoded : prepared) {
+        m_textures[decoded.m_key] = make_pixel(PLACEHOLDER_WHITE);
+        upload(decoded);
+    }
+}
+
+[[nodiscard]] std::shared_ptr<Texture> TextureCache::load_async(const TextureKey &key, Placeholder placeholder) {
+    if (auto it = m_textures.find(key); it != m_textures.end())
+        return it->second;
+
+    auto texture = make_pixel(placeholder);
+    m_textures.emplace(key, texture);
+    ++m_pending;
+
+    if (!m_ring)
+        m_ring.emplace(RING_SIZE);
+
+    m_pool.submit([this, key] {
+        Decoded decoded = prepare(key);
+
+        // the GL thread then only has to tell the driver where the bytes are
+        auto &[data, width, height] = decoded.m_image;
+        auto &compressed = decoded.m_compressed.m_data;
+        auto &mips = decoded.m_mips;
+        const uint8_t *bytes = compressed.empty() ? data.get() : compressed.data();
+        size_t size = decoded.size();
+
+        // the mips right after the top level, where upload() expects them
+        if (bytes != nullptr && (decoded.m_staged = m_ring->allocate(size))) {
+            auto staged = decoded.m_staged->m_bytes;
+            memcpy(staged.data(), bytes, size - mips.size());
+            memcpy(staged.data() + size - mips.size(), mips.data(), mips.size());
+            data.reset();
+            compressed = { };
+            mips = { };
+        }
+
+        std::lock_guard lock(m_mutex);
+        m_decoded.push_back(std::move(decoded));
+    });
+
+    return texture;
+}
+
+size_t TextureCache::upload_ready(size_t budget) {
+
+    if (m_ring)
+        m_ring->reclaim();
+
+    std::vector<Decoded> ready;
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_decoded.empty())
+            return 0;
+
+        // stops before the first one that would go over, unless it is the
+        // only one, which is uploaded whatever its size
+        size_t count = 0, bytes = 0;
+        while (count < m_decoded.size() && (count == 0 || bytes + m_decoded[count].size() <= budget))
+            bytes += m_decoded[count++].size();
+
+        // the rest stays in order for the next frames
+        ready.assign(std::make_move_iterator(m_decoded.begin()), std::make_move_iterator(m_decoded.begin() + count));
+        m_decoded.erase(m_decoded.begin(), m_decoded.begin() + count);
+    }
+
+    for (auto &decoded : ready)
+        upload(decoded);
+
+    m_pending -= ready.size();
+    return ready.size();
+}
+
+[[nodiscard]] std::shared_ptr<Texture> TextureCache::white() {
+    if (m_white == nullptr)
+        m_white = make_pixel(PLACEHOLDER_WHITE);
+    return m_white;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glad/gl.h"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include "texture.hh"
+#include "blockcompress.hh"
+#include "mips.hh"
+#include "parallel.hh"
+#include "uploadring.hh"
+
+
+
+// Everything that decides what a texture ends up containing. A size of 0
+// keeps the size of the image. Block compressed textures are encoded from
+// the channels of m_format, with their mip chain, and cached on disk.
+struct TextureKey {
+    std::string m_path;
+    bool m_flip_vert = false;
+    GLenum m_format = GL_RGB;
+    int m_width = 0;
+    int m_height = 0;
+    BlockFormat m_block = BlockFormat::NONE;
+    // how the mip chain is filtered, on the CPU for every texture
+    MipOptions m_mips { };
+
+    bool operator==(const TextureKey&) const = default;
+};
+
+template <>
+struct std::hash<TextureKey> {
+    size_t operator()(const TextureKey &key) const {
+        size_t h = std::hash<std::string>()(key.m_path);
+        for (size_t v : { size_t(key.m_flip_vert), size_t(key.m_format), size_t(key.m_width), size_t(key.m_height), size_t(key.m_block),
+                         size_t(key.m_mips.m_srgb), size_t(key.m_mips.m_preserve_coverage),
+                         size_t(std::bit_cast<uint32_t>(key.m_mips.m_alpha_reference)) })
+            h = (h ^ v) * 0x100000001b3ull;
+        return h;
+    }
+};
+
+// The color a texture shows until it is loaded, as 8 bit rgb.
+using Placeholder = std::array<uint8_t, 3>;
+
+static constexpr Placeholder PLACEHOLDER_WHITE { 255, 255, 255 };
+// a normal map that leaves the normal as it is
+static constexpr Placeholder PLACEHOLDER_FLAT_NORMAL { 128, 128, 255 };
+
+// Textures shared by everything that refers to the same file with the same
+// parameters, so each one is decoded and uploaded only once. Textures are
+// bound to an explicit unit, the unit they were created with is unused.
+class TextureCache {
+    // An image ready to upload, either decoded or block compressed.
+    struct Decoded {
+        TextureKey m_key;
+        Texture::ImageData m_image;
+        CompressedImage m_compressed;
+        // the levels below the image, from build_mips()
+        std::vector<uint8_t> m_mips;
+        // where the bytes are if they were copied into the ring, then the
+        // image's data and the mips are empty
+        std::optional<UploadRing::Region> m_staged;
+
+        [[nodiscard]] size_t size() const;
+    };
+
+    // a frame spends at most this much on uploads, unless a single texture
+    // is larger, which then gets a frame to itself
+    static constexpr size_t UPLOAD_BUDGET = 16 << 20;
+    // what a 4K rgba map takes in the ring with its mips, larger images are
+    // uploaded from client memory
+    static constexpr size_t LARGEST_STAGED = size_t(4096) * 4096 * 4 + mip_chain_size(4096, 4096, 4);
+    // two of those, so the pool can stage another one while the largest
+    // waits for its frame
+    static constexpr size_t RING_SIZE = 2 * LARGEST_STAGED;
+
+    std::unordered_map<TextureKey, std::shared_ptr<Texture>> m_textures;
+    std::shared_ptr<Texture> m_white;
+
+    // submitted to the pool and not uploaded yet, only for the GL thread
+    size_t m_pending = 0;
+
+    std::mutex m_mutex;
+    std::vector<Decoded> m_decoded;
+
+    // where the pool puts decoded pixels, made with the first load_async()
+    std::optional<UploadRing> m_ring;
+
+    // last, so its threads stop before what they write to goes away. One
+    // core is left to the GL thread.
+    WorkerPool m_pool { std::max<size_t>(thread_count() - 1, 1) };
+
+public:
+    TextureCache() = default;
+    ~TextureCache();
+
+    // Decodes every texture that is not cached yet in parallel, then uploads
+    // them one after another. Has to be called on the GL thread.
+    void load(std::span<const TextureKey> keys);
+
+    // Returns the texture right away, as a 1x1 placeholder until its image
+    // is decoded on the pool into the upload ring and upload_ready() puts it
+    // in place. Has to be called on the GL thread.
+    [[nodiscard]] std::shared_ptr<Texture> load_async(const TextureKey &key, Placeholder placeholder = PLACEHOLDER_WHITE);
+
+    // Uploads the textures decoded since the last call, up to a budget in
+    // bytes so the frame that calls it is not held up for long, and takes
+    // back ring space the GPU is done with. Call it every frame on the GL
+    // thread, it returns how many it uploaded.
+    size_t upload_ready(size_t budget = UPLOAD_BUDGET);
+
+    // textures from load_async() that still show their placeholder
+    [[nodiscard]] size_t pending() const {
+        return m_pending;
+    }
+
+private:
+    // Decodes the image of key, or for block compressed ones loads it from
+    // the disk cache, or encodes and caches it. May run on any thread.
+    [[nodiscard]] static Decoded prepare(const TextureKey &key);
+    void upload(Decoded &decoded);
+
+public:
+
+    [[nodiscard]] std::shared_ptr<Texture> get(const TextureKey &key) {
+        if (auto it = m_textures.find(key); it != m_textures.end())
+            return it->second;
+
+        load(std::span(&key, 1));
+        return m_textures.at(key);
+    }
+
+    // 1x1 white, for materials without a map
+    [[nodiscard]] std::shared_ptr<Texture> white();
+
+};
@@ -0,0 +1,135 @@
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <print>
+
+#include "texturefile.hh"
+#include "sourcestamp.hh"
+
+
+
+namespace {
+
+[[nodiscard]] constexpr uint64_t align_up(uint64_t offset) {
+    return (offset + TEXTURE_CACHE_ALIGNMENT - 1) & ~(TEXTURE_CACHE_ALIGNMENT - 1);
+}
+
+[[nodiscard]] bool is_valid_format(BlockFormat format) {
+    return format == BlockFormat::BC1 || format == BlockFormat::BC3
+        || format == BlockFormat::BC5 || format == BlockFormat::BC7;
+}
+
+} // namespace
+
+[[nodiscard]] std::string CachedTexture::cache_path(const char *source, std::string_view variant) {
+    auto path = std::filesystem::weakly_canonical(source).string();
+    path += '\0';
+    path += variant;
+    return std::format(".texturecache/{:016x}.tex", hash_bytes(path));
+}
+
+[[nodiscard]] std::optional<CompressedImage> CachedTexture::load(const char *source, std::string_view variant) {
+
+    auto stamp = stamp_source(source);
+    if (!stamp)
+        return { };
+
+    auto path = cache_path(source, variant);
+    auto file = MappedFile::try_open(path.c_str());
+    if (!file)
+        return { };
+
+    auto data = file->view();
+    if (data.size() < sizeof(TextureCacheHeader))
+        return { };
+
+    TextureCacheHeader header;
+    memcpy(&header, data.data(), sizeof(header));
+
+    if (memcmp(header.m_magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC)) != 0)
+        return { };
+
+    if (header.m_version != TEXTURE_CACHE_VERSION || header.m_source_size != stamp->m_size)
+        return { };
+
+    // the source was touched, but its content might still be the same
+    if (header.m_source_mtime != stamp->m_mtime) {
+        if (hash_source(source) != header.m_source_hash)
+            return { };
+
+        std::fstream out(path, std::ios::in | std::ios::out | std::ios::binary);
+        out.seekp(offsetof(TextureCacheHeader, m_source_mtime));
+        out.write(reinterpret_cast<const char*>(&stamp->m_mtime), sizeof(stamp->m_mtime));
+    }
+
+    size_t table_end = sizeof(TextureCacheHeader) + header.m_level_count * sizeof(CompressedLevel);
+    if (!is_valid_format(header.m_format) || header.m_level_count == 0 || header.m_level_count > 32 || table_end > data.size())
+        return { };
+
+    if (header.m_data_offset < table_end || header.m_data_offset > data.size() || header.m_data_size > data.size() - header.m_data_offset)
+        return { };
+
+    CompressedImage image;
+    image.m_format = header.m_format;
+    image.m_levels.resize(header.m_level_count);
+    memcpy(image.m_levels.data(), data.data() + sizeof(TextureCacheHeader), header.m_level_count * sizeof(CompressedLevel));
+
+    for (auto &level : image.m_levels) {
+        size_t blocks = size_t((level.m_width + 3) / 4) * ((level.m_height + 3) / 4);
+        if (level.m_size != blocks * block_bytes(image.m_format) || level.m_offset > header.m_data_size
+            || level.m_size > header.m_data_size - level.m_offset)
+            return { };
+    }
+
+    auto *begin = reinterpret_cast<const uint8_t*>(data.data() + header.m_data_offset);
+    image.m_data.assign(begin, begin + header.m_data_size);
+    return image;
+}
+
+bool CachedTexture::store(const char *source, std::string_view variant, const CompressedImage &image) {
+
+    auto stamp = stamp_source(source);
+    auto hash = hash_source(source);
+    if (!stamp || !hash)
+        return false;
+
+    TextureCacheHeader header { };
+    memcpy(header.m_magic, TEXTURE_CACHE_MAGIC, sizeof(TEXTURE_CACHE_MAGIC));
+    header.m_version = TEXTURE_CACHE_VERSION;
+    header.m_format = image.m_format;
+    header.m_source_size = stamp->m_size;
+    header.m_source_mtime = stamp->m_mtime;
+    header.m_source_hash = *hash;
+    header.m_level_count = image.m_levels.size();
+    header.m_data_offset = align_up(sizeof(TextureCacheHeader) + image.m_levels.size() * sizeof(CompressedLevel));
+    header.m_data_size = image.m_data.size();
+
+    auto path = cache_path(source, variant);
+    auto tmp_path = path + ".tmp";
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    std::ofstream out(tmp_path, std::ios::binary);
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(image.m_levels.data()), image.m_levels.size() * sizeof(CompressedLevel));
+
+    // the gap before the data is zero padding
+    static constexpr char padding[TEXTURE_CACHE_ALIGNMENT] = { };
+    out.write(padding, header.m_data_offset - out.tellp());
+    out.write(reinterpret_cast<const char*>(image.m_data.data()), image.m_data.size());
+
+    out.close();
+
+    if (!out) {
+        std::println(stderr, "Failed to write texture cache: {}", path);
+        std::filesystem::remove(tmp_path, ec);
+        return false;
+    }
+
+    // readers never see a partially written cache
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
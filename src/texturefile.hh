@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "blockcompress.hh"
+
+
+
+// Block compressed texture cache file layout, in the spirit of KTX2 and
+// DDS. Everything is little-endian, the blocks of every mip level are
+// stored back to back starting at m_data_offset, largest level first.
+//
+//   TextureCacheHeader
+//   CompressedLevel[m_level_count], offsets relative to m_data_offset
+//   level data...
+
+static constexpr char TEXTURE_CACHE_MAGIC[8] = { 'G', 'L', 'F', 'T', 'E', 'X', '\0', '\0' };
+static constexpr uint32_t TEXTURE_CACHE_VERSION = 1;
+static constexpr size_t TEXTURE_CACHE_ALIGNMENT = 64;
+
+struct TextureCacheHeader {
+    char m_magic[8];
+    uint32_t m_version;
+    BlockFormat m_format;
+    // the source image the cache was built from
+    uint64_t m_source_size;
+    int64_t m_source_mtime;
+    uint64_t m_source_hash;
+    uint32_t m_level_count;
+    uint32_t m_reserved;
+    uint64_t m_data_offset;
+    uint64_t m_data_size;
+};
+
+static_assert(sizeof(TextureCacheHeader) == 64);
+
+// Compressed images cached next to the mesh cache, so later runs skip
+// decoding and encoding. variant names everything besides the source that
+// decides the contents, like the block format, each gets its own file.
+class CachedTexture {
+public:
+    // Returns nothing if there is no cache file for source yet, or if the
+    // source changed since it was written.
+    [[nodiscard]] static std::optional<CompressedImage> load(const char *source, std::string_view variant);
+
+    // Writes the cache file for source. Failing to do so is not an error,
+    // the image just has to be encoded again next time.
+    static bool store(const char *source, std::string_view variant, const CompressedImage &image);
+
+private:
+    [[nodiscard]] static std::string cache_path(const char *source, std::string_view variant);
+
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+
+// Splits a polygon into points.size() - 2 triangles, written to out as
+// indices into points with the winding of the polygon. Convex polygons
+// become a fan around the first point, all others are ear clipped in the
+// plane that fits them best.
+inline void triangulate_polygon(std::span<const glm::vec3> points, std::vector<uint32_t> &out) {
+
+    uint32_t count = points.size();
+    out.clear();
+
+    auto fan = [&] {
+        for (uint32_t i = 1; i + 1 < count; ++i)
+            out.insert(out.end(), { 0, i, i + 1 });
+    };
+
+    if (count <= 3) {
+        fan();
+        return;
+    }
+
+    // Newell's method, robust for polygons that are not quite planar
+    glm::vec3 normal(0.0f);
+    for (uint32_t i = 0; i < count; ++i) {
+        glm::vec3 a = points[i];
+        glm::vec3 b = points[(i + 1) % count];
+        normal += glm::vec3((a.y - b.y) * (a.z + b.z), (a.z - b.z) * (a.x + b.x), (a.x - b.x) * (a.y + b.y));
+    }
+
+    // drop the axis the normal points along the most, ties broken towards
+    // x then y, so a 45 degree wall still keeps two distinct axes
+    glm::vec3 n = glm::abs(normal);
+    int d = n.x >= n.y && n.x >= n.z ? 0 : n.y >= n.z ? 1 : 2;
+
+    // the axes that follow it in cyclic order keep the winding as seen along
+    // the normal, mirrored only if that component is negative
+    int u = (d + 1) % 3, v = (d + 2) % 3;
+    float winding = normal[d];
+
+    // projected on the fly, convex polygons are common and need no storage
+    auto flat = [&](uint32_t i) {
+        return glm::vec2(points[i][u], points[i][v]);
+    };
+
+    // > 0 if a, b, c turn the same way as the polygon
+    auto turn = [&](uint32_t a, uint32_t b, uint32_t c) {
+        glm::vec2 ab = flat(b) - flat(a);
+        glm::vec2 bc = flat(c) - flat(b);
+        return (ab.x * bc.y - ab.y * bc.x) * winding;
+    };
+
+    bool convex = true;
+    for (uint32_t i = 0; i < count && convex; ++i)
+        convex = turn(i, (i + 1) % count, (i + 2) % count) >= 0.0f;
+
+    if (convex) {
+        fan();
+        return;
+    }
+
+    auto inside = [&](uint32_t p, uint32_t a, uint32_t b, uint32_t c) {
+        return turn(a, b, p) >= 0.0f && turn(b, c, p) >= 0.0f && turn(c, a, p) >= 0.0f;
+    };
+
+    std::vector<uint32_t> remaining(count);
+    for (uint32_t i = 0; i < count; ++i)
+        remaining[i] = i;
+
+    while (remaining.size() > 3) {
+        size_t size = remaining.size();
+        size_t ear = 0;
+
+        for (size_t i = 0; i < size; ++i) {
+            uint32_t a = remaining[(i + size - 1) % size];
+            uint32_t b = remaining[i];
+            uint32_t c = remaining[(i + 1) % size];
+
+            if (turn(a, b, c) <= 0.0f)
+                continue;
+
+            bool empty = true;
+            for (uint32_t p : remaining) {
+                if (p != a && p != b && p != c && inside(p, a, b, c)) {
+                    empty = false;
+                    break;
+                }
+            }
+
+            if (empty) {
+                ear = i;
+                break;
+            }
+        }
+
+        // a self intersecting polygon may have no ear at all, it still gets
+        // the right number of triangles by cutting off the first corner
+        out.insert(out.end(), {
+            remaining[(ear + size - 1) % size],
+            remaining[ear],
+            remaining[(ear + 1) % size],
+        });
+
+        remaining.erase(remaining.begin() + ear);
+    }
+
+    out.insert(out.end(), remaining.begin(), remaining.end());
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+
+#include "glad/gl.h"
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+
+
+// A pixel unpack buffer that stays mapped for its whole life, so any thread
+// can write pixels into it while the GL thread copies earlier ones into
+// textures. Space is handed out in order around the ring and comes back
+// once the GPU has finished reading it, which a fence tells.
+class UploadRing {
+public:
+    struct Region {
+        size_t m_offset;
+        std::span<uint8_t> m_bytes;
+    };
+
+private:
+    struct Block {
+        size_t m_offset;
+        size_t m_size;
+        // set once the commands reading the block are issued
+        GLsync m_fence = nullptr;
+    };
+
+    // keeps every region aligned for wide copies
+    static constexpr size_t ALIGNMENT = 64;
+
+    GLuint m_id;
+    size_t m_capacity;
+    uint8_t *m_memory;
+
+    std::mutex m_mutex;
+    std::condition_variable m_freed;
+    // oldest first, so the space in use is always from the front one's
+    // offset to m_head, wrapping around at the end
+    std::deque<Block> m_blocks;
+    size_t m_head = 0;
+    bool m_closed = false;
+
+public:
+    // has to be created on the GL thread
+    explicit UploadRing(size_t capacity) : m_capacity(capacity) {
+        constexpr GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glGenBuffers(1, &m_id);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_id);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, flags);
+        m_memory = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, flags));
+        // left bound, every texture upload from client memory would read from it
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    ~UploadRing() {
+        for (auto &block : m_blocks) {
+            if (block.m_fence != nullptr)
+                glDeleteSync(block.m_fence);
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_id);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &m_id);
+    }
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing &operator=(const UploadRing&) = delete;
+
+    [[nodiscard]] GLuint id() const {
+        return m_id;
+    }
+
+    [[nodiscard]] size_t capacity() const {
+        return m_capacity;
+    }
+
+    // Space for size bytes, waiting for the GPU to give some back if the
+    // ring is full. Empty if it can never fit or the ring was closed. May be
+    // called on any thread.
+    [[nodiscard]] std::optional<Region> allocate(size_t size) {
+        size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        if (size > m_capacity || m_memory == nullptr)
+            return std::nullopt;
+
+        std::unique_lock lock(m_mutex);
+        std::optional<size_t> offset;
+        m_freed.wait(lock, [&] { return m_closed || (offset = find_space(size)).has_value(); });
+
+        if (m_closed)
+            return std::nullopt;
+
+        m_blocks.push_back({ *offset, size });
+        m_head = *offset + size;
+        return Region { *offset, std::span(m_memory + *offset, size) };
+    }
+
+    // Fences the region off after the commands that read it. Has to be
+    // called on the GL thread.
+    void retire(const Region &region) {
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        std::lock_guard lock(m_mutex);
+        for (auto &block : m_blocks) {
+            if (block.m_offset == region.m_offset && block.m_fence == nullptr) {
+                block.m_fence = fence;
+                return;
+            }
+        }
+        glDeleteSync(fence);
+    }
+
+    // Gives back the space the GPU is done with, oldest first, without
+    // waiting for it. Has to be called on the GL thread, once a frame.
+    void reclaim() {
+        {
+            std::lock_guard lock(m_mutex);
+            while (!m_blocks.empty()) {
+                GLsync fence = m_blocks.front().m_fence;
+                if (fence == nullptr)
+                    break;
+
+                GLenum status = glClientWaitSync(fence, 0, 0);
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                    break;
+
+                glDeleteSync(fence);
+                m_blocks.pop_front();
+            }
+
+            if (m_blocks.empty())
+                m_head = 0;
+        }
+        m_freed.notify_all();
+    }
+
+    // Wakes everything waiting in allocate() and makes it give up, for
+    // shutting down the threads that write to the ring.
+    void close() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_closed = true;
+        }
+        m_freed.notify_all();
+    }
+
+private:
+    [[nodiscard]] std::optional<size_t> find_space(size_t size) const {
+        if (m_blocks.empty())
+            return 0;
+
+        size_t tail = m_blocks.front().m_offset;
+
+        if (m_head > tail) {
+            if (m_head + size <= m_capacity)
+                return m_head;
+            // wraps, the rest of the end stays unused this time around
+            if (size <= tail)
+                return 0;
+            return std::nullopt;
+        }
+
+        if (m_head + size <= tail)
+            return m_head;
+        return std::nullopt;
+    }
+
+};
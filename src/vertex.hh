@@ -2,6 +2,8 @@
 
 #include <string>
 #include <span>
+#include <type_traits>
+#include <utility>
 
 #include "glad/gl.h"
 #define GLFW_INCLUDE_NONE
@@ -38,3 +40,73 @@ struct Vertex {
     Vertex &rotate(float angle, glm::vec3 normal);
 
 };
+
+// Attributes a mesh vertex can have, position is always present.
+enum VertexAttrib : unsigned {
+    ATTRIB_POSITION = 1 << 0,
+    ATTRIB_UV       = 1 << 1,
+    ATTRIB_NORMAL   = 1 << 2,
+    // xyz along increasing u, w the sign of the bitangent
+    ATTRIB_TANGENT  = 1 << 3,
+    // linear rgb, like Vertex::m_color, baked ambient occlusion as grey
+    ATTRIB_COLOR    = 1 << 4,
+};
+
+static constexpr unsigned ATTRIB_ALL = ATTRIB_POSITION | ATTRIB_UV | ATTRIB_NORMAL | ATTRIB_TANGENT | ATTRIB_COLOR;
+
+[[nodiscard]] constexpr bool is_valid_attribs(unsigned attribs) {
+    return (attribs & ATTRIB_POSITION) && (attribs & ~ATTRIB_ALL) == 0;
+}
+
+template <int>
+struct NoAttrib { };
+
+// Smallest vertex that holds exactly the attributes in Attribs, in this order.
+template <unsigned Attribs>
+struct PackedVertex {
+    glm::vec3 m_pos;
+    [[no_unique_address]] std::conditional_t<(Attribs & ATTRIB_UV) != 0, glm::vec2, NoAttrib<0>> m_uv;
+    [[no_unique_address]] std::conditional_t<(Attribs & ATTRIB_NORMAL) != 0, glm::vec3, NoAttrib<1>> m_normal;
+    [[no_unique_address]] std::conditional_t<(Attribs & ATTRIB_TANGENT) != 0, glm::vec4, NoAttrib<2>> m_tangent;
+    [[no_unique_address]] std::conditional_t<(Attribs & ATTRIB_COLOR) != 0, glm::vec3, NoAttrib<3>> m_color;
+};
+
+static_assert(sizeof(PackedVertex<ATTRIB_POSITION>) == 12);
+static_assert(sizeof(PackedVertex<ATTRIB_POSITION | ATTRIB_UV>) == 20);
+static_assert(sizeof(PackedVertex<ATTRIB_POSITION | ATTRIB_NORMAL>) == 24);
+static_assert(sizeof(PackedVertex<ATTRIB_POSITION | ATTRIB_UV | ATTRIB_NORMAL>) == 32);
+static_assert(sizeof(PackedVertex<ATTRIB_ALL & ~ATTRIB_COLOR>) == 48);
+static_assert(sizeof(PackedVertex<ATTRIB_ALL>) == 60);
+
+// The attributes both layouts have, the others of B are zero.
+template <unsigned B, unsigned A>
+[[nodiscard]] PackedVertex<B> convert_vertex(const PackedVertex<A> &old) {
+    PackedVertex<B> vertex { };
+
+    vertex.m_pos = old.m_pos;
+    if constexpr ((A & B & ATTRIB_UV) != 0)
+        vertex.m_uv = old.m_uv;
+    if constexpr ((A & B & ATTRIB_NORMAL) != 0)
+        vertex.m_normal = old.m_normal;
+    if constexpr ((A & B & ATTRIB_TANGENT) != 0)
+        vertex.m_tangent = old.m_tangent;
+    if constexpr ((A & B & ATTRIB_COLOR) != 0)
+        vertex.m_color = old.m_color;
+
+    return vertex;
+}
+
+// Calls fn.template operator()<A>() with the runtime attribs as A, so every
+// layout gets its own instantiation. attribs has to be valid.
+template <unsigned A = ATTRIB_POSITION, typename Fn>
+decltype(auto) dispatch_attribs(unsigned attribs, Fn &&fn) {
+    if constexpr (A < ATTRIB_ALL) {
+        if (attribs != A)
+            return dispatch_attribs<A + 2>(attribs, std::forward<Fn>(fn));
+    }
+    return fn.template operator()<A>();
+}
+
+[[nodiscard]] inline size_t vertex_stride(unsigned attribs) {
+    return dispatch_attribs(attribs, []<unsigned A>() { return sizeof(PackedVertex<A>); });
+}
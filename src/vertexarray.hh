@@ -11,12 +11,27 @@
 
 
 
+// GLhalf is only another name for GLushort, so half floats get a type of
+// their own to pick the right VertexArray::add.
+struct Half {
+    GLhalf m_bits;
+};
+
+// Integers the GPU maps to [0, 1] if unsigned or [-1, 1] if signed. Plain
+// integer types are converted to float as they are.
+template <typename T>
+struct Normalized {
+    T m_value;
+};
+
 class VertexArray {
     GLuint m_id;
+    size_t m_stride;
     size_t m_offset = 0;
 
 public:
-    VertexArray() {
+    // stride: size of one whole vertex, attributes are added in memory order
+    VertexArray(size_t stride = sizeof(Vertex)) : m_stride(stride) {
         glGenVertexArrays(1, &m_id);
     }
 
@@ -40,14 +55,24 @@ public:
     template <typename T>
     VertexArray &add(GLuint location, GLint components) = delete;
 
+    // padding after the last attribute, to keep the next one aligned
+    VertexArray &skip(size_t bytes) {
+        m_offset += bytes;
+        return *this;
+    }
+
 private:
-    void add_attr(GLuint location, GLint components, GLenum type, size_t elem_size) {
+    void add_attr(GLuint location, GLint components, GLenum type, size_t elem_size, bool normalized = false) {
         bind();
 
-        glVertexAttribPointer(location, components, type, false, sizeof(Vertex),
-                              reinterpret_cast<void*>(m_offset));
+        // attributes the shader does not use have no location, but still take up space
+        if (location != static_cast<GLuint>(-1)) {
+            glVertexAttribPointer(location, components, type, normalized, m_stride,
+                                  reinterpret_cast<void*>(m_offset));
+
+            glEnableVertexAttribArray(location);
+        }
 
-        glEnableVertexAttribArray(location);
         m_offset += elem_size * components;
     }
 
@@ -58,3 +83,57 @@ inline VertexArray& VertexArray::add<float>(GLuint location, GLint components) {
     add_attr(location, components, GL_FLOAT, sizeof(float));
     return *this;
 }
+
+template <>
+inline VertexArray& VertexArray::add<Half>(GLuint location, GLint components) {
+    add_attr(location, components, GL_HALF_FLOAT, sizeof(Half));
+    return *this;
+}
+
+template <>
+inline VertexArray& VertexArray::add<GLbyte>(GLuint location, GLint components) {
+    add_attr(location, components, GL_BYTE, sizeof(GLbyte));
+    return *this;
+}
+
+template <>
+inline VertexArray& VertexArray::add<GLubyte>(GLuint location, GLint components) {
+    add_attr(location, components, GL_UNSIGNED_BYTE, sizeof(GLubyte));
+    return *this;
+}
+
+template <>
+inline VertexArray& VertexArray::add<GLshort>(GLuint location, GLint components) {
+    add_attr(location, components, GL_SHORT, sizeof(GLshort));
+    return *this;
+}
+
+template <>
+inline VertexArray& VertexArray::add<GLushort>(GLuint location, GLint components) {
+    add_attr(location, components, GL_UNSIGNED_SHORT, sizeof(GLushort));
+    return *this;
+}
+
+template <>
+inline VertexArray& VertexArray::add<Normalized<GLbyte>>(GLuint location, GLint components) {
+    add_attr(location, components, GL_BYTE, sizeof(GLbyte), true);
+    return *this;
+}
+
+template <>
+inline VertexArray& VertexArray::add<Normalized<GLubyte>>(GLuint location, GLint components) {
+    add_attr(location, components, GL_UNSIGNED_BYTE, sizeof(GLubyte), true);
+    return *this;
+}
+
+template <>
+inline VertexArray& VertexArray::add<Normalized<GLshort>>(GLuint location, GLint components) {
+    add_attr(location, components, GL_SHORT, sizeof(GLshort), true);
+    return *this;
+}
+
+template <>
+inline VertexArray& VertexArray::add<Normalized<GLushort>>(GLuint location, GLint components) {
+    add_attr(location, components, GL_UNSIGNED_SHORT, sizeof(GLushort), true);
+    return *this;
+}
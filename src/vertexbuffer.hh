@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <span>
 
@@ -19,11 +20,11 @@ class VertexBuffer {
     GLuint m_id;
 
 public:
-    VertexBuffer(std::span<const Vertex> vertices) {
+    // the layout of the vertices is described by the VertexArray
+    VertexBuffer(std::span<const std::byte> vertices) {
         glGenBuffers(1, &m_id);
         bind();
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                     vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size(), vertices.data(), GL_STATIC_DRAW);
     }
 
     ~VertexBuffer() {